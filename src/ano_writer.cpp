@@ -0,0 +1,103 @@
+/** @file ano_writer.cpp
+ *
+ * Splat!
+ * @copyright 1997 - 2018 John A. Magliacane (KD2BD) and contributors.
+ * See revision control history for contributions.
+ * This file is covered by the LICENSE.md file in the root of this project.
+ */
+
+#include "ano_writer.h"
+#include <utility>
+
+using namespace std;
+
+/* Bytes of lines gathered before they are written out */
+#define BLOCK_BYTES (1 << 20)
+
+void AnoWriter::Text::Add(double lat, double lon, const char *line,
+                          size_t length) {
+    Line l;
+
+    text.append(line, length);
+
+    l.end = text.size();
+    l.lat = lat;
+    l.lon = lon;
+    lines.push_back(l);
+}
+
+AnoWriter::AnoWriter(FILE *fd, int radials, const Filter &keep)
+    : fd(fd), keep(keep), texts(radials), committed(radials, false),
+      next(0) {
+    thread = std::thread(&AnoWriter::Write, this);
+}
+
+AnoWriter::~AnoWriter() { Finish(); }
+
+void AnoWriter::Commit(int radial, Text &text) {
+    lock_guard<mutex> lg(lock);
+
+    swap(texts[radial], text);
+    committed[radial] = true;
+
+    if (!spare.empty()) {
+        text = move(spare.back());
+        spare.pop_back();
+    }
+
+    if (radial == next)
+        ready.notify_one();
+}
+
+void AnoWriter::Finish() {
+    if (thread.joinable())
+        thread.join();
+}
+
+/* Writer thread main loop: waits for the radials in turn, and writes out the
+ * lines keep() lets through.
+ */
+void AnoWriter::Write() {
+    string block;
+    Text text;
+    size_t begin, i;
+    int radial;
+
+    block.reserve(BLOCK_BYTES);
+
+    for (radial = 0; radial < (int)texts.size(); radial++) {
+        {
+            unique_lock<mutex> ul(lock);
+
+            next = radial;
+            ready.wait(ul, [&] { return committed[radial]; });
+            swap(texts[radial], text);
+        }
+
+        for (begin = 0, i = 0; i < text.lines.size(); i++) {
+            const Line &line = text.lines[i];
+
+            if (keep(line.lat, line.lon, radial))
+                block.append(text.text, begin, line.end - begin);
+
+            begin = line.end;
+        }
+
+        if (block.size() >= BLOCK_BYTES) {
+            fwrite(block.data(), 1, block.size(), fd);
+            block.clear();
+        }
+
+        text.text.clear();
+        text.lines.clear();
+
+        {
+            lock_guard<mutex> lg(lock);
+            spare.push_back(move(text));
+        }
+
+        text = Text();
+    }
+
+    fwrite(block.data(), 1, block.size(), fd);
+}
@@ -0,0 +1,95 @@
+/** @file ano_writer.h
+ *
+ * Splat!
+ * @copyright 1997 - 2018 John A. Magliacane (KD2BD) and contributors.
+ * See revision control history for contributions.
+ * This file is covered by the LICENSE.md file in the root of this project.
+ */
+
+#ifndef ano_writer_h
+#define ano_writer_h
+
+#include <condition_variable>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ Writes the alphanumeric (-ano) output of an L-R map on a thread of its own.
+
+ Each radial formats its lines into a Text and commits it, whichever worker
+ it ran on and in whatever order the radials finish. The writer takes the
+ Texts in the order of the radials, drops the lines that keep() turns down
+ and writes the rest out in large blocks, so that the file is the same
+ however many threads plotted the map.
+ */
+class AnoWriter {
+  public:
+    /**
+     One line of a Text: where it ends in the text, and the point it is for.
+     */
+    struct Line {
+        size_t end;
+        double lat;
+        double lon;
+    };
+
+    /**
+     The lines a radial formats, one after another.
+     */
+    struct Text {
+        std::string text;
+        std::vector<Line> lines;
+
+        void Add(double lat, double lon, const char *line, size_t length);
+    };
+
+    /**
+     Whether a radial's line for a point belongs in the file
+     */
+    typedef std::function<bool(double lat, double lon, int radial)> Filter;
+
+    /**
+     Starts the writer on radials 0 to radials - 1, writing to fd.
+     */
+    AnoWriter(FILE *fd, int radials, const Filter &keep);
+
+    ~AnoWriter();
+
+    /**
+     Hands over the text of a radial, which every radial must, and leaves
+     text empty, ready for another.
+     */
+    void Commit(int radial, Text &text);
+
+    /**
+     Returns once the writer has written the text of every radial.
+     */
+    void Finish();
+
+  private:
+    FILE *fd;
+    Filter keep;
+
+    /* The text of each radial, once committed, until it is written */
+    std::vector<Text> texts;
+    std::vector<bool> committed;
+
+    /* The next radial to write, and Texts written, cleared for reuse */
+    int next;
+    std::vector<Text> spare;
+
+    std::mutex lock;
+    std::condition_variable ready;
+    std::thread thread;
+
+    void Write();
+
+    AnoWriter(const AnoWriter &) = delete;
+    void operator=(const AnoWriter &) = delete;
+};
+
+#endif /* ano_writer_h */
@@ -11,14 +11,20 @@
 #include <cstdio>
 #include <cstring>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "boundary_file.h"
 #include "elevation_map.h"
 #include "path.h"
 #include "site.h"
+#include "work_pool.h"
 
 using namespace std;
 
+/* Segments of a boundary traced by a worker at a time */
+#define SEGMENTS_PER_RANGE 64
+
 BoundaryFile::BoundaryFile(const SplatRun &sr) : sr(sr) {}
 
 void BoundaryFile::LoadBoundaries(const string &filename, ElevationMap &em) {
@@ -28,13 +34,13 @@ void BoundaryFile::LoadBoundaries(const string &filename, ElevationMap &em) {
      the coordinates that describe the boundaries of cities,
      counties, and states. */
 
-    int x;
     double lat0, lon0, lat1, lon1;
     char string[80];
     Site source, destination;
     FILE *fd = NULL;
 
-    Path path(sr.arraysize, sr.ppd);
+    /* Segment i runs from ends[2 * i] to ends[2 * i + 1] */
+    vector<Site> ends;
 
     fd = fopen(filename.c_str(), "r");
 
@@ -57,10 +63,8 @@ void BoundaryFile::LoadBoundaries(const string &filename, ElevationMap &em) {
                 destination.lat = lat1;
                 destination.lon = (lon1 > 0.0 ? 360.0 - lon1 : -lon1);
 
-                path.ReadPath(source, destination, em);
-
-                for (x = 0; x < path.length; x++)
-                    em.OrMask(path.lat[x], path.lon[x], 4);
+                ends.push_back(source);
+                ends.push_back(destination);
 
                 lat0 = lat1;
                 lon0 = lon1;
@@ -75,6 +79,31 @@ void BoundaryFile::LoadBoundaries(const string &filename, ElevationMap &em) {
 
         fclose(fd);
 
+        /* The segments are traced on the workers, a run of them each, and
+           the points they cross marked on the map once they all are. */
+        vector<WorkRange> ranges;
+
+        WorkPool::Split(0, (int)ends.size() / 2, SEGMENTS_PER_RANGE, ranges);
+
+        vector<vector<pair<double, double> > > points(ranges.size());
+
+        sr.pool->Run(ranges, [&](const WorkRange &range) {
+            static thread_local Path path(sr.arraysize, sr.ppd);
+            vector<pair<double, double> > &crossed =
+                points[range.first / SEGMENTS_PER_RANGE];
+
+            for (int i = range.first; i < range.last; i++) {
+                path.ReadPath(ends[2 * i], ends[2 * i + 1], em);
+
+                for (int x = 0; x < path.length; x++)
+                    crossed.push_back(make_pair(path.lat[x], path.lon[x]));
+            }
+        });
+
+        for (size_t i = 0; i < points.size(); i++)
+            for (size_t j = 0; j < points[i].size(); j++)
+                em.OrMask(points[i][j].first, points[i][j].second, 4);
+
         fprintf(stdout, "Done!");
         fflush(stdout);
     }
@@ -0,0 +1,133 @@
+/** @file claim_layer.cpp
+ *
+ * Splat!
+ * @copyright 1997 - 2018 John A. Magliacane (KD2BD) and contributors.
+ * See revision control history for contributions.
+ * This file is covered by the LICENSE.md file in the root of this project.
+ */
+
+#include "claim_layer.h"
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+/* Memory set up by claims, all zero, or the end of the run if there is none
+ * left.
+ */
+template <class T> static T *Zeroed(size_t count) {
+    T *cells = new (nothrow) T[count]();
+
+    if (cells == NULL) {
+        fprintf(stderr, "\n*** ERROR: Out of memory for the claims of a "
+                        "multithreaded map.\n");
+        exit(-1);
+    }
+
+    return cells;
+}
+
+ClaimLayer::ClaimLayer(int pages, int ippd, function<void(size_t)> charge)
+    : blocks((ippd + BLOCK - 1) / BLOCK), charge(charge), bytes(0),
+      pages(pages) {
+    for (size_t i = 0; i < this->pages.size(); i++)
+        this->pages[i].store(NULL, memory_order_relaxed);
+}
+
+ClaimLayer::~ClaimLayer() {
+    for (size_t i = 0; i < pages.size(); i++) {
+        atomic<BlockPointer> *page = pages[i].load();
+
+        if (page == NULL)
+            continue;
+
+        for (int b = 0; b < blocks * blocks; b++)
+            delete[] page[b].load();
+
+        delete[] page;
+    }
+}
+
+unsigned ClaimLayer::Get(int indx, int x, int y) const {
+    const atomic<unsigned> *block =
+        Block(indx, x / BLOCK * blocks + y / BLOCK);
+
+    if (block == NULL)
+        return 0;
+
+    return block[x % BLOCK * BLOCK + y % BLOCK].load(memory_order_relaxed);
+}
+
+void ClaimLayer::Claim(int indx, int x, int y, unsigned claim) {
+    atomic<unsigned> &cell = Cell(indx, x, y);
+    unsigned seen = cell.load(memory_order_relaxed);
+
+    while ((seen == 0 || (seen >> DATA_BITS) > (claim >> DATA_BITS)) &&
+           !cell.compare_exchange_weak(seen, claim, memory_order_relaxed))
+        ;
+}
+
+const atomic<unsigned> *ClaimLayer::Block(int indx, int b) const {
+    const atomic<BlockPointer> *page = pages[indx].load(memory_order_acquire);
+
+    return page == NULL ? NULL : page[b].load(memory_order_acquire);
+}
+
+bool ClaimLayer::Reached(int indx) const {
+    return pages[indx].load(memory_order_acquire) != NULL;
+}
+
+size_t ClaimLayer::MaxBytes(int pages, int ippd) {
+    size_t blocks = (ippd + BLOCK - 1) / BLOCK;
+
+    return pages * blocks * blocks *
+           (sizeof(atomic<BlockPointer>) +
+            BLOCK * BLOCK * sizeof(atomic<unsigned>));
+}
+
+/* Counts memory the layer has set up, and reports it to the owner */
+void ClaimLayer::Charge(size_t added) {
+    bytes.fetch_add(added, memory_order_relaxed);
+
+    if (charge)
+        charge(added);
+}
+
+/* The claim on a point, setting up its page and block on the first claim
+ * there. Threads that race to set one up each make their own, and all but
+ * the first to publish theirs throw them away again; only that one is
+ * charged for.
+ */
+atomic<unsigned> &ClaimLayer::Cell(int indx, int x, int y) {
+    atomic<BlockPointer> *page = pages[indx].load(memory_order_acquire);
+    BlockPointer block;
+    int b = x / BLOCK * blocks + y / BLOCK;
+
+    if (page == NULL) {
+        atomic<BlockPointer> *made =
+            Zeroed<atomic<BlockPointer> >((size_t)blocks * blocks);
+
+        if (pages[indx].compare_exchange_strong(page, made,
+                                                memory_order_acq_rel)) {
+            page = made;
+            Charge(sizeof(atomic<BlockPointer>) * blocks * blocks);
+        } else
+            delete[] made;
+    }
+
+    block = page[b].load(memory_order_acquire);
+
+    if (block == NULL) {
+        BlockPointer made = Zeroed<atomic<unsigned> >(BLOCK * BLOCK);
+
+        if (page[b].compare_exchange_strong(block, made,
+                                            memory_order_acq_rel)) {
+            block = made;
+            Charge(sizeof(atomic<unsigned>) * BLOCK * BLOCK);
+        } else
+            delete[] made;
+    }
+
+    return block[x % BLOCK * BLOCK + y % BLOCK];
+}
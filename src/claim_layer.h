@@ -0,0 +1,112 @@
+/** @file claim_layer.h
+ *
+ * Splat!
+ * @copyright 1997 - 2018 John A. Magliacane (KD2BD) and contributors.
+ * See revision control history for contributions.
+ * This file is covered by the LICENSE.md file in the root of this project.
+ */
+
+#ifndef claim_layer_h
+#define claim_layer_h
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+/**
+ The points claimed by the radials of one map plotted on several threads,
+ and what each claim plotted there. A claim holds the number of the radial
+ plus one, then what it plotted in the low DATA_BITS bits; 0 is no claim.
+ Where radials meet, the lowest numbered one keeps the point, as it would
+ have had the radials been plotted one after another.
+
+ Pages are split into blocks of 16 x 16 points, and a block only takes
+ memory once one of its points is claimed, so a map holds little more than
+ the area its radials reach. That is still 4 bytes a point, so the memory
+ is reported as it is set up, for the owner to count against its budget.
+ Any thread may claim points.
+ */
+class ClaimLayer {
+  public:
+    /**
+     Points along a side of a block
+     */
+    static const int BLOCK = 16;
+
+    /**
+     Bits of a claim below the radial's number
+     */
+    static const int DATA_BITS = 9;
+
+    /**
+     A layer for maps of pages pages of ippd x ippd points, all unclaimed.
+     charge is called with the bytes of every part of the layer set up, on
+     the thread that claims the first point of it, and may be empty.
+     */
+    ClaimLayer(int pages, int ippd,
+               std::function<void(size_t)> charge = nullptr);
+
+    ~ClaimLayer();
+
+    /**
+     The claim on point x, y of page indx, or 0.
+     */
+    unsigned Get(int indx, int x, int y) const;
+
+    /**
+     Claims point x, y of page indx, unless a radial numbered no higher
+     already has.
+     */
+    void Claim(int indx, int x, int y, unsigned claim);
+
+    /**
+     Blocks along a side of a page. Block b of a page holds the points x, y
+     with x / BLOCK * Blocks() + y / BLOCK == b.
+     */
+    int Blocks() const { return blocks; }
+
+    /**
+     The BLOCK * BLOCK claims of block b of page indx, those on x, y at
+     x % BLOCK * BLOCK + y % BLOCK, or NULL if no point of it is claimed.
+     */
+    const std::atomic<unsigned> *Block(int indx, int b) const;
+
+    /**
+     Whether any point of page indx is claimed.
+     */
+    bool Reached(int indx) const;
+
+    /**
+     Memory set up so far, in bytes
+     */
+    size_t Bytes() const { return bytes.load(std::memory_order_relaxed); }
+
+    /**
+     Memory a layer of pages pages of ippd x ippd points takes once every
+     point is claimed, in bytes
+     */
+    static size_t MaxBytes(int pages, int ippd);
+
+  private:
+    typedef std::atomic<unsigned> *BlockPointer;
+
+    int blocks;
+
+    /* Reported to, and the count of, the memory set up so far */
+    std::function<void(size_t)> charge;
+    std::atomic<size_t> bytes;
+
+    /* For each page, NULL until a point of it is claimed, then a pointer to
+       each of its blocks */
+    std::vector<std::atomic<std::atomic<BlockPointer> *> > pages;
+
+    std::atomic<unsigned> &Cell(int indx, int x, int y);
+
+    void Charge(size_t added);
+
+    ClaimLayer(const ClaimLayer &) = delete;
+    void operator=(const ClaimLayer &) = delete;
+};
+
+#endif /* claim_layer_h */
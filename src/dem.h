@@ -11,8 +11,22 @@
 #ifndef dem_h
 #define dem_h
 
+#include <atomic>
+#include <cstddef>
+#include <string>
 #include <vector>
 
+/* Levels of the terrain pyramid, each keeping the highest of 2 x 2 points
+   of the one before. See ElevationMap::BuildLevels(). */
+#define DEM_LEVELS 3
+
+/**
+ One page of the elevation map: a degree square of terrain, and the mask and
+ signal layers drawn over it.
+
+ Pages are read on first use, and their terrain may be evicted and read again
+ later to keep within the memory budget. See ElevationMap::LoadPage().
+ */
 class Dem {
   public:
     int min_north;
@@ -21,16 +35,63 @@ class Dem {
     int max_west;
     int max_el;
     int min_el;
-    std::vector<short> data;
-    std::vector<unsigned char> mask;
-    std::vector<unsigned char> signal;
+
+    /* The SDF the terrain is read from, found when the page is added, or
+       empty if the page is at sea-level. See Sdf::FindSDF(). */
+    std::string file;
+
+    /* ippd * ippd terrain heights, NULL until the page is first used. Only
+       valid while seq is even; read them through ElevationMap::Height(). */
+    short *data;
+
+    /* The mapping data lies in, for ElevationMap to release: either memory
+       of its own, or a binary SDF file that data points into */
+    void *map;
+    size_t map_bytes;
+    bool map_file;
+
+    /* The terrain pyramid: levels 1 to DEM_LEVELS, of (ippd >> level)
+       squared maximum heights each, one after another and each row after
+       row. Only built for -farfield runs, on the page's first read, and
+       NULL for constant pages. */
+    short *levels;
+
+    /* ippd * ippd mask bits and signal levels, each NULL until the first
+       write to it. See ElevationMap::Layer(). */
+    std::atomic<unsigned char *> mask;
+    std::atomic<unsigned char *> signal;
+
+    /* Odd while the terrain is not in memory or is being read, even while
+       it is. Bumped on every change, so that readers can tell. */
+    std::atomic<unsigned> seq;
+
+    /* ElevationMap's clock when the terrain was last used */
+    std::atomic<unsigned> used;
+
+    /* The terrain has been read at least once, so that min_el and max_el
+       are known */
+    std::atomic<bool> present;
+
+    /* A thread is reading the terrain. Guarded by ElevationMap's page
+       lock. */
+    bool loading;
+
+    /* The terrain was changed in memory (by a UDT file), so it must not be
+       evicted and read back */
+    bool pinned;
+
+    /* The terrain is all one height, and data is shared with every other
+       page of that height rather than held by map. Never evicted. See
+       ElevationMap::ShareTerrain(). */
+    bool constant;
 
   public:
-    Dem(int size)
-        : min_north(0), max_north(0), min_west(0), max_west(0), max_el(0),
-          min_el(0), data(std::vector<short>(size * size)),
-          mask(std::vector<unsigned char>(size * size)),
-          signal(std::vector<unsigned char>(size * size)) {}
+    Dem()
+        : min_north(90), max_north(-90), min_west(360), max_west(-1),
+          max_el(-32768), min_el(32768), data(NULL), map(NULL), map_bytes(0),
+          map_file(false), levels(NULL), mask(NULL), signal(NULL), seq(1),
+          used(0), present(false), loading(false), pinned(false),
+          constant(false) {}
 
     ~Dem();
 };
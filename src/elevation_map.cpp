@@ -17,8 +17,10 @@
 #include "path.h"
 #include "sdf.h"
 #include "site.h"
+#include "sysutil.h"
 #include "utilities.h"
-#include "workqueue.h"
+#include "work_pool.h"
+#include <algorithm>
 #include <bzlib.h>
 #include <cmath>
 #include <cstdlib>
@@ -33,29 +35,41 @@ using namespace std;
 #define MAX_LINE_LEN 128
 #define NO_ANTENNA_DATA (-1.0)
 
-/* avg must be a float or double or you get rounding down because of truncation
- * ignores values if n == 0 to avoid a divide-by-zero error
- */
-#define UPDATE_RUNNING_AVG(avg, latest, n)                                     \
-    do {                                                                       \
-        (n) && ((avg) = (avg) + ((float)((latest) - (avg))) / (float)(n));     \
-    } while (0)
-
 ElevationMap::ElevationMap(const SplatRun &sr)
-    : sr(sr), avgpathlen(0.0), totalpaths(0), dem(sr.maxpages, Dem(sr.ippd)),
-      min_north(90), max_north(-90), min_west(360), max_west(-1),
-      max_elevation(-32768), min_elevation(32768) {
-    for (int i = 0; i < sr.maxpages; i++) {
-        dem[i].min_el = 32768;
-        dem[i].max_el = -32768;
-        dem[i].min_north = 90;
-        dem[i].max_north = -90;
-        dem[i].min_west = 360;
-        dem[i].max_west = -1;
-    }
+    : sr(sr), totalpaths(0), totalpathlen(0), seen(NULL), sdf(NULL),
+      clock(0), page_bytes(0), min_north(90),
+      max_north(-90), min_west(360), max_west(-1), max_elevation(-32768),
+      min_elevation(32768) {
+    IndexPages();
 }
 
-ElevationMap::~ElevationMap() {}
+ElevationMap::~ElevationMap() {
+    size_t cells = (size_t)sr.ippd * sr.ippd;
+
+    for (size_t i = 0; i < dem.size(); i++) {
+        if (dem[i].mask.load() != NULL)
+            SysUtil::UnmapMemory(dem[i].mask.load(), cells);
+
+        if (dem[i].signal.load() != NULL)
+            SysUtil::UnmapMemory(dem[i].signal.load(), cells);
+
+        if (dem[i].map == NULL)
+            continue;
+
+        if (dem[i].map_file)
+            SysUtil::UnmapFile(dem[i].map, dem[i].map_bytes);
+        else
+            SysUtil::UnmapMemory(dem[i].map, dem[i].map_bytes);
+    }
+
+    for (size_t i = 0; i < dem.size(); i++) {
+        if (dem[i].levels != NULL)
+            SysUtil::UnmapMemory(dem[i].levels, LevelBytes());
+    }
+
+    for (auto &shared : constant_terrain)
+        SysUtil::UnmapMemory(shared.second, cells * sizeof(short));
+}
 
 /* Lines, text, markings, and coverage areas are stored in a
  mask that is combined with topology data when topographic
@@ -63,15 +77,15 @@ ElevationMap::~ElevationMap() {}
  bits in the mask based on the latitude and longitude of the
  area pointed to. */
 int ElevationMap::PutMask(double lat, double lon, int value) {
-    int x, y;
-    Dem *dem;
+    int x, y, indx;
+    unsigned char *mask;
 
-    dem = (Dem *)FindDEM(lat, lon, x, y);
-    if (!dem)
+    if (!FindMask(lat, lon, x, y, indx))
         return -1;
 
-    dem->mask[x * sr.ippd + y] = value;
-    return ((int)dem->mask[x * sr.ippd + y]);
+    mask = Layer(dem[indx].mask);
+    mask[sr.Cell(x, y)] = value;
+    return ((int)mask[sr.Cell(x, y)]);
 }
 
 /* Lines, text, markings, and coverage areas are stored in a
@@ -80,55 +94,95 @@ int ElevationMap::PutMask(double lat, double lon, int value) {
  the mask based on the latitude and longitude of the area
  pointed to. */
 int ElevationMap::OrMask(double lat, double lon, int value) {
-    int x, y;
-    Dem *dem;
+    int x, y, indx;
+    unsigned char *mask;
 
-    dem = (Dem *)FindDEM(lat, lon, x, y);
-    if (!dem)
+    if (!FindMask(lat, lon, x, y, indx))
         return -1;
 
-    dem->mask[x * sr.ippd + y] |= value;
-    return ((int)dem->mask[x * sr.ippd + y]);
+    mask = Layer(dem[indx].mask);
+    mask[sr.Cell(x, y)] |= value;
+    return ((int)mask[sr.Cell(x, y)]);
 }
 
 /* Returns the mask bits based on the latitude and
  * longitude given.
  */
 int ElevationMap::GetMask(double lat, double lon) const {
-    int x, y;
-    const Dem *dem;
+    int x, y, indx;
 
-    dem = FindDEM(lat, lon, x, y);
-    if (!dem)
+    if (!FindMask(lat, lon, x, y, indx))
         return -1;
 
-    return ((int)dem->mask[x * sr.ippd + y]);
+    return ((int)Mask(&dem[indx], x, y));
+}
+
+/* The mask bits at x, y of a page found by FindDEM(). Pages that have
+ * never been drawn on have no mask, and read as 0.
+ */
+unsigned char ElevationMap::Mask(const Dem *dem, int x, int y) const {
+    const unsigned char *mask = dem->mask.load(std::memory_order_acquire);
+
+    return mask == NULL ? 0 : mask[sr.Cell(x, y)];
 }
 
 bool ElevationMap::FindMask(double lat, double lon, int &x, int &y,
                             int &indx) const {
-    /* Finds the x, y, and indx for the given lat and lon */
-    bool found = false;
+    /* Finds the x, y, and indx for the given lat and lon, without reading
+       the page's terrain */
+    int north, west, i, j, page, found = -1, found_x = 0, found_y = 0;
 
-    for (indx = 0, found = false; indx < sr.maxpages && found == false;) {
-        x = (int)rint(sr.ppd * (lat - dem[indx].min_north));
-        y = sr.mpi -
-            (int)rint(sr.ppd * (Utilities::LonDiff(dem[indx].max_west, lon)));
+    /* A page holds the points up to half a pixel short of its south and
+       east edges, so a point can only be in the page whose corner is the
+       whole degree below it or, near an edge, the next one up. Of those,
+       the page that comes first in dem[] wins, as it would if every page
+       were searched in turn. */
 
-        if (x >= 0 && x <= sr.mpi && y >= 0 && y <= sr.mpi)
-            found = true;
-        else
-            indx++;
+    north = (int)floor(lat);
+    west = (int)floor(lon);
+
+    for (i = 0; i < 2; i++) {
+        for (j = 0; j < 2; j++) {
+            page = PageKey(north + i, west + j);
+
+            if (page < 0)
+                continue;
+
+            page = page_index[page];
+
+            if (page < 0 || (found >= 0 && page > found))
+                continue;
+
+            x = (int)rint(sr.ppd * (lat - (double)dem[page].min_north));
+            y = sr.mpi -
+                (int)rint(sr.ppd * (Utilities::LonDiff(
+                                       (double)dem[page].max_west, lon)));
+
+            if (x >= 0 && x <= sr.mpi && y >= 0 && y <= sr.mpi) {
+                found = page;
+                found_x = x;
+                found_y = y;
+            }
+        }
+    }
+
+    if (found < 0) {
+        indx = (int)dem.size();
+        return false;
     }
 
-    return found;
+    x = found_x;
+    y = found_y;
+    indx = found;
+    return true;
 }
 
 /* This function returns the elevation (in feet) of any location
  * represented by the digital elevation model data in memory.
  * Function returns -5000.0 for locations not found in memory.
+ * Levels above 0 read the terrain pyramid, where the page has one.
  */
-double ElevationMap::GetElevation(const Site &location) const {
+double ElevationMap::GetElevation(const Site &location, int level) const {
     int x, y;
     const Dem *dem;
 
@@ -136,7 +190,10 @@ double ElevationMap::GetElevation(const Site &location) const {
     if (!dem)
         return -5000.0;
 
-    return (3.28084 * (double)(dem->data[x * sr.ippd + y]));
+    if (level > 0 && dem->levels != NULL)
+        return (3.28084 * (double)LevelPoint(*dem, level, x, y));
+
+    return (3.28084 * (double)Height(dem, x, y));
 }
 
 /* This function adds a user-defined terrain feature
@@ -146,13 +203,27 @@ double ElevationMap::GetElevation(const Site &location) const {
  */
 int ElevationMap::AddElevation(double lat, double lon, double height) {
     int x, y;
+    short ground;
     Dem *dem;
 
     dem = (Dem *)FindDEM(lat, lon, x, y);
     if (!dem)
         return 0;
 
-    dem->data[x * sr.ippd + y] += (short)rint(height);
+    /* The change can't be read back from the SDF, so keep it in memory */
+    dem->pinned = true;
+
+    if (dem->constant)
+        UnshareTerrain(*dem);
+
+    /* Height() may read the terrain in, and so set dem->data: it has to
+       be done before data is indexed */
+    ground = Height(dem, x, y);
+    dem->data[sr.Cell(x, y)] = ground + (short)rint(height);
+
+    for (int level = 1; dem->levels != NULL && level <= DEM_LEVELS; level++)
+        LevelPoint(*dem, level, x, y) = LevelMax(*dem, level, x, y);
+
     return 1;
 }
 
@@ -602,17 +673,17 @@ void ElevationMap::PlotPath(const Site &source, const Site &destination,
                             char mask_value) {
     char block;
     int x, y;
-    double cos_xmtr_angle, cos_test_angle, test_alt;
+    double cos_xmtr_angle;
     double distance, rx_alt, tx_alt;
 
-    Path path(sr.arraysize, sr.ppd);
+    Path &path = RadialScratch().path;
     path.ReadPath(source, destination, *this);
 
     for (y = 0; y < path.length; y++) {
         /* Test this point only if it hasn't been already
            tested and found to be free of obstructions. */
 
-        if ((GetMask(path.lat[y], path.lon[y]) & mask_value) == 0) {
+        if (!Seen(path.lat[y], path.lon[y], mask_value)) {
             distance = 5280.0 * path.distance[y];
 
             if (source.amsl_flag)
@@ -634,229 +705,295 @@ void ElevationMap::PlotPath(const Site &source, const Site &destination,
                               (tx_alt * tx_alt)) /
                              (2.0 * rx_alt * distance);
 
-            for (x = y, block = 0; x >= 0 && block == 0; x--) {
-                distance = 5280.0 * (path.distance[y] - path.distance[x]);
-                test_alt =
-                    sr.earthradius + (path.elevation[x] == 0.0
-                                          ? path.elevation[x]
-                                          : path.elevation[x] + sr.clutter);
-
-                cos_test_angle = ((rx_alt * rx_alt) + (distance * distance) -
-                                  (test_alt * test_alt)) /
-                                 (2.0 * rx_alt * distance);
-
-                /* Compare these two angles to determine if
-                   an obstruction exists.  Since we're comparing
-                   the cosines of these angles rather than
-                   the angles themselves, the following "if"
-                   statement is reversed from what it would
-                   be if the actual angles were compared. */
-
-                if (cos_xmtr_angle >= cos_test_angle)
-                    block = 1;
-            }
+            for (x = y, block = 0; x >= 0 && block == 0; x--)
+                block = Obstructs(path, x, y, rx_alt, cos_xmtr_angle);
 
             if (block == 0)
-                OrMask(path.lat[y], path.lon[y], mask_value);
+                See(path.lat[y], path.lon[y], mask_value);
         }
     }
 }
 
-/* Performs a 360 degree sweep around the transmitter site (source location),
- * and plots the line-of-sight coverage of the transmitter on the SPLAT!
- * generated topographic map based on a receiver located at the specified
- * altitude (in feet AGL). Results are stored in memory, and written out in the
- * form of a topographic map when the WriteCoverageMap() function is later
- * invoked.
+/* Whether path point x stands in the way of a receiver at point y, at rx_alt
+ * from the center of the earth, that sees the transmitter at an elevation
+ * whose cosine is cos_xmtr_angle.
  */
-void ElevationMap::PlotLOSMap(const Site &source, double altitude) {
-    int y, z, count;
-    Site edge;
-    unsigned char x;
-    double lat, lon, minwest, maxnorth, th;
-    static unsigned char mask_value = 1;
-    char symbol[4] = {'.', 'o', 'O', 'o'};
+bool ElevationMap::Obstructs(const Path &path, int x, int y, double rx_alt,
+                             double cos_xmtr_angle) const {
+    double distance, test_alt, cos_test_angle;
+
+    distance = 5280.0 * (path.distance[y] - path.distance[x]);
+    test_alt = sr.earthradius + (path.elevation[x] == 0.0
+                                     ? path.elevation[x]
+                                     : path.elevation[x] + sr.clutter);
+
+    cos_test_angle =
+        ((rx_alt * rx_alt) + (distance * distance) - (test_alt * test_alt)) /
+        (2.0 * rx_alt * distance);
+
+    /* Compare these two angles to determine if
+       an obstruction exists.  Since we're comparing
+       the cosines of these angles rather than
+       the angles themselves, the following comparison
+       is reversed from what it would be if the actual
+       angles were compared. */
+
+    return cos_xmtr_angle >= cos_test_angle;
+}
 
-    minwest = sr.dpp + (double)min_west;
-    maxnorth = (double)max_north - sr.dpp;
+/* PlotPath(), walking the path once. Rather than looking back from each
+ * point over all of those before it, the transmitter's view is swept outward:
+ * the highest elevation angle of the terrain seen so far is kept as the
+ * horizon, and a point is in sight if it rises above it. The ends of the
+ * path, the transmitter's ground and the point itself, are still tested from
+ * the receiver as PlotPath() tests them.
+ *
+ * Looking from the transmitter rather than the receiver rounds differently,
+ * so a point that only just clears or touches the horizon can come out the
+ * other way.
+ */
+void ElevationMap::PlotPathSweep(const Site &source, const Site &destination,
+                                 char mask_value) {
+    char block;
+    int y;
+    double cos_xmtr_angle, cos_rcvr_angle, cos_test_angle, cos_horizon = 2.0;
+    double distance, test_alt, rx_alt, tx_alt;
 
-    count = 0;
+    Path &path = RadialScratch().path;
+    path.ReadPath(source, destination, *this);
 
-    fprintf(stdout,
-            "\nComputing line-of-sight coverage of \"%s\" with an RX "
-            "antenna\nat %.2f %s AGL",
-            source.name.c_str(),
-            sr.metric ? altitude * METERS_PER_FOOT : altitude,
-            sr.metric ? "meters" : "feet");
+    if (source.amsl_flag)
+        tx_alt = sr.earthradius + source.alt;
+    else
+        tx_alt = sr.earthradius + source.alt + path.elevation[0];
 
-    if (sr.clutter > 0.0)
-        fprintf(stdout, " and %.2f %s of ground clutter",
-                sr.metric ? sr.clutter * METERS_PER_FOOT : sr.clutter,
-                sr.metric ? "meters" : "feet");
+    for (y = 0; y < path.length; y++) {
+        /* Bring the horizon up to the point before this one. Cosines
+           decrease as the angles they belong to rise. */
+
+        if (y >= 2) {
+            distance = 5280.0 * path.distance[y - 1];
+            test_alt = sr.earthradius +
+                       (path.elevation[y - 1] == 0.0
+                            ? path.elevation[y - 1]
+                            : path.elevation[y - 1] + sr.clutter);
+
+            cos_test_angle = ((tx_alt * tx_alt) + (distance * distance) -
+                              (test_alt * test_alt)) /
+                             (2.0 * tx_alt * distance);
+
+            if (cos_test_angle < cos_horizon)
+                cos_horizon = cos_test_angle;
+        }
 
-    fprintf(stdout, "...\n\n 0%c to  25%c ", 37, 37);
-    fflush(stdout);
+        if (!Seen(path.lat[y], path.lon[y], mask_value)) {
+            distance = 5280.0 * path.distance[y];
+            rx_alt = sr.earthradius + destination.alt + path.elevation[y];
 
-    /* th=pixels/degree divided by 64 loops per
-       progress indicator symbol (.oOo) printed. */
+            cos_xmtr_angle = ((rx_alt * rx_alt) + (distance * distance) -
+                              (tx_alt * tx_alt)) /
+                             (2.0 * rx_alt * distance);
 
-    th = sr.ppd / 64.0;
+            block = Obstructs(path, y, y, rx_alt, cos_xmtr_angle) ||
+                    (y > 0 && Obstructs(path, 0, y, rx_alt, cos_xmtr_angle));
 
-    z = (int)(th * Utilities::ReduceAngle(max_west - min_west));
+            if (block == 0 && y >= 2) {
+                /* the receiver's elevation as seen by the transmitter */
 
-    fprintf(stdout, "\n\n");
+                cos_rcvr_angle = ((tx_alt * tx_alt) + (distance * distance) -
+                                  (rx_alt * rx_alt)) /
+                                 (2.0 * tx_alt * distance);
 
-    WorkQueue wq;
+                block = cos_rcvr_angle >= cos_horizon;
+            }
 
-    if (sr.verbose) {
-        if (sr.multithread) {
-            fprintf(stdout, "Using %d threads...\n\n", wq.maxWorkers());
+            if (block == 0)
+                See(path.lat[y], path.lon[y], mask_value);
         }
-        fprintf(stdout, " 0%c to  25%c ", 37, 37);
-        fflush(stdout);
     }
+}
 
-    for (lon = minwest, x = 0, y = 0;
-         (Utilities::LonDiff(lon, (double)max_west) <= 0.0);
-         y++, lon = minwest + (sr.dpp * (double)y)) {
-        if (lon >= 360.0)
-            lon -= 360.0;
+/* Prints the progress of a map as its radials are done, in whatever order
+ * the workers finish them: a symbol (.oOo) for every 256th of the radials and
+ * the next heading for every quarter.
+ */
+class MapProgress {
+  public:
+    MapProgress(bool verbose, int total)
+        : verbose(verbose), total(total), done(0), printed(0) {}
 
-        edge.lat = max_north;
-        edge.lon = lon;
-        edge.alt = altitude;
+    void Done(int radials) {
+        const char symbol[4] = {'.', 'o', 'O', 'o'};
+        const char *heading[3] = {"25%", "50%", "75%"};
 
-        if (sr.multithread) {
-            wq.submit(std::bind(&ElevationMap::PlotPath, this, source, edge,
-                                mask_value));
-        } else {
-            PlotPath(source, edge, mask_value);
-        }
+        if (!verbose)
+            return;
 
-        if (sr.verbose) {
-            if (++count == z) {
-                fprintf(stdout, "%c", symbol[x]);
-                fflush(stdout);
-                count = 0;
+        lock_guard<mutex> lg(lock);
 
-                if (x == 3)
-                    x = 0;
-                else
-                    x++;
-            }
+        for (done += radials; printed < 256 * (long)done / total; printed++) {
+            if (printed > 0 && printed % 64 == 0)
+                fprintf(stdout, "\n%s to %3d%% ", heading[printed / 64 - 1],
+                        printed / 64 * 25 + 25);
+
+            fprintf(stdout, "%c", symbol[printed % 4]);
         }
-    }
 
-    if (sr.verbose) {
-        count = 0;
-        fprintf(stdout, "\n25%c to  50%c ", 37, 37);
         fflush(stdout);
     }
 
-    z = (int)(th * (double)(max_north - min_north));
+  private:
+    mutex lock;
+    bool verbose;
+    int total;
+    int done;
+    int printed;
+};
+
+/* Splits the radials along the four edges of the map, in the order they are
+ * swept, into ranges of consecutive radials, small enough that the workers
+ * can even out what is left between them, and returns the number of
+ * radials. With several maps, map m's ranges follow those of the maps before
+ * it, with edges numbered from 4 * m. start[] takes the number of the first
+ * radial of each edge.
+ */
+int ElevationMap::MapRanges(vector<WorkRange> &ranges, int workers, int maps,
+                            int start[4]) const {
+    int edge, map, total = 0, count[4];
+
+    for (edge = 0; edge < 4; edge++) {
+        count[edge] = EdgeRadials(edge);
+        start[edge] = total;
+        total += count[edge];
+    }
 
-    for (lat = maxnorth, x = 0, y = 0; lat >= (double)min_north;
-         y++, lat = maxnorth - (sr.dpp * (double)y)) {
-        edge.lat = lat;
-        edge.lon = min_west;
-        edge.alt = altitude;
+    for (map = 0; map < maps; map++)
+        for (edge = 0; edge < 4; edge++)
+            WorkPool::Split(4 * map + edge, count[edge],
+                            max(1, min(64, maps * total / (16 * workers))),
+                            ranges);
 
-        if (sr.multithread) {
-            wq.submit(std::bind(&ElevationMap::PlotPath, this, source, edge,
-                                mask_value));
-        } else {
-            PlotPath(source, edge, mask_value);
-        }
+    return total;
+}
 
-        if (sr.verbose) {
-            if (++count == z) {
-                fprintf(stdout, "%c", symbol[x]);
-                fflush(stdout);
-                count = 0;
+/* The number of radials along an edge of the map: 0 north, 1 west, 2 south
+ * and 3 east, counted as EdgeSite() steps along them.
+ */
+int ElevationMap::EdgeRadials(int edge) const {
+    double minwest = sr.dpp + (double)min_west;
+    double maxnorth = (double)max_north - sr.dpp;
+    int y = 0;
+
+    switch (edge) {
+    case 0:
+    case 2:
+        while (Utilities::LonDiff(minwest + (sr.dpp * (double)y),
+                                  (double)max_west) <= 0.0)
+            y++;
+        break;
 
-                if (x == 3)
-                    x = 0;
-                else
-                    x++;
-            }
-        }
-    }
+    case 1:
+        while (maxnorth - (sr.dpp * (double)y) >= (double)min_north)
+            y++;
+        break;
 
-    if (sr.verbose) {
-        count = 0;
-        fprintf(stdout, "\n50%c to  75%c ", 37, 37);
-        fflush(stdout);
+    case 3:
+        while ((double)min_north + (sr.dpp * (double)y) < (double)max_north)
+            y++;
     }
 
-    z = (int)(th * Utilities::ReduceAngle(max_west - min_west));
+    return y;
+}
 
-    for (lon = minwest, x = 0, y = 0;
-         (Utilities::LonDiff(lon, (double)max_west) <= 0.0);
-         y++, lon = minwest + (sr.dpp * (double)y)) {
-        if (lon >= 360.0)
-            lon -= 360.0;
+/* The far end of radial y along an edge of the map, at the RX altitude AGL */
+Site ElevationMap::EdgeSite(int edge, int y, double altitude) const {
+    Site site;
 
-        edge.lat = min_north;
-        edge.lon = lon;
-        edge.alt = altitude;
+    switch (edge) {
+    case 0:
+    case 2:
+        site.lat = edge == 0 ? max_north : min_north;
+        site.lon = sr.dpp + (double)min_west + (sr.dpp * (double)y);
 
-        if (sr.multithread) {
-            wq.submit(std::bind(&ElevationMap::PlotPath, this, source, edge,
-                                mask_value));
-        } else {
-            PlotPath(source, edge, mask_value);
-        }
+        if (site.lon >= 360.0)
+            site.lon -= 360.0;
+        break;
 
-        if (sr.verbose) {
-            if (++count == z) {
-                fprintf(stdout, "%c", symbol[x]);
-                fflush(stdout);
-                count = 0;
+    case 1:
+        site.lat = (double)max_north - sr.dpp - (sr.dpp * (double)y);
+        site.lon = min_west;
+        break;
 
-                if (x == 3)
-                    x = 0;
-                else
-                    x++;
-            }
-        }
+    default:
+        site.lat = (double)min_north + (sr.dpp * (double)y);
+        site.lon = max_west;
     }
 
-    if (sr.verbose) {
-        count = 0;
-        fprintf(stdout, "\n75%c to 100%c ", 37, 37);
-        fflush(stdout);
-    }
+    site.alt = altitude;
 
-    z = (int)(th * (double)(max_north - min_north));
+    return site;
+}
 
-    for (lat = (double)min_north, x = 0, y = 0; lat < (double)max_north;
-         y++, lat = (double)min_north + (sr.dpp * (double)y)) {
-        edge.lat = lat;
-        edge.lon = max_west;
-        edge.alt = altitude;
+/* Performs a 360 degree sweep around the transmitter site (source location),
+ * and plots the line-of-sight coverage of the transmitter on the SPLAT!
+ * generated topographic map based on a receiver located at the specified
+ * altitude (in feet AGL). Results are stored in memory, and written out in the
+ * form of a topographic map when the WriteCoverageMap() function is later
+ * invoked.
+ */
+void ElevationMap::PlotLOSMap(const Site &source, double altitude) {
+    static unsigned char mask_value = 1;
+    vector<WorkRange> ranges;
+    int start[4];
 
-        if (sr.multithread) {
-            wq.submit(std::bind(&ElevationMap::PlotPath, this, source, edge,
-                                mask_value));
-        } else {
-            PlotPath(source, edge, mask_value);
-        }
+    fprintf(stdout,
+            "\nComputing line-of-sight coverage of \"%s\" with an RX "
+            "antenna\nat %.2f %s AGL",
+            source.name.c_str(),
+            sr.metric ? altitude * METERS_PER_FOOT : altitude,
+            sr.metric ? "meters" : "feet");
+
+    if (sr.clutter > 0.0)
+        fprintf(stdout, " and %.2f %s of ground clutter",
+                sr.metric ? sr.clutter * METERS_PER_FOOT : sr.clutter,
+                sr.metric ? "meters" : "feet");
+
+    fprintf(stdout, "...\n\n 0%c to  25%c ", 37, 37);
+    fflush(stdout);
 
-        if (sr.verbose) {
-            if (++count == z) {
-                fprintf(stdout, "%c", symbol[x]);
-                fflush(stdout);
-                count = 0;
+    fprintf(stdout, "\n\n");
 
-                if (x == 3)
-                    x = 0;
-                else
-                    x++;
-            }
+    /* The LOS engine is picked here, once, for all radials */
+    void (ElevationMap::*plot_path)(const Site &, const Site &, char) =
+        sr.los_sweep ? &ElevationMap::PlotPathSweep : &ElevationMap::PlotPath;
+
+    WorkPool &pool = *sr.pool;
+    MapProgress progress(sr.verbose,
+                         MapRanges(ranges, pool.Workers(), 1, start));
+
+    if (sr.verbose) {
+        if (sr.multithread) {
+            fprintf(stdout, "Using %d threads...\n\n", pool.Workers());
         }
+        fprintf(stdout, " 0%c to  25%c ", 37, 37);
+        fflush(stdout);
     }
 
-    wq.waitForCompletion();
+    if (pool.Workers() > 1)
+        seen = NewClaims();
+
+    pool.Run(ranges, [&](const WorkRange &range) {
+        for (int i = range.first; i < range.last; i++)
+            (this->*plot_path)(source, EdgeSite(range.edge, i, altitude),
+                               mask_value);
+
+        progress.Done(range.last - range.first);
+    });
+
+    if (seen != NULL) {
+        DrawClaims(mask_value);
+        FreeClaims(seen);
+    }
 
     if (sr.verbose) {
         fprintf(stdout, "\nDone!\n");
@@ -879,56 +1016,85 @@ void ElevationMap::PlotLOSMap(const Site &source, double altitude) {
     }
 }
 
-/* Performs a 360 degree sweep around the transmitter site (source location),
- * and plots the ITM/ITWOM attenuation on the SPLAT! generated topographic map
- * based on a receiver located at the specified altitude (in feet AGL).  Results
- * are stored in memory, and written out in the form of a topographic map when
- * the WriteCoverageMap() function is later invoked.
+/* Performs a 360 degree sweep around each transmitter site (source
+ * location), and plots the ITM/ITWOM attenuation on the SPLAT! generated
+ * topographic map based on a receiver located at the specified altitude (in
+ * feet AGL). Results are stored in memory, and written out in the form of a
+ * topographic map when the WriteCoverageMap() function is later invoked.
+ *
+ * Site i uses antenna pattern pats[i] and the parameters lrps[i]. On more
+ * than one thread, the radials of all the sites are plotted together, each
+ * site claiming points in a layer of its own, and the layers are then drawn
+ * in the order of the sites, as plotting them one after another would have.
  */
-void ElevationMap::PlotLRMap(const Site &source, double altitude,
-                             const string &plo_filename, const AntennaPattern &pat,
-                             const Lrp &lrp) {
-    int y, z, count;
-    Site edge;
-    double lat, lon, minwest, maxnorth, th;
-    unsigned char x;
+void ElevationMap::PlotLRMaps(const vector<Site> &sources, double altitude,
+                              const string &plo_filename,
+                              const vector<const AntennaPattern *> &pats,
+                              const vector<Lrp> &lrps) {
     static unsigned char mask_value = 1;
+    vector<LRMap> maps(sources.size());
     FILE *fd = NULL;
-    char symbol[4] = {'.', 'o', 'O', 'o'};
+    size_t i, alone, batch;
+    int radials = 0;
 
-    minwest = sr.dpp + (double)min_west;
-    maxnorth = (double)max_north - sr.dpp;
+    if (maps.empty())
+        return;
 
-    count = 0;
+    for (i = 0; i < maps.size(); i++) {
+        const Lrp &lrp = lrps[i];
 
-    if(sr.propagation_model == PROP_ITM)
-        fprintf(stdout, "\nComputing ITM ");
-    else
-        fprintf(stdout, "\nComputing ITWOM ");
-
-    if (lrp.erp == 0.0)
-        fprintf(stdout, "path loss");
-    else {
-        if (sr.dbm)
-            fprintf(stdout, "signal power level");
+        if(sr.propagation_model == PROP_ITM)
+            fprintf(stdout, "\nComputing ITM ");
         else
-            fprintf(stdout, "field strength");
-    }
+            fprintf(stdout, "\nComputing ITWOM ");
 
-    fprintf(stdout,
-            " contours of \"%s\"\nout to a radius of %.2f %s with an RX "
-            "antenna at %.2f %s AGL",
-            source.name.c_str(),
-            sr.metric ? sr.max_range * KM_PER_MILE : sr.max_range,
-            sr.metric ? "kilometers" : "miles",
-            sr.metric ? altitude * METERS_PER_FOOT : altitude,
-            sr.metric ? "meters" : "feet");
+        if (lrp.erp == 0.0)
+            fprintf(stdout, "path loss");
+        else {
+            if (sr.dbm)
+                fprintf(stdout, "signal power level");
+            else
+                fprintf(stdout, "field strength");
+        }
 
-    if (sr.clutter > 0.0)
-        fprintf(stdout, "\nand %.2f %s of ground sr.clutter",
-                sr.metric ? sr.clutter * METERS_PER_FOOT : sr.clutter,
+        fprintf(stdout,
+                " contours of \"%s\"\nout to a radius of %.2f %s with an RX "
+                "antenna at %.2f %s AGL",
+                sources[i].name.c_str(),
+                sr.metric ? sr.max_range * KM_PER_MILE : sr.max_range,
+                sr.metric ? "kilometers" : "miles",
+                sr.metric ? altitude * METERS_PER_FOOT : altitude,
                 sr.metric ? "meters" : "feet");
 
+        if (sr.clutter > 0.0)
+            fprintf(stdout, "\nand %.2f %s of ground sr.clutter",
+                    sr.metric ? sr.clutter * METERS_PER_FOOT : sr.clutter,
+                    sr.metric ? "meters" : "feet");
+
+        fprintf(stdout, "\n");
+
+        /* Everything derived from the radio parameters alone is worked out
+           once for all of a site's radials. */
+        maps[i].source = &sources[i];
+        maps[i].pat = pats[i];
+        maps[i].lrp = &lrp;
+        maps[i].radio = ItmRadio(lrp.eps_dielect, lrp.sgm_conductivity,
+                                 lrp.eno_ns_surfref, lrp.frq_mhz,
+                                 lrp.radio_climate, lrp.pol, lrp.conf,
+                                 lrp.rel);
+        maps[i].mask_value = mask_value;
+        maps[i].claims = NULL;
+        maps[i].ano = NULL;
+
+        if (mask_value < 30)
+            mask_value++;
+    }
+
+    for (int edge = 0; edge < 4; edge++)
+        radials += EdgeRadials(edge);
+
+    /* Each site's map used to rewrite the alphanumeric output, so it is
+       the last site's that is written. */
     if (plo_filename[0] != 0)
         fd = fopen(plo_filename.c_str(), "wb");
 
@@ -939,194 +1105,149 @@ void ElevationMap::PlotLRMap(const Site &source, double altitude,
             fd,
             "%d, %d\t; max_west, min_west\n%d, %d\t; max_north, min_north\n",
             max_west, min_west, max_north, min_north);
-    }
 
-    /* th=pixels/degree divided by 64 loops per
-       progress indicator symbol (.oOo) printed. */
+        LRMap &last = maps.back();
 
-    th = sr.ppd / 64.0;
-
-    z = (int)(th * Utilities::ReduceAngle(max_west - min_west));
+        last.ano = new AnoWriter(fd, radials, [this, &last](double lat,
+                                                            double lon,
+                                                            int radial) {
+            return Claimant(last, lat, lon, radial);
+        });
+    }
 
-    fprintf(stdout, "\n\n");
+    fprintf(stdout, "\n");
 
-    WorkQueue wq;
+    WorkPool &pool = *sr.pool;
+    MapProgress progress(sr.verbose, radials * (int)maps.size());
 
     if (sr.verbose) {
         if (sr.multithread) {
-            fprintf(stdout, "Using %d threads...\n\n", wq.maxWorkers());
+            fprintf(stdout, "Using %d threads...\n\n", pool.Workers());
         }
         fprintf(stdout, " 0%c to  25%c ", 37, 37);
         fflush(stdout);
     }
 
-    for (lon = minwest, x = 0, y = 0;
-         (Utilities::LonDiff(lon, (double)max_west) <= 0.0);
-         y++, lon = minwest + (sr.dpp * (double)y)) {
-        if (lon >= 360.0)
-            lon -= 360.0;
-
-        edge.lat = max_north;
-        edge.lon = lon;
-        edge.alt = altitude;
-
-        if (sr.multithread) {
-            wq.submit(std::bind(&ElevationMap::PlotLRPath, this, source, edge,
-                                mask_value, fd, std::cref(pat), lrp));
-        } else {
-            PlotLRPath(source, edge, mask_value, fd, pat, lrp);
-        }
-
-        if (sr.verbose) {
-            if (++count == z) {
-                fprintf(stdout, "%c", symbol[x]);
-                fflush(stdout);
-                count = 0;
-
-                if (x == 3)
-                    x = 0;
-                else
-                    x++;
-            }
-        }
-    }
-
-    if (sr.verbose) {
-        count = 0;
-        fprintf(stdout, "\n25%c to  50%c ", 37, 37);
-        fflush(stdout);
+    if (pool.Workers() == 1) {
+        for (i = 0; i < maps.size(); i++)
+            PlotLRJob(maps, i, i + 1, altitude, progress);
+    } else {
+        /* Which of its points the last site's alphanumeric output has lines
+           for depends on what the sites before it left on the mask, so that
+           site waits for them. */
+        alone = fd != NULL ? maps.size() - 1 : maps.size();
+
+        /* Each map's claims take up to 4 bytes a point of the region, so
+           the maps are plotted in as many goes as it takes for their claims
+           to fit in half of sr.maxmem, leaving the rest for terrain. */
+        batch = sr.maxmem / 2 /
+                ClaimLayer::MaxBytes(max((int)dem.size(), 1), sr.ippd);
+        batch = max<size_t>(batch, 1);
+
+        for (i = 0; i < alone; i += batch)
+            PlotLRJob(maps, i, min(i + batch, alone), altitude, progress);
+
+        if (alone < maps.size())
+            PlotLRJob(maps, alone, maps.size(), altitude, progress);
     }
 
-    z = (int)(th * (double)(max_north - min_north));
-
-    for (lat = maxnorth, x = 0, y = 0; lat >= (double)min_north;
-         y++, lat = maxnorth - (sr.dpp * (double)y)) {
-        edge.lat = lat;
-        edge.lon = min_west;
-        edge.alt = altitude;
-
-        if (sr.multithread) {
-            wq.submit(std::bind(&ElevationMap::PlotLRPath, this, source, edge,
-                                mask_value, fd, std::cref(pat), lrp));
-        } else {
-            PlotLRPath(source, edge, mask_value, fd, pat, lrp);
-        }
-
-        if (sr.verbose) {
-            if (++count == z) {
-                fprintf(stdout, "%c", symbol[x]);
-                fflush(stdout);
-                count = 0;
-
-                if (x == 3)
-                    x = 0;
-                else
-                    x++;
-            }
-        }
+    if (fd != NULL) {
+        delete maps.back().ano;
+        fclose(fd);
     }
 
     if (sr.verbose) {
-        count = 0;
-        fprintf(stdout, "\n50%c to  75%c ", 37, 37);
+        fprintf(stdout, "\nDone!\n");
+        fprintf(
+            stdout,
+            "\nThere were %d paths with an average length of %d elements.\n",
+            totalpaths.load(), (int)(totalpathlen / max(totalpaths.load(), 1)));
         fflush(stdout);
     }
+}
 
-    z = (int)(th * Utilities::ReduceAngle(max_west - min_west));
-
-    for (lon = minwest, x = 0, y = 0;
-         (Utilities::LonDiff(lon, (double)max_west) <= 0.0);
-         y++, lon = minwest + (sr.dpp * (double)y)) {
-        if (lon >= 360.0)
-            lon -= 360.0;
-
-        edge.lat = min_north;
-        edge.lon = lon;
-        edge.alt = altitude;
-
-        if (sr.multithread) {
-            wq.submit(std::bind(&ElevationMap::PlotLRPath, this, source, edge,
-                                mask_value, fd, std::cref(pat), lrp));
-        } else {
-            PlotLRPath(source, edge, mask_value, fd, pat, lrp);
-        }
+/* Plots maps first to last - 1 of a run of L-R maps in one go on the workers
+ * and, if there is more than one worker, draws what they claimed.
+ */
+void ElevationMap::PlotLRJob(vector<LRMap> &maps, size_t first, size_t last,
+                             double altitude, MapProgress &progress) {
+    WorkPool &pool = *sr.pool;
+    vector<WorkRange> ranges;
+    int start[4];
+    bool claiming = pool.Workers() > 1, ano = false;
+    size_t i;
+
+    /* The model and the precision of its profiles are picked here, once,
+       rather than for every sample */
+    void (ElevationMap::*plot_path)(const LRMap &, const Site &, int);
+
+    if (sr.propagation_model == PROP_ITWOM)
+        plot_path = sr.double_profiles
+                        ? &ElevationMap::PlotLRPath<ItwomModel, double>
+                        : &ElevationMap::PlotLRPath<ItwomModel, float>;
+    else
+        plot_path = sr.double_profiles
+                        ? &ElevationMap::PlotLRPath<ItmModel, double>
+                        : &ElevationMap::PlotLRPath<ItmModel, float>;
 
-        if (sr.verbose) {
-            if (++count == z) {
-                fprintf(stdout, "%c", symbol[x]);
-                fflush(stdout);
-                count = 0;
+    MapRanges(ranges, pool.Workers(), (int)(last - first), start);
 
-                if (x == 3)
-                    x = 0;
-                else
-                    x++;
-            }
-        }
-    }
+    for (i = first; i < last; i++) {
+        if (claiming)
+            maps[i].claims = NewClaims();
 
-    if (sr.verbose) {
-        count = 0;
-        fprintf(stdout, "\n75%c to 100%c ", 37, 37);
-        fflush(stdout);
+        ano = ano || maps[i].ano != NULL;
     }
 
-    z = (int)(th * (double)(max_north - min_north));
+    /* The writer takes the radials' lines in order, so the workers are kept
+       to neighbouring radials rather than to blocks of them, to hold down
+       the lines waiting on those before them. */
+    if (ano)
+        WorkPool::Interleave(ranges, pool.Workers());
 
-    for (lat = (double)min_north, x = 0, y = 0; lat < (double)max_north;
-         y++, lat = (double)min_north + (sr.dpp * (double)y)) {
-        edge.lat = lat;
-        edge.lon = max_west;
-        edge.alt = altitude;
+    pool.Run(ranges, [&](const WorkRange &range) {
+        const LRMap &map = maps[first + range.edge / 4];
+        int edge = range.edge % 4;
 
-        if (sr.multithread) {
-            wq.submit(std::bind(&ElevationMap::PlotLRPath, this, source, edge,
-                                mask_value, fd, std::cref(pat), lrp));
-        } else {
-            PlotLRPath(source, edge, mask_value, fd, pat, lrp);
-        }
+        for (int i = range.first; i < range.last; i++)
+            (this->*plot_path)(map, EdgeSite(edge, i, altitude),
+                               start[edge] + i);
 
-        if (sr.verbose) {
-            if (++count == z) {
-                fprintf(stdout, "%c", symbol[x]);
-                fflush(stdout);
-                count = 0;
+        progress.Done(range.last - range.first);
+    });
 
-                if (x == 3)
-                    x = 0;
-                else
-                    x++;
-            }
-        }
-    }
+    /* The claims decide which lines are written, so they stay until the
+       writer is done */
+    for (i = first; i < last; i++)
+        if (maps[i].ano != NULL)
+            maps[i].ano->Finish();
 
-    wq.waitForCompletion();
+    if (!claiming)
+        return;
 
-    if (fd != NULL)
-        fclose(fd);
+    DrawSignals(maps, first, last);
 
-    if (sr.verbose) {
-        fprintf(stdout, "\nDone!\n");
-        fprintf(
-            stdout,
-            "\nThere were %d paths with an average length of %d elements.\n",
-            totalpaths, (int)avgpathlen);
-        fflush(stdout);
-    }
-
-    if (mask_value < 30)
-        mask_value++;
+    for (i = first; i < last; i++)
+        FreeClaims(maps[i].claims);
 }
 
-/* Plots the RF path loss between source and destination points based on the
- * ITM/ITWOM propagation model, taking into account antenna pattern data if
- * available.
+/* Plots the RF path loss between a map's source and destination points
+ * based on the ITM/ITWOM propagation model, taking into account antenna
+ * pattern data if available. number is the radial's place in the map's
+ * sweep; a point the radials share is plotted by the first of them.
  */
-void ElevationMap::PlotLRPath(const Site &source, const Site &destination,
-                              unsigned char mask_value, FILE *fd,
-                              const AntennaPattern &pat, const Lrp &lrp) {
-    int x, y, ifs, ofs, errnum;
+template <class Model, typename T>
+void ElevationMap::PlotLRPath(const LRMap &map, const Site &destination,
+                              int number) {
+    const Site &source = *map.source;
+    const AntennaPattern &pat = *map.pat;
+    const Lrp &lrp = *map.lrp;
+    const ItmRadio &radio = map.radio;
+    AnoWriter *ano = map.ano;
+    int x, y, ifs, errnum, tested = 2, level, step, np;
+    int far_np[DEM_LEVELS], far_errnum[DEM_LEVELS];
     char block = 0, strmode[100];
+    double far_loss[DEM_LEVELS];
     double loss, azimuth, pattern = 0.0, xmtr_alt, dest_alt, xmtr_alt2,
                           dest_alt2, cos_rcvr_angle, cos_test_angle = 0.0,
                           test_alt, elevation = 0.0, distance = 0.0,
@@ -1136,31 +1257,85 @@ void ElevationMap::PlotLRPath(const Site &source, const Site &destination,
     char textout[MAX_LINE_LEN];
     size_t textlen = 0;
 
-    Path path(sr.arraysize, sr.ppd);
-    path.ReadPath(source, destination, *this);
+    Radial &scratch = RadialScratch();
+    Path &path = scratch.path;
+
+    /* Cosines of the elevation angles of the points that rise above every
+       point before them, as seen by the transmitter. They only decrease. */
+    vector<double> &peaks = scratch.peaks;
+    vector<double>::iterator peak;
+
+    peaks.clear();
+    path.ReadPath(source, destination, *this, !sr.far_field.empty());
 
     /* XXX debug */
     totalpaths++;
-    UPDATE_RUNNING_AVG(avgpathlen, path.length, totalpaths);
+    totalpathlen += path.length;
 
-    /* XXX why +10? should it just be +2? Better yet, path.length+2? */
-    elev_t elev[sr.arraysize + 10];
+    /* The profile takes elev[2] to elev[path.length + 1]. */
+    Profiles<T> &profiles = scratch.Of<T>();
+    vector<T> &elev = profiles.elev;
+
+    if ((int)elev.size() < path.length + 2)
+        elev.resize(path.length + 2);
 
     four_thirds_earth = FOUR_THIRDS * EARTHRADIUS;
 
     /* Copy elevations plus clutter along path into the elev[] array. */
 
     for (x = 1; x < path.length - 1; x++)
-        elev[x + 2] = (path.elevation[x] == 0.0
-                           ? (elev_t)(path.elevation[x] * METERS_PER_FOOT)
-                           : (elev_t)((sr.clutter + path.elevation[x]) *
-                                      METERS_PER_FOOT));
+        elev[x + 2] =
+            (path.elevation[x] == 0.0
+                 ? (T)(path.elevation[x] * METERS_PER_FOOT)
+                 : (T)((sr.clutter + path.elevation[x]) * METERS_PER_FOOT));
 
     /* Copy ending points without clutter */
 
-    elev[2] = (elev_t)(path.elevation[0] * METERS_PER_FOOT);
+    elev[2] = (T)(path.elevation[0] * METERS_PER_FOOT);
     elev[path.length + 1] =
-        (elev_t)(path.elevation[path.length - 1] * METERS_PER_FOOT);
+        (T)(path.elevation[path.length - 1] * METERS_PER_FOOT);
+
+    /* Walk the profile once, rather than running the propagation model
+       from scratch on every prefix of it. Samples are evenly spaced
+       along the path. Each worker thread keeps one context, so radials
+       on the same thread share its scratch memory. */
+
+    static thread_local ItmContext itm;
+    ItmRadial<Model, T> radial(itm, radio, source.alt * METERS_PER_FOOT,
+                               destination.alt * METERS_PER_FOOT, sr.fast_dh);
+
+    radial.SetProfile(&elev[2], path.length,
+                      METERS_PER_MILE * (path.distance[1] - path.distance[0]));
+
+    /* Beyond the -farfield distances, the loss is worked out on a profile
+       of every 2nd, 4th or 8th point, read from the terrain pyramid, and
+       each of its points stands for the points of the path around it. The
+       model only ever walks one of the profiles at a time, outward, so
+       they share its context. */
+
+    vector<ItmRadial<Model, T>> far;
+
+    for (level = 1; level <= path.levels; level++) {
+        vector<T> &coarse = profiles.coarse[level - 1];
+        const vector<double> &heights = path.coarse[level - 1];
+
+        coarse.resize(heights.size());
+        coarse[0] = (T)(heights[0] * METERS_PER_FOOT);
+
+        for (x = 1; x < (int)heights.size(); x++)
+            coarse[x] =
+                (heights[x] == 0.0
+                     ? (T)(heights[x] * METERS_PER_FOOT)
+                     : (T)((sr.clutter + heights[x]) * METERS_PER_FOOT));
+
+        far.push_back(ItmRadial<Model, T>(
+            itm, radio, source.alt * METERS_PER_FOOT,
+            destination.alt * METERS_PER_FOOT, sr.fast_dh));
+        far.back().SetProfile(&coarse[0], (int)coarse.size(),
+                              METERS_PER_MILE * (1 << level) *
+                                  (path.distance[1] - path.distance[0]));
+        far_np[level - 1] = -1;
+    }
 
     /* Since the only energy the propagation model considers
        reaching the destination is based on what is scattered
@@ -1177,7 +1352,7 @@ void ElevationMap::PlotLRPath(const Site &source, const Site &destination,
         /* Process this point only if it
            has not already been processed. */
 
-        if ((GetMask(path.lat[y], path.lon[y]) & 248) != (mask_value << 3)) {
+        if (!Plotted(map, path.lat[y], path.lon[y], number)) {
             distance = 5280.0 * path.distance[y];
 
             /***
@@ -1211,18 +1386,24 @@ void ElevationMap::PlotLRPath(const Site &source, const Site &destination,
             if (cos_rcvr_angle < -1.0)
                 cos_rcvr_angle = -1.0;
 
-            if (pat.got_elevation_pattern || fd != NULL) {
+            if (pat.got_elevation_pattern || ano != NULL) {
                 /* Determine the elevation angle to the first obstruction
                    along the path IF elevation pattern data is available
-                   or an output (.ano) file has been designated. */
+                   or an output (.ano) file has been designated.
 
-                for (x = 2, block = 0; (x < y && block == 0); x++) {
-                    distance = 5280.0 * path.distance[x];
+                   The angle of each test point doesn't depend on y, so
+                   each is worked out once, as y passes it. Only a point
+                   that rises above all of those before it can be the
+                   first obstruction, so only those running maxima are
+                   kept. */
+
+                for (; tested < y; tested++) {
+                    distance = 5280.0 * path.distance[tested];
 
                     test_alt = four_thirds_earth +
-                               (path.elevation[x] == 0.0
-                                    ? path.elevation[x]
-                                    : path.elevation[x] + sr.clutter);
+                               (path.elevation[tested] == 0.0
+                                    ? path.elevation[tested]
+                                    : path.elevation[tested] + sr.clutter);
 
                     /* Calculate the cosine of the elevation
                        angle of the terrain (test point)
@@ -1238,20 +1419,25 @@ void ElevationMap::PlotLRPath(const Site &source, const Site &destination,
                     if (cos_test_angle < -1.0)
                         cos_test_angle = -1.0;
 
-                    /* Compare these two angles to determine if
-                       an obstruction exists.  Since we're comparing
-                       the cosines of these angles rather than
-                       the angles themselves, the sense of the
-                       following "if" statement is reversed from
-                       what it would be if the angles themselves
-                       were compared. */
-
-                    if (cos_rcvr_angle >= cos_test_angle)
-                        block = 1;
+                    if (peaks.empty() || cos_test_angle < peaks.back())
+                        peaks.push_back(cos_test_angle);
                 }
 
+                /* Compare these two angles to determine if
+                   an obstruction exists.  Since we're comparing
+                   the cosines of these angles rather than
+                   the angles themselves, the sense of the
+                   comparison is reversed from what it would be
+                   if the angles themselves were compared: the
+                   first obstruction is the first peak whose
+                   cosine is no more than the receiver's. */
+
+                peak = lower_bound(peaks.begin(), peaks.end(), cos_rcvr_angle,
+                                   greater<double>());
+                block = peak != peaks.end();
+
                 if (block)
-                    elevation = ((acos(cos_test_angle)) / DEG2RAD) - 90.0;
+                    elevation = ((acos(*peak)) / DEG2RAD) - 90.0;
                 else
                     elevation = ((acos(cos_rcvr_angle)) / DEG2RAD) - 90.0;
             }
@@ -1262,34 +1448,33 @@ void ElevationMap::PlotLRPath(const Site &source, const Site &destination,
                shortest distance terrain can play a role in
                path loss. */
 
-            elev[0] = (elev_t)(y - 1); /* (number of points - 1) */
-
-            /* Distance between elevation samples */
-
-            elev[1] = (elev_t)(METERS_PER_MILE *
-                               (path.distance[y] - path.distance[y - 1]));
+            level = min(FarFieldLevel(path.distance[y]), path.levels);
+
+            if (level == 0) {
+                radial.PathLoss(y - 1, loss, strmode, errnum);
+            } else {
+                /* The coarse point nearest to the one the full profile
+                   would end at */
+                step = 1 << level;
+                np = min(max((y - 1 + step / 2) / step, 1),
+                         (int)path.coarse[level - 1].size() - 1);
+
+                if (np != far_np[level - 1]) {
+                    far[level - 1].PathLoss(np, far_loss[level - 1], strmode,
+                                            far_errnum[level - 1]);
+                    far_np[level - 1] = np;
+                }
 
-            if (sr.propagation_model == PROP_ITWOM)
-                point_to_point(elev, source.alt * METERS_PER_FOOT,
-                               destination.alt * METERS_PER_FOOT,
-                               lrp.eps_dielect, lrp.sgm_conductivity,
-                               lrp.eno_ns_surfref, lrp.frq_mhz,
-                               lrp.radio_climate, lrp.pol, lrp.conf, lrp.rel,
-                               loss, strmode, errnum);
-            else
-                point_to_point_ITM(elev, source.alt * METERS_PER_FOOT,
-                                   destination.alt * METERS_PER_FOOT,
-                                   lrp.eps_dielect, lrp.sgm_conductivity,
-                                   lrp.eno_ns_surfref, lrp.frq_mhz,
-                                   lrp.radio_climate, lrp.pol, lrp.conf,
-                                   lrp.rel, loss, strmode, errnum);
+                loss = far_loss[level - 1];
+                errnum = far_errnum[level - 1];
+            }
 
             temp.lat = path.lat[y];
             temp.lon = path.lon[y];
 
             azimuth = (source.Azimuth(temp));
 
-            if (fd != NULL) {
+            if (ano != NULL) {
                 textlen =
                     snprintf(textout, MAX_LINE_LEN, "%.7f, %.7f, %.3f, %.3f, ",
                              path.lat[y], path.lon[y], azimuth, elevation);
@@ -1299,7 +1484,7 @@ void ElevationMap::PlotLRPath(const Site &source, const Site &destination,
                output file.  Otherwise, write field strength
                or received power level (below), as appropriate. */
 
-            if (fd != NULL && lrp.erp == 0.0) {
+            if (ano != NULL && lrp.erp == 0.0) {
                 textlen += snprintf(textout + textlen, MAX_LINE_LEN - textlen,
                                     "%.2f", loss);
             }
@@ -1329,7 +1514,7 @@ void ElevationMap::PlotLRPath(const Site &source, const Site &destination,
 
                     dBm = 10.0 * (log10(rxp * 1000.0));
 
-                    if (fd != NULL) {
+                    if (ano != NULL) {
                         textlen +=
                             snprintf(textout + textlen, MAX_LINE_LEN - textlen,
                                      "%.3f", dBm);
@@ -1344,14 +1529,6 @@ void ElevationMap::PlotLRPath(const Site &source, const Site &destination,
 
                     if (ifs > 255)
                         ifs = 255;
-
-                    ofs = GetSignal(path.lat[y], path.lon[y]);
-
-                    if (ofs > ifs)
-                        ifs = ofs;
-
-                    // writes to dem
-                    PutSignal(path.lat[y], path.lon[y], (unsigned char)ifs);
                 }
 
                 else {
@@ -1367,14 +1544,7 @@ void ElevationMap::PlotLRPath(const Site &source, const Site &destination,
                     if (ifs > 255)
                         ifs = 255;
 
-                    ofs = GetSignal(path.lat[y], path.lon[y]);
-
-                    if (ofs > ifs)
-                        ifs = ofs;
-
-                    PutSignal(path.lat[y], path.lon[y], (unsigned char)ifs);
-
-                    if (fd != NULL) {
+                    if (ano != NULL) {
                         textlen +=
                             snprintf(textout + textlen, MAX_LINE_LEN - textlen,
                                      "%.3f", field_strength);
@@ -1387,38 +1557,32 @@ void ElevationMap::PlotLRPath(const Site &source, const Site &destination,
                     ifs = 255;
                 else
                     ifs = (int)rint(loss);
-
-                ofs = GetSignal(path.lat[y], path.lon[y]);
-
-                if (ofs < ifs && ofs != 0)
-                    ifs = ofs;
-
-                PutSignal(path.lat[y], path.lon[y], (unsigned char)ifs);
             }
 
-            if (fd != NULL) {
+            PlotSignal(map, path.lat[y], path.lon[y], number, ifs);
+
+            if (ano != NULL) {
                 textlen += snprintf(textout + textlen, MAX_LINE_LEN - textlen,
                                     "%s", block ? " *\n" : "\n");
+                scratch.ano.Add(path.lat[y], path.lon[y], textout, textlen);
             }
-
-            fwrite(textout, 1, textlen, fd);
-
-            /* Mark this point as having been analyzed */
-
-            PutMask(path.lat[y], path.lon[y],
-                    (GetMask(path.lat[y], path.lon[y]) & 7) +
-                        (mask_value << 3));
         }
     }
+
+    if (ano != NULL)
+        ano->Commit(number, scratch.ano);
 }
 
 void ElevationMap::LoadTopoData(int max_lon, int min_lon, int max_lat,
                                 int min_lat, Sdf &sdf) {
-    /* This function loads the SDF files required
-     to cover the limits of the region specified. */
+    /* This function adds the pages required to cover the
+     limits of the region specified. Their SDF files are
+     read when the pages are first used. */
 
     int x, y, width, ymin, ymax;
 
+    this->sdf = &sdf;
+
     width = Utilities::ReduceAngle(max_lon - min_lon);
 
     if ((max_lon - min_lon) <= 180.0) {
@@ -1440,7 +1604,7 @@ void ElevationMap::LoadTopoData(int max_lon, int min_lon, int max_lat,
                 while (ymax >= 360)
                     ymax -= 360;
 
-                sdf.LoadSDF(*this, x, x + 1, ymin, ymax);
+                AddPage(x, x + 1, ymin, ymax);
             }
     }
 
@@ -1463,7 +1627,7 @@ void ElevationMap::LoadTopoData(int max_lon, int min_lon, int max_lat,
                 while (ymax >= 360)
                     ymax -= 360;
 
-                sdf.LoadSDF(*this, x, x + 1, ymin, ymax);
+                AddPage(x, x + 1, ymin, ymax);
             }
     }
 }
@@ -1473,14 +1637,21 @@ void ElevationMap::LoadTopoData(int max_lon, int min_lon, int max_lat,
  * complimentary PutSignal() function.
  */
 unsigned char ElevationMap::GetSignal(double lat, double lon) const {
-    int x, y;
-    const Dem *dem;
+    int x, y, indx;
 
-    dem = FindDEM(lat, lon, x, y);
-    if (!dem)
+    if (!FindMask(lat, lon, x, y, indx))
         return 0;
 
-    return (dem->signal[x * sr.ippd + y]);
+    return Signal(&dem[indx], x, y);
+}
+
+/* The signal level at x, y of a page found by FindDEM(), or 0 if no signal
+ * was ever written to the page.
+ */
+unsigned char ElevationMap::Signal(const Dem *dem, int x, int y) const {
+    const unsigned char *signal = dem->signal.load(std::memory_order_acquire);
+
+    return signal == NULL ? 0 : signal[sr.Cell(x, y)];
 }
 
 /* Writes a signal level (0-255) at the specified location
@@ -1488,31 +1659,743 @@ unsigned char ElevationMap::GetSignal(double lat, double lon) const {
  * Returns the signal value just set.
  */
 int ElevationMap::PutSignal(double lat, double lon, unsigned char signal) {
-    int x, y;
-    Dem *dem;
+    int x, y, indx;
+    unsigned char *layer;
 
-    dem = (Dem *)FindDEM(lat, lon, x, y);
-    if (!dem)
+    if (!FindMask(lat, lon, x, y, indx))
         return 0;
 
-    dem->signal[x * sr.ippd + y] = signal;
-    return (dem->signal[x * sr.ippd + y]);
+    layer = Layer(dem[indx].signal);
+    layer[sr.Cell(x, y)] = signal;
+    return (layer[sr.Cell(x, y)]);
+}
+
+/* A signal level merged with the one an earlier site left at the point: the
+ * strongest signal or, for path loss, the least loss, 0 being none.
+ */
+static int MergeSignal(int ofs, int ifs, bool loss) {
+    if (loss ? (ofs < ifs && ofs != 0) : ofs > ifs)
+        return ofs;
+
+    return ifs;
+}
+
+/* The signal level a claim of PlotSignal() holds. A level below zero only
+ * keeps its low byte, which is all that is stored of it, but stays below
+ * zero for MergeSignal().
+ */
+static int ClaimLevel(unsigned claim) {
+    return (int)(claim & 255) - (claim & 256 ? 256 : 0);
+}
+
+/* Whether a line-of-sight map has already seen the point from its site, or
+ * the point is off the map
+ */
+bool ElevationMap::Seen(double lat, double lon,
+                        unsigned char mask_value) const {
+    int x, y, indx;
+
+    if (!FindMask(lat, lon, x, y, indx))
+        return true;
+
+    if (Mask(&dem[indx], x, y) & mask_value)
+        return true;
+
+    return seen != NULL && seen->Get(indx, x, y) != 0;
+}
+
+/* Marks a point as seen by a line-of-sight map */
+void ElevationMap::See(double lat, double lon, unsigned char mask_value) {
+    int x, y, indx;
+
+    if (seen == NULL) {
+        OrMask(lat, lon, mask_value);
+        return;
+    }
+
+    if (FindMask(lat, lon, x, y, indx))
+        seen->Claim(indx, x, y, 1);
+}
+
+/* Whether an L-R map has already plotted the point: it is marked with the
+ * map's mask value or, while claiming, this radial or an earlier one has
+ * claimed it. The mask is then left to DrawSignals(), as the maps before
+ * this one may not have been drawn on it yet. Points off the map never are.
+ */
+bool ElevationMap::Plotted(const LRMap &map, double lat, double lon,
+                           int radial) const {
+    int x, y, indx;
+    unsigned owner;
+
+    if (!FindMask(lat, lon, x, y, indx))
+        return false;
+
+    if (map.claims == NULL)
+        return (Mask(&dem[indx], x, y) & 248) == (map.mask_value << 3);
+
+    owner = map.claims->Get(indx, x, y) >> ClaimLayer::DATA_BITS;
+
+    return owner != 0 && owner <= (unsigned)radial + 1;
+}
+
+/* Plots the signal level an L-R map worked out for a point: merges it with
+ * what earlier sites left there and marks the point as plotted or, while
+ * claiming, claims the point with it for the radial, unless an earlier
+ * radial already has. A claim holds the radial's number plus one, then
+ * whether the level is below zero, as a path loss with a null of the
+ * antenna pattern taken off it is, then its low byte. See ClaimLevel().
+ */
+void ElevationMap::PlotSignal(const LRMap &map, double lat, double lon,
+                              int radial, int level) {
+    int x, y, indx;
+
+    if (map.claims == NULL) {
+        PutSignal(lat, lon,
+                  (unsigned char)MergeSignal(GetSignal(lat, lon), level,
+                                             map.lrp->erp == 0.0));
+        PutMask(lat, lon, (GetMask(lat, lon) & 7) + (map.mask_value << 3));
+        return;
+    }
+
+    if (FindMask(lat, lon, x, y, indx))
+        map.claims->Claim(indx, x, y,
+                          ((unsigned)radial + 1) << ClaimLayer::DATA_BITS |
+                              (unsigned)(level < 0) << 8 |
+                              ((unsigned)level & 255));
 }
 
 /* Returns the first DEM containing the lat/long,
- * or NULL if not found.
+ * or NULL if not found, reading its terrain if it is not in memory.
  *
  * x and y will contain the offsets into the DEM array of
  * the coordinate.
  */
 const Dem *ElevationMap::FindDEM(double lat, double lon, int &x, int &y) const {
-    for (int i = 0; i < sr.maxpages; ++i) {
-        x = (int)rint(sr.ppd * (lat - (double)dem[i].min_north));
-        y = sr.mpi - (int)rint(sr.ppd * (Utilities::LonDiff(
-                                            (double)dem[i].max_west, lon)));
+    int indx;
+
+    if (!FindMask(lat, lon, x, y, indx))
+        return NULL;
+
+    if (!dem[indx].present.load(std::memory_order_acquire))
+        const_cast<ElevationMap *>(this)->LoadPage(indx);
+
+    return &dem[indx];
+}
+
+/* Radial memory of the calling thread. Each worker keeps its own and reuses
+   it for every radial it walks, so that the arrays only grow when a longer
+   path comes along, rather than being allocated per radial, or taken from
+   the stack at the size of the longest possible path. The sizes come from
+   sr, which does not change during a run. */
+ElevationMap::Radial &ElevationMap::RadialScratch() const {
+    static thread_local Radial scratch(sr.arraysize, sr.ppd);
+
+    return scratch;
+}
+
+template <>
+ElevationMap::Profiles<float> &ElevationMap::Radial::Of<float>() {
+    return profiles_f;
+}
+
+template <>
+ElevationMap::Profiles<double> &ElevationMap::Radial::Of<double>() {
+    return profiles_d;
+}
+
+/* Returns the slot of page_index for a page with the given min_north and
+ * max_west, or -1 if there is none.
+ */
+int ElevationMap::PageKey(int north, int west) const {
+    if (north < -90 || north > 90)
+        return -1;
+
+    return (north + 90) * 360 + ((west % 360) + 360) % 360;
+}
+
+/* Rebuilds page_index from the corners of the pages in dem[]. This must be
+ * called whenever a page is added, so that FindDEM() can find it.
+ */
+void ElevationMap::IndexPages() {
+    page_index.assign(181 * 360, -1);
+
+    for (int i = (int)dem.size() - 1; i >= 0; i--) {
+        int key = PageKey(dem[i].min_north, dem[i].max_west);
+
+        if (key >= 0)
+            page_index[key] = i;
+    }
+}
+
+/* Adds the page with the given limits to the end of dem[], unless it is
+ * already there or -maxpages pages are, and finds its SDF. Its terrain is
+ * read when it is first used, by LoadPage().
+ */
+void ElevationMap::AddPage(int minlat, int maxlat, int minlon, int maxlon) {
+    int indx = (int)dem.size();
+
+    for (int i = 0; i < indx; i++) {
+        if (minlat == dem[i].min_north && minlon == dem[i].min_west &&
+            maxlat == dem[i].max_north && maxlon == dem[i].max_west)
+            return;
+    }
 
-        if (x >= 0 && x <= sr.mpi && y >= 0 && y <= sr.mpi)
-            return &dem[i];
+    if (sr.maxpages > 0 && indx >= sr.maxpages)
+        return;
+
+    dem.emplace_back();
+
+    Dem &page = dem[indx];
+
+    page.max_west = maxlon;
+    page.min_north = minlat;
+    page.min_west = minlon;
+    page.max_north = maxlat;
+
+    sdf->FindSDF(page, indx);
+    IndexPages();
+
+    if (max_north == -90) {
+        max_north = page.max_north;
+    } else if (page.max_north > max_north) {
+        max_north = page.max_north;
+    }
+
+    if (min_north == 90) {
+        min_north = page.min_north;
+    } else if (page.min_north < min_north) {
+        min_north = page.min_north;
+    }
+
+    if (max_west == -1) {
+        max_west = page.max_west;
+    } else {
+        if (abs(page.max_west - max_west) < 180) {
+            if (page.max_west > max_west)
+                max_west = page.max_west;
+        } else {
+            if (page.max_west < max_west)
+                max_west = page.max_west;
+        }
+    }
+
+    if (min_west == 360) {
+        min_west = page.min_west;
+    } else {
+        if (abs(page.min_west - min_west) < 180) {
+            if (page.min_west < min_west)
+                min_west = page.min_west;
+        } else {
+            if (page.min_west > min_west)
+                min_west = page.min_west;
+        }
+    }
+}
+
+/* Brings the terrain of dem[indx] into memory, reading its SDF file. The
+ * first time, this also folds its elevations into min_elevation and
+ * max_elevation.
+ *
+ * Any thread may call this. The lock is only held to account for the page
+ * and to evict others, if the page would take more than sr.maxmem in all,
+ * so different pages are read concurrently. Threads that want a page that
+ * is being read wait for it.
+ */
+void ElevationMap::LoadPage(int indx) {
+    std::unique_lock<std::mutex> lock(page_lock);
+    Dem &page = dem[indx];
+    size_t cells = (size_t)sr.ippd * sr.ippd;
+    unsigned now;
+    bool first, constant = false;
+
+    while (page.loading)
+        page_loaded.wait(lock);
+
+    /* Another thread got here first */
+    if (page.present.load(std::memory_order_relaxed) &&
+        (page.seq.load(std::memory_order_relaxed) & 1) == 0)
+        return;
+
+    now = clock.fetch_add(1, std::memory_order_relaxed) + 1;
+    page.used.store(now, std::memory_order_relaxed);
+    first = !page.present.load(std::memory_order_relaxed);
+
+    EvictPages(cells * sizeof(short), now);
+
+    page_bytes += cells * sizeof(short);
+    page.loading = true;
+    lock.unlock();
+
+    /* seq is odd: readers wait until it is even again. Terrain mapped
+       from a binary SDF is read back from the file as it is touched. Each
+       read gets an Sdf of its own, since they hold the open file. */
+    if (!page.map_file) {
+        Sdf reader(*sdf);
+        reader.LoadSDF(page, indx);
+        constant = first && !page.map_file && Constant(page);
+    }
+
+    if (first && !constant && !sr.far_field.empty())
+        BuildLevels(page);
+
+    lock.lock();
+
+    if (constant)
+        ShareTerrain(page);
+
+    if (page.levels != NULL && first)
+        page_bytes += LevelBytes();
+    page.seq.store(page.seq.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_release);
+
+    if (first) {
+        if (page.min_el < min_elevation)
+            min_elevation = page.min_el;
+
+        if (page.max_el > max_elevation)
+            max_elevation = page.max_el;
+
+        page.present.store(true, std::memory_order_release);
     }
-    return NULL;
+
+    page.loading = false;
+    page_loaded.notify_all();
+}
+
+/* Returns a page's mask or signal layer, setting it up on first use. The
+ * layers are apart from the terrain, so runs that never draw on a page, or
+ * never plot signals, don't hold memory for them, and they stay when the
+ * terrain is evicted.
+ */
+unsigned char *ElevationMap::Layer(std::atomic<unsigned char *> &layer) {
+    unsigned char *cells = layer.load(std::memory_order_acquire);
+    size_t bytes = (size_t)sr.ippd * sr.ippd;
+
+    if (cells != NULL)
+        return cells;
+
+    std::lock_guard<std::mutex> lock(page_lock);
+
+    /* Another thread got here first */
+    cells = layer.load(std::memory_order_relaxed);
+
+    if (cells != NULL)
+        return cells;
+
+    EvictPages(bytes, clock.load(std::memory_order_relaxed));
+
+    cells = (unsigned char *)SysUtil::MapMemory(bytes);
+
+    if (cells == NULL) {
+        fprintf(stderr, "\n*** ERROR: Out of memory for the mask and signal "
+                        "layers.\n");
+        exit(-1);
+    }
+
+    page_bytes += bytes;
+    layer.store(cells, std::memory_order_release);
+    return cells;
+}
+
+/* Whether a radial's plot of a point is the one that stands: the radial
+ * claimed the point, no earlier one has since, and the map is not already
+ * marked there as having plotted it. Points off the map always are. Only
+ * once every radial before this one is done does it hold for good, and the
+ * mask only holds still while no other map is being plotted.
+ */
+bool ElevationMap::Claimant(const LRMap &map, double lat, double lon,
+                            int radial) const {
+    int x, y, indx;
+
+    if (map.claims == NULL || !FindMask(lat, lon, x, y, indx))
+        return true;
+
+    if ((Mask(&dem[indx], x, y) & 248) == (map.mask_value << 3))
+        return false;
+
+    return map.claims->Get(indx, x, y) >> ClaimLayer::DATA_BITS ==
+           (unsigned)radial + 1;
+}
+
+/* Draws the points seen by a line-of-sight map plotted on more than one
+ * thread on the mask, a page per worker.
+ */
+void ElevationMap::DrawClaims(unsigned char mask_value) {
+    vector<WorkRange> ranges;
+    WorkRange range;
+    int blocks = seen->Blocks();
+
+    for (int i = 0; i < (int)dem.size(); i++) {
+        if (!seen->Reached(i))
+            continue;
+
+        range.edge = 0;
+        range.first = i;
+        range.last = i + 1;
+        ranges.push_back(range);
+    }
+
+    sr.pool->Run(ranges, [&](const WorkRange &range) {
+        unsigned char *mask = Layer(dem[range.first].mask);
+        const std::atomic<unsigned> *claims;
+        int x, y;
+
+        for (int b = 0; b < blocks * blocks; b++) {
+            claims = seen->Block(range.first, b);
+
+            if (claims == NULL)
+                continue;
+
+            for (int n = 0; n < ClaimLayer::BLOCK * ClaimLayer::BLOCK; n++) {
+                x = b / blocks * ClaimLayer::BLOCK + n / ClaimLayer::BLOCK;
+                y = b % blocks * ClaimLayer::BLOCK + n % ClaimLayer::BLOCK;
+
+                if (x < sr.ippd && y < sr.ippd &&
+                    claims[n].load(std::memory_order_relaxed) != 0)
+                    mask[sr.Cell(x, y)] |= mask_value;
+            }
+        }
+    });
+}
+
+/* Draws the points claimed by maps first to last - 1 of a run of L-R maps
+ * on the mask and signal layers, a page per worker. Each point is drawn for
+ * one map after another, in their order, with the level of the first radial
+ * of the map to reach it, just as plotting the maps one after another would
+ * have: a map only merges its level where it has not already plotted the
+ * point, and then marks it as plotted.
+ */
+void ElevationMap::DrawSignals(const vector<LRMap> &maps, size_t first,
+                               size_t last) {
+    vector<WorkRange> ranges;
+    WorkRange range;
+    int blocks = maps[first].claims->Blocks();
+    size_t k;
+
+    for (int i = 0; i < (int)dem.size(); i++) {
+        for (k = first; k < last; k++)
+            if (maps[k].claims->Reached(i))
+                break;
+
+        if (k == last)
+            continue;
+
+        range.edge = 0;
+        range.first = i;
+        range.last = i + 1;
+        ranges.push_back(range);
+    }
+
+    sr.pool->Run(ranges, [&](const WorkRange &range) {
+        Dem &page = dem[range.first];
+        unsigned char *mask = Layer(page.mask);
+        unsigned char *signal = Layer(page.signal);
+        vector<const std::atomic<unsigned> *> claims(last - first);
+        unsigned char plotted;
+        unsigned claim;
+        bool any;
+        size_t k;
+        int x, y, c;
+
+        for (int b = 0; b < blocks * blocks; b++) {
+            any = false;
+
+            for (k = first; k < last; k++) {
+                claims[k - first] = maps[k].claims->Block(range.first, b);
+                any = any || claims[k - first] != NULL;
+            }
+
+            if (!any)
+                continue;
+
+            for (int n = 0; n < ClaimLayer::BLOCK * ClaimLayer::BLOCK; n++) {
+                x = b / blocks * ClaimLayer::BLOCK + n / ClaimLayer::BLOCK;
+                y = b % blocks * ClaimLayer::BLOCK + n % ClaimLayer::BLOCK;
+
+                if (x >= sr.ippd || y >= sr.ippd)
+                    continue;
+
+                c = sr.Cell(x, y);
+
+                for (k = first; k < last; k++) {
+                    if (claims[k - first] == NULL)
+                        continue;
+
+                    claim = claims[k - first][n].load(std::memory_order_relaxed);
+                    plotted = maps[k].mask_value << 3;
+
+                    if (claim == 0 || (mask[c] & 248) == plotted)
+                        continue;
+
+                    signal[c] = (unsigned char)MergeSignal(
+                        signal[c], ClaimLevel(claim),
+                        maps[k].lrp->erp == 0.0);
+                    mask[c] = (mask[c] & 7) + plotted;
+                }
+            }
+        }
+    });
+}
+
+/* Whether the page's terrain, just read into memory of its own, is all one
+ * height, as it is for pages assumed to be at sea-level.
+ */
+bool ElevationMap::Constant(const Dem &page) const {
+    size_t cells = (size_t)sr.ippd * sr.ippd;
+
+    for (size_t i = 1; i < cells; i++) {
+        if (page.data[i] != page.data[0])
+            return false;
+    }
+
+    return true;
+}
+
+/* Builds the terrain pyramid of a page that was just read, for -farfield.
+ * Each level keeps the highest of 2 x 2 points of the one below, so a point
+ * of level n is the highest of the 2^n x 2^n points of terrain it covers. A
+ * profile that samples level n every 2^n points then never runs below the
+ * terrain it stands for, and above it by at most the relief within a cell:
+ * ridges narrower than a cell keep their height, where averaging would
+ * flatten them and the obstructions that decide the loss behind them.
+ */
+void ElevationMap::BuildLevels(Dem &page) {
+    int level, step, x, y;
+
+    page.levels = (short *)SysUtil::MapMemory(LevelBytes());
+
+    if (page.levels == NULL) {
+        fprintf(stderr, "\n*** ERROR: Out of memory for the terrain "
+                        "pyramid.\n");
+        exit(-1);
+    }
+
+    for (level = 1; level <= DEM_LEVELS; level++) {
+        step = 1 << level;
+
+        for (x = 0; x < sr.ippd; x += step) {
+            for (y = 0; y < sr.ippd; y += step)
+                LevelPoint(page, level, x, y) = LevelMax(page, level, x, y);
+        }
+    }
+}
+
+/* The highest of the 2 x 2 points of the level below that make up the
+ * point of the given level holding x, y (in points of the page's terrain).
+ */
+short ElevationMap::LevelMax(const Dem &page, int level, int x, int y) const {
+    int half = 1 << (level - 1), height = -32768;
+
+    x = x >> level << level;
+    y = y >> level << level;
+
+    for (int i = 0; i < 2; i++) {
+        for (int j = 0; j < 2; j++) {
+            if (level == 1)
+                height = max(height, (int)page.data[sr.Cell(x + i, y + j)]);
+            else
+                height = max(height, (int)LevelPoint(page, level - 1,
+                                                     x + i * half,
+                                                     y + j * half));
+        }
+    }
+
+    return (short)height;
+}
+
+/* The point of a level of the page's pyramid that holds x, y (in points of
+ * the page's terrain).
+ */
+short &ElevationMap::LevelPoint(const Dem &page, int level, int x,
+                                int y) const {
+    size_t offset = 0;
+
+    for (int i = 1; i < level; i++)
+        offset += (size_t)(sr.ippd >> i) * (sr.ippd >> i);
+
+    return page.levels[offset + (size_t)(x >> level) * (sr.ippd >> level) +
+                       (y >> level)];
+}
+
+/* Memory for one page's pyramid */
+size_t ElevationMap::LevelBytes() const {
+    size_t points = 0;
+
+    for (int i = 1; i <= DEM_LEVELS; i++)
+        points += (size_t)(sr.ippd >> i) * (sr.ippd >> i);
+
+    return points * sizeof(short);
+}
+
+/* Beyond which of the -farfield distances, in miles, the distance lies: the
+ * level of the terrain pyramid to sample there, or 0 for full resolution.
+ */
+int ElevationMap::FarFieldLevel(double distance) const {
+    int level = 0;
+
+    while (level < (int)sr.far_field.size() && distance > sr.far_field[level])
+        level++;
+
+    return level;
+}
+
+/* Points a constant page at the terrain shared by the pages of its height,
+ * releasing its own, so that offshore pages, say, cost nothing beyond their
+ * mask and signal layers. The first page of a height gives up its memory
+ * to be shared. Called with the page lock held.
+ */
+void ElevationMap::ShareTerrain(Dem &page) {
+    short *&shared = constant_terrain[page.data[0]];
+
+    if (shared == NULL)
+        shared = page.data;
+    else
+        SysUtil::UnmapMemory(page.map, page.map_bytes);
+
+    page_bytes -= page.map_bytes;
+    page.data = shared;
+    page.map = NULL;
+    page.map_bytes = 0;
+    page.constant = true;
+}
+
+/* Gives a constant page a copy of its terrain of its own, before the copy
+ * is changed.
+ */
+void ElevationMap::UnshareTerrain(Dem &page) {
+    std::lock_guard<std::mutex> lock(page_lock);
+    size_t bytes = sizeof(short) * sr.ippd * sr.ippd;
+    short *data = (short *)SysUtil::MapMemory(bytes);
+
+    if (data == NULL) {
+        fprintf(stderr, "\n*** ERROR: Could not allocate memory for a "
+                        "page\n");
+        exit(-1);
+    }
+
+    memcpy(data, page.data, bytes);
+    page_bytes += bytes;
+    page.data = data;
+    page.map = data;
+    page.map_bytes = bytes;
+    page.map_file = false;
+    page.constant = false;
+}
+
+/* Evicts the terrain of the least recently used pages until needed more
+ * bytes fit in sr.maxmem. Pages used since the last read (now - 1) or
+ * changed in memory are kept, even if that means going over.
+ */
+void ElevationMap::EvictPages(unsigned long long needed, unsigned now) {
+    size_t bytes = sizeof(short) * sr.ippd * sr.ippd;
+
+    while (page_bytes + needed > sr.maxmem) {
+        int victim = -1;
+        unsigned oldest = now - 1;
+
+        for (int i = 0; i < (int)dem.size(); i++) {
+            unsigned used = dem[i].used.load(std::memory_order_relaxed);
+
+            if ((dem[i].seq.load(std::memory_order_relaxed) & 1) ||
+                dem[i].pinned || dem[i].constant ||
+                (int)(used - oldest) >= 0)
+                continue;
+
+            victim = i;
+            oldest = used;
+        }
+
+        if (victim < 0)
+            return;
+
+        /* Make seq odd before the terrain goes, so that a reader that
+           started on it will find out and read it again. */
+        Dem &page = dem[victim];
+        page.seq.store(page.seq.load(std::memory_order_relaxed) + 1,
+                       std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        if (page.map_file)
+            SysUtil::DiscardFile(page.data, bytes);
+        else
+            SysUtil::DiscardMemory(page.data, bytes);
+        page_bytes -= bytes;
+    }
+}
+
+/* A claim layer for a map plotted on several threads. Its memory is
+ * counted against sr.maxmem as it is set up, evicting terrain to make room
+ * as LoadPage() does.
+ */
+ClaimLayer *ElevationMap::NewClaims() {
+    return new ClaimLayer((int)dem.size(), sr.ippd, [this](size_t bytes) {
+        std::lock_guard<std::mutex> lock(page_lock);
+
+        EvictPages(bytes, clock.load(std::memory_order_relaxed));
+        page_bytes += bytes;
+    });
+}
+
+/* Releases a claim layer from NewClaims(), and the memory counted for it */
+void ElevationMap::FreeClaims(ClaimLayer *&claims) {
+    std::lock_guard<std::mutex> lock(page_lock);
+
+    page_bytes -= claims->Bytes();
+    delete claims;
+    claims = NULL;
+}
+
+/* Returns the terrain height, in meters, at x, y of a page found by
+ * FindDEM(), reading the page back in if it was evicted.
+ *
+ * The terrain may be evicted while it is being read. seq changes if it is,
+ * so reading it before and after tells whether the height can be trusted.
+ */
+short ElevationMap::Height(const Dem *dem, int x, int y) const {
+    unsigned now = clock.load(std::memory_order_relaxed);
+    Dem *page = (Dem *)dem;
+    unsigned seq;
+    short height;
+
+    if (page->used.load(std::memory_order_relaxed) != now)
+        page->used.store(now, std::memory_order_relaxed);
+
+    for (;;) {
+        seq = page->seq.load(std::memory_order_acquire);
+
+        if (seq & 1) {
+            const_cast<ElevationMap *>(this)->LoadPage(
+                page_index[PageKey(page->min_north, page->max_west)]);
+            continue;
+        }
+
+        height = page->data[sr.Cell(x, y)];
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if (page->seq.load(std::memory_order_relaxed) == seq)
+            return height;
+    }
+}
+
+/* Reads every page that has not been used yet, so that min_elevation and
+ * max_elevation cover the whole map, as they must before drawing it. The
+ * pages are read concurrently unless running single threaded.
+ */
+void ElevationMap::ReadAllPages() {
+    WorkPool &pool = *sr.pool;
+    vector<WorkRange> ranges;
+    WorkRange range;
+
+    for (int i = 0; i < (int)dem.size(); i++) {
+        if (dem[i].present.load())
+            continue;
+
+        range.edge = 0;
+        range.first = i;
+        range.last = i + 1;
+        ranges.push_back(range);
+    }
+
+    pool.Run(ranges, [this](const WorkRange &range) { LoadPage(range.first); });
 }
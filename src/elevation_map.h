@@ -19,22 +19,105 @@
 #include "site.h"
 #include "lrp.h"
 #include "antenna_pattern.h"
-
+#include "ano_writer.h"
+#include "claim_layer.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
 #include <stdio.h>
 #include <string>
 #include <vector>
 
+struct WorkRange;
+class MapProgress;
 class Sdf; // LoadTopoData requires an Sdf, but Sdfs need an ElevationMap to load into
 
 class ElevationMap {
 
   private:
     const SplatRun &sr;
-    double avgpathlen;
-    int totalpaths;
+
+    /* Paths plotted by L-R maps, and their points, for the verbose summary */
+    std::atomic<int> totalpaths;
+    std::atomic<long long> totalpathlen;
+
+    /* The points seen by the line-of-sight map being plotted on more than
+       one thread, or NULL. Its radials claim the points they see, rather
+       than drawing on the mask, until DrawClaims(). */
+    ClaimLayer *seen;
+
+    /* dem[] index of the first page for each integer degree of min_north
+       and max_west, or -1. See IndexPages(). */
+    std::vector<int> page_index;
+
+    /* Reads pages as they are first used. See LoadPage(). */
+    Sdf *sdf;
+    std::mutex page_lock;
+    std::condition_variable page_loaded;
+
+    /* Bumped whenever a page is read. Pages note it when they are used, and
+       the least recently used are evicted first. */
+    std::atomic<unsigned> clock;
+
+    /* Memory held by pages: terrain in memory, and the masks and signals
+       set up so far. The claims of the maps being plotted are counted in
+       too. */
+    unsigned long long page_bytes;
+
+    /* The terrain shared by constant pages, by height. Guarded by the page
+       lock. See ShareTerrain(). */
+    std::map<short, short *> constant_terrain;
+
+    /* The model's profiles of one radial, in heights of type T */
+    template <typename T> struct Profiles {
+        std::vector<T> elev;
+
+        /* at far-field spacings */
+        std::vector<T> coarse[DEM_LEVELS];
+    };
+
+    /* Memory for walking one radial: its path, the model's profiles, and
+       the running obstruction maxima. See RadialScratch(). */
+    struct Radial {
+        Path path;
+        std::vector<double> peaks;
+
+        /* Profiles in float heights, or in double with -double */
+        Profiles<float> profiles_f;
+        Profiles<double> profiles_d;
+
+        /* The radial's lines of alphanumeric output */
+        AnoWriter::Text ano;
+
+        Radial(int size, double ppd) : path(size, ppd) {}
+
+        template <typename T> Profiles<T> &Of();
+    };
+
+    /* One transmitter's map in a run of L-R maps. See PlotLRMaps(). */
+    struct LRMap {
+        const Site *source;
+        const AntennaPattern *pat;
+        const Lrp *lrp;
+        ItmRadio radio;
+        unsigned char mask_value;
+
+        /* The points its radials plot, when plotted on more than one
+           thread, or NULL for them to draw on the mask and signal layers */
+        ClaimLayer *claims;
+
+        /* Where its lines of alphanumeric output go, or NULL */
+        AnoWriter *ano;
+    };
 
   public:
-    std::vector<Dem> dem;
+    /* The pages of the region, added by LoadTopoData() as the run asks for
+       them, up to -maxpages if that is given. A deque, so that the pages
+       stay where they are as more are added. */
+    std::deque<Dem> dem;
     int min_north;
     int max_north;
     int min_west;
@@ -56,7 +139,9 @@ class ElevationMap {
 
     double haat(Path &path, const Site &antenna) const;
 
-    double GetElevation(const Site &location) const;
+    double GetElevation(const Site &location, int level = 0) const;
+
+    int FarFieldLevel(double distance) const;
 
     int AddElevation(double lat, double lon, double height);
 
@@ -73,11 +158,15 @@ class ElevationMap {
 
     void PlotPath(const Site &source, const Site &destination, char mask_value);
 
+    void PlotPathSweep(const Site &source, const Site &destination,
+                       char mask_value);
+
     void PlotLOSMap(const Site &source, double altitude);
 
-    void PlotLRMap(const Site &source, double altitude,
-                   const std::string &plo_filename, const AntennaPattern &pat,
-                   const Lrp &lrp);
+    void PlotLRMaps(const std::vector<Site> &sources, double altitude,
+                    const std::string &plo_filename,
+                    const std::vector<const AntennaPattern *> &pats,
+                    const std::vector<Lrp> &lrps);
 
     int PutSignal(double lat, double lon, unsigned char signal);
 
@@ -85,14 +174,82 @@ class ElevationMap {
 
     const Dem *FindDEM(double lat, double lon, int &x, int &y) const;
 
+    short Height(const Dem *dem, int x, int y) const;
+
+    unsigned char Mask(const Dem *dem, int x, int y) const;
+
+    unsigned char Signal(const Dem *dem, int x, int y) const;
+
+    void IndexPages();
+
+    void ReadAllPages();
+
     ~ElevationMap();
 
   private:
-    void PlotLRPath(const Site &source, const Site &destination,
-                    unsigned char mask_value, FILE *fd, const AntennaPattern &pat,
-                    const Lrp &lrp);
+    template <class Model, typename T>
+    void PlotLRPath(const LRMap &map, const Site &destination, int number);
+
+    void PlotLRJob(std::vector<LRMap> &maps, size_t first, size_t last,
+                   double altitude, MapProgress &progress);
 
     bool FindMask(double lat, double lon, int &x, int &y, int &indx) const;
+
+    int PageKey(int north, int west) const;
+
+    void AddPage(int minlat, int maxlat, int minlon, int maxlon);
+
+    void LoadPage(int indx);
+
+    void EvictPages(unsigned long long needed, unsigned now);
+
+    ClaimLayer *NewClaims();
+
+    void FreeClaims(ClaimLayer *&claims);
+
+    unsigned char *Layer(std::atomic<unsigned char *> &layer);
+
+    bool Constant(const Dem &page) const;
+
+    void BuildLevels(Dem &page);
+
+    short LevelMax(const Dem &page, int level, int x, int y) const;
+
+    short &LevelPoint(const Dem &page, int level, int x, int y) const;
+
+    size_t LevelBytes() const;
+
+    void ShareTerrain(Dem &page);
+
+    void UnshareTerrain(Dem &page);
+
+    bool Obstructs(const Path &path, int x, int y, double rx_alt,
+                   double cos_xmtr_angle) const;
+
+    Radial &RadialScratch() const;
+
+    int MapRanges(std::vector<WorkRange> &ranges, int workers, int maps,
+                  int start[4]) const;
+
+    int EdgeRadials(int edge) const;
+
+    Site EdgeSite(int edge, int y, double altitude) const;
+
+    bool Seen(double lat, double lon, unsigned char mask_value) const;
+
+    void See(double lat, double lon, unsigned char mask_value);
+
+    bool Plotted(const LRMap &map, double lat, double lon, int radial) const;
+
+    void PlotSignal(const LRMap &map, double lat, double lon, int radial,
+                    int level);
+
+    bool Claimant(const LRMap &map, double lat, double lon, int radial) const;
+
+    void DrawClaims(unsigned char mask_value);
+
+    void DrawSignals(const std::vector<LRMap> &maps, size_t first,
+                     size_t last);
 };
 
 #endif /* elevation_map_h */
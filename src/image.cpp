@@ -19,6 +19,8 @@
 #include "sdf.h"
 #include "site.h"
 #include "utilities.h"
+#include "work_pool.h"
+#include <algorithm>
 #include <cmath>
 #include <cstdio>
 #include <fstream>
@@ -28,6 +30,9 @@
 
 using namespace std;
 
+/* Rows of a coverage map worked out at a time */
+#define BAND_ROWS 256
+
 #ifndef _WIN32
 #define RGB(signal, r, g, b) (((uint32_t)(uint8_t)signal) | ((uint32_t)((uint8_t)r) << 8) | ((uint32_t)((uint8_t)g) << 16) | ((uint32_t)((uint8_t)b) << 24))
 #endif
@@ -71,16 +76,16 @@ Pixel Image::GetPixel(const Dem *dem, MapType maptype, Region &region, int x0, i
         return COLOR_BLACK(255);
     }
 
-    unsigned char mask = dem->mask[x0 * sr.ippd + y0];
+    unsigned char mask = em.Mask(dem, x0, y0);
 
-    /* Note: The array dem->signal holds a scaled value depending
+    /* Note: The signal layer holds a scaled value depending
      * on the type that is unscaled again in the following.
      * See function PlotLRPath() in elevation_map.cpp
      */
     int pathloss=255;
     int signal=255;
 
-    pathloss = (dem->signal[x0 * sr.ippd + y0]);
+    pathloss = em.Signal(dem, x0, y0);
 
     if(maptype == MAPTYPE_DBM) {
         // signal contains the power level in dBm
@@ -190,10 +195,10 @@ Pixel Image::GetPixel(const Dem *dem, MapType maptype, Region &region, int x0, i
                           pixel = COLOR_WHITE(pathloss);
                       } else {
                           /* Display land or sea elevation */
-                          if (dem->data[x0 * sr.ippd + y0] == 0) {
+                          if (em.Height(dem, x0, y0) == 0) {
                               pixel = COLOR_MEDIUMBLUE(pathloss);
                           } else {
-                              terrain = (unsigned)(0.5 + pow((double)(dem->data[x0 * sr.ippd + y0] - em.min_elevation), one_over_gamma) * conversion);
+                              terrain = (unsigned)(0.5 + pow((double)(em.Height(dem, x0, y0) - em.min_elevation), one_over_gamma) * conversion);
                               pixel = RGB(pathloss, terrain, terrain, terrain);
                           }
                       }
@@ -202,11 +207,11 @@ Pixel Image::GetPixel(const Dem *dem, MapType maptype, Region &region, int x0, i
                       if (red != 0 || green != 0 || blue != 0) {
                           pixel = RGB(pathloss, red, green, blue);
                       } else { /* terrain / sea-level */
-                          if (dem->data[x0 * sr.ippd + y0] == 0) {
+                          if (em.Height(dem, x0, y0) == 0) {
                               pixel = COLOR_MEDIUMBLUE(pathloss);
                           } else {
                               /* Elevation: Greyscale */
-                              terrain = (unsigned)(0.5 + pow((double)(dem->data[x0 * sr.ippd + y0] - em.min_elevation), one_over_gamma) * conversion);
+                              terrain = (unsigned)(0.5 + pow((double)(em.Height(dem, x0, y0) - em.min_elevation), one_over_gamma) * conversion);
                               pixel = RGB(pathloss, terrain, terrain, terrain);
                           }
                       }
@@ -294,11 +299,11 @@ Pixel Image::GetPixel(const Dem *dem, MapType maptype, Region &region, int x0, i
                              pixel = COLOR_MEDIUMBLUE(pathloss);
                          else {
                              /* Sea-level: Medium Blue */
-                             if (dem->data[x0 * sr.ippd + y0] == 0)
+                             if (em.Height(dem, x0, y0) == 0)
                                  pixel = COLOR_MEDIUMBLUE(pathloss);
                              else {
                                  /* Elevation: Greyscale */
-                                 terrain = (unsigned)(0.5 + pow((double)(dem->data[x0 * sr.ippd + y0] - em.min_elevation), one_over_gamma) * conversion);
+                                 terrain = (unsigned)(0.5 + pow((double)(em.Height(dem, x0, y0) - em.min_elevation), one_over_gamma) * conversion);
                                  pixel = RGB(pathloss, terrain, terrain, terrain);
                              }
                          }
@@ -311,10 +316,10 @@ Pixel Image::GetPixel(const Dem *dem, MapType maptype, Region &region, int x0, i
                         pixel = COLOR_WHITE(pathloss);
                     } else {
                         /* Display land or sea elevation */
-                        if (dem->data[x0 * sr.ippd + y0] == 0) {
+                        if (em.Height(dem, x0, y0) == 0) {
                             pixel = COLOR_MEDIUMBLUE(pathloss);
                         } else {
-                            terrain = (unsigned)(0.5 + pow((double)(dem->data[x0 * sr.ippd + y0] - em.min_elevation), one_over_gamma) * conversion);
+                            terrain = (unsigned)(0.5 + pow((double)(em.Height(dem, x0, y0) - em.min_elevation), one_over_gamma) * conversion);
                             pixel = RGB(pathloss, terrain, terrain, terrain);
                         }
                     }
@@ -328,11 +333,11 @@ Pixel Image::GetPixel(const Dem *dem, MapType maptype, Region &region, int x0, i
                         if (sr.ngs) {
                             pixel = COLOR_WHITE(pathloss);
                         } else {
-                            if (dem->data[x0 * sr.ippd + y0] == 0) {
+                            if (em.Height(dem, x0, y0) == 0) {
                                 pixel = COLOR_MEDIUMBLUE(pathloss);
                             } else {
                                 /* Elevation: Greyscale */
-                                terrain = (unsigned)(0.5 + pow((double)(dem->data[x0 * sr.ippd + y0] - em.min_elevation), one_over_gamma) * conversion);
+                                terrain = (unsigned)(0.5 + pow((double)(em.Height(dem, x0, y0) - em.min_elevation), one_over_gamma) * conversion);
                                 pixel = RGB(pathloss, terrain, terrain, terrain);
                             }
                         }
@@ -873,7 +878,7 @@ void Image::WriteCoverageMap(MapType maptype, ImageType imagetype, Region &regio
 #endif
     unsigned int width, height;
     unsigned int imgheight, imgwidth;
-    double lat, lon, north, south, east, west, minwest;
+    double north, south, east, west, minwest;
     FILE *fd;
 
     width = (unsigned)(sr.ippd * Utilities::ReduceAngle(em.max_west - em.min_west));
@@ -976,21 +981,42 @@ void Image::WriteCoverageMap(MapType maptype, ImageType imagetype, Region &regio
 
     try {
         ImageWriter iw = ImageWriter(mapfile, imagetype, imgwidth, imgheight, north, south, east, west);
-        int y;
-        for (y = 0, lat = north; y < (int)height; y++, lat = north - (sr.dpp * (double)y)) {
-            int x;
-            for (x = 0, lon = em.max_west; x < (int)width; x++, lon = em.max_west - (sr.dpp * (double)x)) {
-                if (lon < 0.0)
-                    lon += 360.0;
 
-                int x0 = 0, y0 = 0;
-                const Dem *dem = em.FindDEM(lat, lon, x0, y0);
-                Pixel pixel = GetPixel(dem, maptype, region, x0, y0);
+        /* The pixels of a band of rows are worked out on the workers, a few
+           rows each, then written out in order. */
+        vector<Pixel> band((size_t)BAND_ROWS * width);
+        vector<WorkRange> ranges;
+        int y, rows;
 
-                iw.AppendPixel(pixel);
-            }
+        for (y = 0; y < (int)height; y += rows) {
+            rows = min(BAND_ROWS, (int)height - y);
+            ranges.clear();
+            WorkPool::Split(0, rows, 8, ranges);
 
-            iw.EmitLine();
+            sr.pool->Run(ranges, [&](const WorkRange &range) {
+                for (int row = range.first; row < range.last; row++) {
+                    double lat = north - (sr.dpp * (double)(y + row)), lon;
+                    Pixel *pixels = &band[(size_t)row * width];
+
+                    for (int x = 0; x < (int)width; x++) {
+                        lon = em.max_west - (sr.dpp * (double)x);
+
+                        if (lon < 0.0)
+                            lon += 360.0;
+
+                        int x0 = 0, y0 = 0;
+                        const Dem *dem = em.FindDEM(lat, lon, x0, y0);
+                        pixels[x] = GetPixel(dem, maptype, region, x0, y0);
+                    }
+                }
+            });
+
+            for (int row = 0; row < rows; row++) {
+                for (int x = 0; x < (int)width; x++)
+                    iw.AppendPixel(band[(size_t)row * width + x]);
+
+                iw.EmitLine();
+            }
         }
 
         if (sr.bottom_legend) {
@@ -42,7 +42,6 @@
  *    (-Wunused-but-set-variable)  -- John A. Magliacane -- July 25, 2013 *
  ********************************************************************************/
 
-#include <assert.h>
 #include <complex>
 #include <math.h>
 #include <string.h>
@@ -1004,6 +1003,45 @@ double qerfi(double q) {
     return v;
 }
 
+/*
+ * The part of qlrps() that doesn't depend on the path: wave number and ground
+ * impedance.
+ */
+static void qlrps_ground(double fmhz, int ipol, double eps, double sgm,
+                         prop_type *prop) {
+    prop->wn = fmhz / 47.7;
+
+    /*complex<double> zq, prop_zgnd(prop->zgndreal,prop->zgndimag); */
+    /*zq=complex<double> (eps,376.62*sgm/prop->wn); */
+    /*prop_zgnd=sqrt(zq-1.0); */
+    tcomplex prop_zgnd = {prop->zgndreal, prop->zgndimag};
+    tcomplex zq = {eps, 376.62 * sgm / prop->wn};
+    prop_zgnd = tcsqrt(tcadd(-1.0, zq));
+
+    if (ipol != 0.0) {
+        /* prop_zgnd=prop_zgnd/zq; */
+        prop_zgnd = tcdiv(prop_zgnd, zq);
+    }
+
+    prop->zgndreal = tcreal(prop_zgnd);
+    prop->zgndimag = tcimag(prop_zgnd);
+}
+
+/*
+ * The part of qlrps() that does: surface refractivity and effective earth
+ * curvature for a path of average elevation zsys.
+ */
+static void qlrps_surface(double zsys, double en0, prop_type *prop) {
+    double gma = 157e-9;
+
+    prop->ens = en0;
+
+    if (zsys != 0.0)
+        prop->ens *= exp(-zsys / 9460.0);
+
+    prop->gme = gma * (1.0 - 0.04665 * exp(prop->ens / 179.3));
+}
+
 /*
  * Quick Longley-Rice Profile Setup
  *
@@ -1021,41 +1059,61 @@ double qerfi(double q) {
  * prop: filled in by various calculations on these values.
  *
  * Note that nothing here is particularly compute-intensive to calculate.
- * However the values usually stay the same over a study. A (minor) performance
- * enhancement would be to calculate them once and save them for all studies of
- * that tx point.
+ * However the values usually stay the same over a study, so ItmRadio
+ * calculates them once for all studies of that tx point.
  *
- * The exception is zsys, which depends on the path.
+ * The exception is zsys, which depends on the path. ItmRadio::Setup() redoes
+ * only that part.
  *
  *
  * See ITWOM-SUB-ROUTINES.pdf, p262
  */
 void qlrps(double fmhz, double zsys, double en0, int ipol, double eps,
            double sgm, prop_type *prop) {
-    double gma = 157e-9;
-
-    prop->wn = fmhz / 47.7;
-    prop->ens = en0;
-
-    if (zsys != 0.0)
-        prop->ens *= exp(-zsys / 9460.0);
+    qlrps_ground(fmhz, ipol, eps, sgm, prop);
+    qlrps_surface(zsys, en0, prop);
+}
 
-    prop->gme = gma * (1.0 - 0.04665 * exp(prop->ens / 179.3));
+/*
+ * The radio setup of one transmitter. See itwom3.0.h.
+ */
+ItmRadio::ItmRadio()
+    : eps_dielect(0.0), sgm_conductivity(0.0), eno_ns_surfref(0.0),
+      frq_mhz(0.0), radio_climate(0), pol(0), conf(-1.0), rel(-1.0),
+      wn(0.0), zgndreal(0.0), zgndimag(0.0), zc(0.0), zr(0.0) {}
+
+ItmRadio::ItmRadio(double eps_dielect, double sgm_conductivity,
+                   double eno_ns_surfref, double frq_mhz, int radio_climate,
+                   int pol, double conf, double rel)
+    : eps_dielect(eps_dielect), sgm_conductivity(sgm_conductivity),
+      eno_ns_surfref(eno_ns_surfref), frq_mhz(frq_mhz),
+      radio_climate(radio_climate), pol(pol), conf(conf), rel(rel) {
+    prop_type prop = {0};
 
-    /*complex<double> zq, prop_zgnd(prop->zgndreal,prop->zgndimag); */
-    /*zq=complex<double> (eps,376.62*sgm/prop->wn); */
-    /*prop_zgnd=sqrt(zq-1.0); */
-    tcomplex prop_zgnd = {prop->zgndreal, prop->zgndimag};
-    tcomplex zq = {eps, 376.62 * sgm / prop->wn};
-    prop_zgnd = tcsqrt(tcadd(-1.0, zq));
+    qlrps_ground(frq_mhz, pol, eps_dielect, sgm_conductivity, &prop);
+    wn = prop.wn;
+    zgndreal = prop.zgndreal;
+    zgndimag = prop.zgndimag;
+    zc = qerfi(conf);
+    zr = qerfi(rel);
+}
 
-    if (ipol != 0.0) {
-        /* prop_zgnd=prop_zgnd/zq; */
-        prop_zgnd = tcdiv(prop_zgnd, zq);
-    }
+bool ItmRadio::Matches(double eps_dielect, double sgm_conductivity,
+                       double eno_ns_surfref, double frq_mhz,
+                       int radio_climate, int pol, double conf,
+                       double rel) const {
+    return eps_dielect == this->eps_dielect &&
+           sgm_conductivity == this->sgm_conductivity &&
+           eno_ns_surfref == this->eno_ns_surfref &&
+           frq_mhz == this->frq_mhz && radio_climate == this->radio_climate &&
+           pol == this->pol && conf == this->conf && rel == this->rel;
+}
 
-    prop->zgndreal = tcreal(prop_zgnd);
-    prop->zgndimag = tcimag(prop_zgnd);
+void ItmRadio::Setup(double zsys, prop_type *prop) const {
+    prop->wn = wn;
+    prop->zgndreal = zgndreal;
+    prop->zgndimag = zgndimag;
+    qlrps_surface(zsys, eno_ns_surfref, prop);
 }
 
 typedef struct alos_state {
@@ -1968,7 +2026,8 @@ double avar(double zzt, double zzl, double zzc, prop_type *prop,
  *
  * See ITWOM-SUB-ROUTINES.pdf, page 150
  */
-void hzns(const elev_t pfl[], prop_type *prop) {
+template <typename T>
+void hzns(const T pfl[], prop_type *prop) {
     bool wq;
     int np;
     double xi, za, zb, qc, q, sb, sa;
@@ -2034,6 +2093,61 @@ void hzns(const elev_t pfl[], prop_type *prop) {
     }
 }
 
+/*
+ * 2-ray reflection point, used by hzns2() and the radial engine once the
+ * horizons are known.
+ *
+ * Fills out prop->rpl and prop->rph from prop->dl[], prop->hht, prop->hhr and
+ * the values cached in prop by hzns2 (tiw, ght, ghr).
+ */
+template <typename T>
+static void hzns2_reflection(const T pfl[], prop_type *prop) {
+    int rp;
+    double xi, za, zb, dr, dshh;
+
+    xi = prop->tiw;
+    za = prop->ght;
+    zb = prop->ghr;
+
+    /* if the receiver horizon path is shorter than the total path, then there's
+     * some obstacle, so let's calculate the 2-ray reflection point.
+     *
+     * dr is the distance in meters from the last obstruction peak to the
+     * reflection point.
+     */
+    dr = 0.0;
+    if ((prop->dl[1]) < (prop->dist)) {
+        dshh = prop->dist - prop->dl[0] -
+               prop->dl[1]; /* distance between obstacle peaks */
+
+        /* see ITWOM p63 and p162 */
+        if (trunc(dshh) == 0) /* one obstacle */
+        {
+            if (prop->hht > 0.0) {
+                dr = prop->dl[1] / (1 + zb / prop->hht);
+            }
+        } else /* two obstacles */
+        {
+            if (prop->hhr > 0.0) { /* if the antenna has 0 height, there is no
+                                      2-ray reflection */
+                dr = prop->dl[1] / (1 + zb / prop->hhr);
+            }
+        }
+    } else /* line of sight  */
+    {
+        if (za > 0.0) {
+            dr =
+                (prop->dist) / (1 + zb / za); /* if the antenna has 0 height,
+                                                 there is no 2-ray reflection */
+        }
+    }
+
+    rp = 2 + (int)(floor(0.5 + dr / xi));
+
+    prop->rpl = rp;
+    prop->rph = pfl[rp];
+}
+
 /*
  * Horizon calculations.
  *
@@ -2050,10 +2164,11 @@ void hzns(const elev_t pfl[], prop_type *prop) {
  *
  * See ITWOM-SUB-ROUTINES.pdf, page 150
  */
-void hzns2(const elev_t pfl[], prop_type *prop) {
+template <typename T>
+void hzns2(const T pfl[], prop_type *prop) {
     bool wq;
-    int np, rp, i, j;
-    double xi, za, zb, qc, q, sb, sa, dr, dshh;
+    int np, i, j;
+    double xi, za, zb, qc, q, sb, sa;
 
     np = (int)pfl[0]; /* number of elements in pfl array                      */
     xi = pfl[1];      /* x increment, the distance between elements           */
@@ -2143,43 +2258,7 @@ void hzns2(const elev_t pfl[], prop_type *prop) {
         }
     }
 
-    /* if the receiver horizon path is shorter than the total path, then there's
-     * some obstacle, so let's calculate the 2-ray reflection point.
-     *
-     * dr is the distance in meters from the last obstruction peak to the
-     * reflection point.
-     */
-    dr = 0.0;
-    if ((prop->dl[1]) < (prop->dist)) {
-        dshh = prop->dist - prop->dl[0] -
-               prop->dl[1]; /* distance between obstacle peaks */
-
-        /* see ITWOM p63 and p162 */
-        if (trunc(dshh) == 0) /* one obstacle */
-        {
-            if (prop->hht > 0.0) {
-                dr = prop->dl[1] / (1 + zb / prop->hht);
-            }
-        } else /* two obstacles */
-        {
-            if (prop->hhr > 0.0) { /* if the antenna has 0 height, there is no
-                                      2-ray reflection */
-                dr = prop->dl[1] / (1 + zb / prop->hhr);
-            }
-        }
-    } else /* line of sight  */
-    {
-        if (za > 0.0) {
-            dr =
-                (prop->dist) / (1 + zb / za); /* if the antenna has 0 height,
-                                                 there is no 2-ray reflection */
-        }
-    }
-
-    rp = 2 + (int)(floor(0.5 + dr / xi));
-
-    prop->rpl = rp;
-    prop->rph = pfl[rp];
+    hzns2_reflection(pfl, prop);
 }
 
 /* Linear least-squares fit
@@ -2209,7 +2288,8 @@ void hzns2(const elev_t pfl[], prop_type *prop) {
  *
  * Used only with ITM 1.2.2
  */
-void z1sq1(const elev_t z[], const double x1, const double x2, double *z0,
+template <typename T>
+void z1sq1(const T z[], const double x1, const double x2, double *z0,
            double *zn) {
     double xn, xa, xb, x, a, b;
     int n, ja, jb;
@@ -2286,7 +2366,8 @@ void z1sq1(const elev_t z[], const double x1, const double x2, double *z0,
  *
  *  See ITWOM-SUB-ROUTINES.pdf p298
  */
-void z1sq2(const elev_t z[], const double x1, const double x2, double *z0,
+template <typename T>
+void z1sq2(const T z[], const double x1, const double x2, double *z0,
            double *zn) {
     /* corrected for use with ITWOM */
     double xn, xa, xb, x, a, b, bn;
@@ -2345,6 +2426,118 @@ void z1sq2(const elev_t z[], const double x1, const double x2, double *z0,
     *zn = a + (b * (xn - xb)); /* set height of zn */
 }
 
+/*
+ * Running sums over a profile, used to answer the least-squares fits in
+ * z1sq1() and z1sq2() in constant time when the same profile is fitted many
+ * times over (see ItmRadial).
+ *
+ *  sz[i]: sum of z[k+2] for k < i
+ * sxz[i]: sum of k*z[k+2] for k < i
+ */
+typedef struct z1sq_sums {
+    const double *sz;
+    const double *sxz;
+} z1sq_sums;
+
+/* z1sq1() using the running sums in ps. Falls back to z1sq1() if ps is NULL.
+ */
+template <typename T>
+static void z1sq1_prefix(const T z[], const z1sq_sums *ps,
+                         const double x1, const double x2, double *z0,
+                         double *zn) {
+    double xn, xa, xb, x, a, b, sy;
+    int ja, jb;
+
+    if (ps == NULL) {
+        z1sq1(z, x1, x2, z0, zn);
+        return;
+    }
+
+    xn = z[0];
+    xa = trunc(FORTRAN_DIM(x1 / z[1], 0.0));
+    xb = xn - trunc(FORTRAN_DIM(xn, x2 / z[1]));
+
+    if (xb <= xa) {
+        xa = FORTRAN_DIM(xa, 1.0);
+        xb = xn - FORTRAN_DIM(xn, xb + 1.0);
+    }
+
+    ja = (int)xa;
+    jb = (int)xb;
+
+    xa = xb - xa;
+    x = -0.5 * xa;
+    xb += x;
+
+    a = 0.5 * (z[ja + 2] + z[jb + 2]);
+    b = 0.5 * (z[ja + 2] - z[jb + 2]) * x;
+
+    /* the points strictly between ja and jb, each weighted by its offset
+     * (k-ja+x) from the midpoint */
+    if (jb - ja > 1) {
+        sy = ps->sz[jb] - ps->sz[ja + 1];
+        a += sy;
+        b += (ps->sxz[jb] - ps->sxz[ja + 1]) + (x - ja) * sy;
+    }
+
+    a /= xa;
+    b = b * 12.0 / ((xa * xa + 2.0) * xa); /* same (sic) slope as z1sq1() */
+
+    *z0 = a - b * xb;
+    *zn = a + b * (xn - xb);
+}
+
+/* z1sq2() using the running sums in ps. Falls back to z1sq2() if ps is NULL.
+ */
+template <typename T>
+static void z1sq2_prefix(const T z[], const z1sq_sums *ps,
+                         const double x1, const double x2, double *z0,
+                         double *zn) {
+    double xn, xa, xb, x, a, b, bn, sy, m;
+    int ja, jb;
+
+    if (ps == NULL) {
+        z1sq2(z, x1, x2, z0, zn);
+        return;
+    }
+
+    xn = z[0];
+    xa = trunc(FORTRAN_DIM(x1 / z[1], 0.0));
+    xb = xn - trunc(FORTRAN_DIM(xn, x2 / z[1]));
+
+    if (xb <= xa) {
+        xa = FORTRAN_DIM(xa, 1.0);
+        xb = xn - FORTRAN_DIM(xn, xb + 1.0);
+    }
+
+    jb = (int)xb;
+
+    xa = (2 * trunc((xb - xa) / 2)) - 1;
+    x = -0.5 * (xa + 1);
+    xb += x;
+    ja = jb - 1 - (int)xa;
+
+    a = (z[ja + 2] + z[jb + 2]);
+    b = (z[ja + 2] - z[jb + 2]) * x;
+    bn = 2 * (x * x);
+
+    if (jb - ja > 1) {
+        m = jb - ja - 1; /* number of points strictly between ja and jb */
+        sy = ps->sz[jb] - ps->sz[ja + 1];
+        a += sy;
+        b += (ps->sxz[jb] - ps->sxz[ja + 1]) + (x - ja) * sy;
+
+        /* sum((x+i)^2) for i=1..m */
+        bn += m * x * x + x * m * (m + 1) + m * (m + 1) * (2 * m + 1) / 6.0;
+    }
+
+    a /= (xa + 2);
+    b = b / bn;
+
+    *z0 = a - (b * xb);
+    *zn = a + (b * (xn - xb));
+}
+
 /* Used to find a quantile.  It reorders the array a so that all the elements
  * before ir are greater than or equal to all the elements after ir. In
  * particular, a(ir) will have the same value it would have if a were completely
@@ -2368,7 +2561,8 @@ void z1sq2(const elev_t z[], const double x1, const double x2, double *z0,
  * Also see ITWOM-SUB-ROUTINES.pdf p265
  *
  */
-double qtile(const int nn, elev_t a[], const int ir) {
+template <typename T>
+double qtile(const int nn, T a[], const int ir) {
     double q = 0.0, r;                 /* q initialization -- KD2BD */
     int m, n, i, j, j1 = 0, i0 = 0, k; /* more initializations -- KD2BD */
     bool done = false;
@@ -2431,6 +2625,45 @@ double qtile(const int nn, elev_t a[], const int ir) {
     return q;
 }
 
+/* The value a[k] would have if a[lo..hi] were sorted in descending order.
+ * Like qtile(), it partitions around the current a[k], but three ways, so
+ * that runs of equal heights are settled in one pass. Used by
+ * ItmContext::Qtiles() on the few heights left in a histogram bin. */
+template <typename T>
+static double qtile_select(T a[], int lo, int hi, const int k) {
+    T p, t;
+    int i, lt, gt;
+
+    while (lo < hi) {
+        p = a[k];
+        i = lo;
+        lt = lo;
+        gt = hi;
+
+        while (i <= gt) {
+            if (a[i] > p) {
+                t = a[i];
+                a[i++] = a[lt];
+                a[lt++] = t;
+            } else if (a[i] < p) {
+                t = a[i];
+                a[i] = a[gt];
+                a[gt--] = t;
+            } else
+                i++;
+        }
+
+        if (k < lt)
+            hi = lt - 1;
+        else if (k > gt)
+            lo = gt + 1;
+        else
+            break;
+    }
+
+    return a[k];
+}
+
 /*
  * qerf()
  *
@@ -2463,6 +2696,148 @@ double qerf(const double z) {
     return qerfv;
 }
 
+/*
+ * ItmContext
+ *
+ * Scratch memory and cached constants for one thread's calls into the model.
+ * See itwom3.0.h.
+ */
+ItmContext::ItmContext() {}
+
+template <> ItmScratch<float> &ItmContext::Scratch<float>() {
+    return scratch_f;
+}
+
+template <> ItmScratch<double> &ItmContext::Scratch<double>() {
+    return scratch_d;
+}
+
+const ItmRadio &ItmContext::Radio(double eps_dielect, double sgm_conductivity,
+                                  double eno_ns_surfref, double frq_mhz,
+                                  int radio_climate, int pol, double conf,
+                                  double rel) {
+    if (!radio.Matches(eps_dielect, sgm_conductivity, eno_ns_surfref, frq_mhz,
+                       radio_climate, pol, conf, rel))
+        radio = ItmRadio(eps_dielect, sgm_conductivity, eno_ns_surfref,
+                         frq_mhz, radio_climate, pol, conf, rel);
+
+    return radio;
+}
+
+/* Upper bound on the number of histogram bins used by Qtiles() */
+#define QTILE_BINS 4096
+
+/*
+ * Finds two quantiles of the same array at once, returning in q1 and q2 what
+ * qtile(nn, a, ir1) and qtile(nn, a, ir2) would. Unlike qtile(), a[] is left
+ * as it is.
+ *
+ * Rather than partitioning the array twice, the heights are counted into up
+ * to QTILE_BINS equal-width bins between the lowest and highest, walking down
+ * from the highest bin finds the two bins holding the wanted ranks, and only
+ * the heights in those bins are gathered and selected from. That is three
+ * linear passes with no data-dependent swapping. The result is an order
+ * statistic of a[], so it is exactly the value qtile() returns.
+ */
+template <typename T>
+void ItmContext::Qtiles(const int nn, const T a[], const int ir1,
+                        const int ir2, double &q1, double &q2) {
+    int n, nb, b, b1, b2, c, c1, c2, i, k1, k2, p1, p2;
+    T lo, hi;
+    double scale;
+
+    n = nn + 1;
+    k1 = min(max(0, ir1), nn - 1); /* same clamping as qtile() */
+    k2 = min(max(0, ir2), nn - 1);
+
+    lo = a[0];
+    hi = a[0];
+
+    for (i = 1; i < n; i++) {
+        if (a[i] < lo)
+            lo = a[i];
+
+        if (a[i] > hi)
+            hi = a[i];
+    }
+
+    if (hi == lo) {
+        q1 = lo;
+        q2 = lo;
+        return;
+    }
+
+    /* Bin 0 holds the highest heights. The bin of every height is kept so
+       that gathering doesn't depend on the arithmetic rounding the same way
+       twice. */
+    nb = min(n, QTILE_BINS);
+    scale = (nb - 1) / ((double)hi - lo);
+    bins.assign(nb, 0);
+    bin_of.resize(n);
+
+    for (i = 0; i < n; i++) {
+        b = min((int)((hi - a[i]) * scale), nb - 1);
+        bin_of[i] = b;
+        bins[b]++;
+    }
+
+    /* c1 and c2 are the number of heights above bins b1 and b2 */
+    b1 = -1;
+    b2 = -1;
+    c1 = 0;
+    c2 = 0;
+
+    for (b = 0, c = 0; b1 < 0 || b2 < 0; b++) {
+        if (b1 < 0 && c + bins[b] > k1) {
+            b1 = b;
+            c1 = c;
+        }
+
+        if (b2 < 0 && c + bins[b] > k2) {
+            b2 = b;
+            c2 = c;
+        }
+
+        c += bins[b];
+    }
+
+    /* the heights of bin b1, followed by those of bin b2 */
+    std::vector<T> &picked = Scratch<T>().picked;
+    picked.resize(n);
+    p1 = 0;
+    p2 = bins[b1];
+
+    for (i = 0; i < n; i++) {
+        if (bin_of[i] == b1)
+            picked[p1++] = a[i];
+        else if (bin_of[i] == b2)
+            picked[p2++] = a[i];
+    }
+
+    q1 = qtile_select(&picked[0], 0, bins[b1] - 1, k1 - c1);
+
+    if (b2 == b1)
+        q2 = qtile_select(&picked[0], 0, bins[b1] - 1, k2 - c1);
+    else
+        q2 = qtile_select(&picked[bins[b1]], 0, bins[b2] - 1, k2 - c2);
+}
+
+template void ItmContext::Qtiles<float>(const int nn, const float a[],
+                                        const int ir1, const int ir2,
+                                        double &q1, double &q2);
+template void ItmContext::Qtiles<double>(const int nn, const double a[],
+                                         const int ir1, const int ir2,
+                                         double &q1, double &q2);
+
+/*
+ * The context used by the free functions, one per calling thread.
+ */
+static ItmContext &default_context() {
+    static thread_local ItmContext ctx;
+
+    return ctx;
+}
+
 /*
  * Delta h, experimental
  *
@@ -2482,10 +2857,16 @@ double qerf(const double z) {
  * with ITM 1.2.2 and is limited to using a maximum of 245 pfl array elements.
  * It is thus faster but slightly less accurate.
  */
-double d1thx(const elev_t pfl[], const double x1, const double x2) {
+template <typename T>
+double d1thx(const T pfl[], const double x1, const double x2) {
+    return default_context().D1thx(pfl, x1, x2);
+}
+
+template <typename T>
+double ItmContext::D1thx(const T pfl[], double x1, double x2) {
     int np, ka, kb, n, k, j;
-    double d1thxv, sn, xa, xb;
-    elev_t *s;
+    double d1thxv, sn, xa, xb, q90, q10;
+    T *s;
 
     np = (int)pfl[0];
     xa = x1 / pfl[1]; /* start point's array element */
@@ -2501,8 +2882,8 @@ double d1thx(const elev_t pfl[], const double x1, const double x2) {
     kb = n - ka + 1;                   /* kb can range from 32-221 */
     sn = n - 1; /* index of last path element to consider */
 
-    s = (elev_t *)calloc(n + 2, sizeof(elev_t));
-    assert(s != NULL);
+    Scratch<T>().profile.resize(n + 2);
+    s = &Scratch<T>().profile[0];
     s[0] = sn;
     s[1] = 1.0;
 
@@ -2534,17 +2915,14 @@ double d1thx(const elev_t pfl[], const double x1, const double x2) {
         xa = xa + xb;
     }
 
-    /* Now find the difference between the 90% and 10% heights.
-     * These two qtiles calls take a (relatively) enormous amount of
-     * processing time. See notes in d1thx2() below. Here they are limited to
-     * a max of 245 elements so it's not so bad. */
-    d1thxv = qtile(n - 1, s + 2, ka - 1) - qtile(n - 1, s + 2, kb - 1);
+    /* Now find the difference between the 90% and 10% heights. Both are
+     * found in the same pass; see Qtiles(). */
+    Qtiles(n - 1, s + 2, ka - 1, kb - 1, q90, q10);
+    d1thxv = q90 - q10;
 
     /* apply empirical data matching magic scaling. See ITWOM p124. */
     d1thxv /= 1.0 - 0.8 * exp(-(x2 - x1) / 50.0e3);
 
-    free(s);
-
     return d1thxv;
 }
 
@@ -2566,10 +2944,16 @@ double d1thx(const elev_t pfl[], const double x1, const double x2) {
  * See ITWOM-SUB-ROUTINES.pdf p125. This version has been modified by Sid
  * Shumate to use the entire range of the pfl array if needed.
  */
-double d1thx2(const elev_t pfl[], const double x1, const double x2) {
+template <typename T>
+double d1thx2(const T pfl[], const double x1, const double x2) {
+    return default_context().D1thx2(pfl, x1, x2);
+}
+
+template <typename T>
+double ItmContext::D1thx2(const T pfl[], double x1, double x2) {
     int np, ka, kb, n, k, kmx, j;
-    double d1thx2v, sn, xa, xb, xc;
-    elev_t *s;
+    double d1thx2v, sn, xa, xb, xc, q90, q10;
+    T *s;
 
     np = (int)pfl[0];
     xa = x1 / pfl[1]; /* start point's array element */
@@ -2588,8 +2972,8 @@ double d1thx2(const elev_t pfl[], const double x1, const double x2) {
     kb = n - ka + 1;
     sn = n - 1;
 
-    s = (elev_t *)calloc(n + 2, sizeof(elev_t));
-    assert(s != NULL);
+    Scratch<T>().profile.resize(n + 2);
+    s = &Scratch<T>().profile[0];
     s[0] = sn;
     s[1] = 1.0;
 
@@ -2626,63 +3010,40 @@ double d1thx2(const elev_t pfl[], const double x1, const double x2) {
         xa = xa + xb;
     }
 
-    /* Now find the difference between the 90% and 10% heights.
-     * These two qtiles calls take a (relatively) enormous amount of
-     * processing time. */
-    d1thx2v = qtile(n - 1, s + 2, ka - 1) - qtile(n - 1, s + 2, kb - 1);
+    /* Now find the difference between the 90% and 10% heights. Two qtile()
+     * calls used to take a (relatively) enormous amount of processing time
+     * here; both are now found in the same pass. See Qtiles(). */
+    Qtiles(n - 1, s + 2, ka - 1, kb - 1, q90, q10);
+    d1thx2v = q90 - q10;
 
     /* apply empirical data matching magic scaling. See ITWOM p124. */
     d1thx2v /= 1.0 - 0.8 * exp(-(x2 - x1) / 50.0e3);
 
-    free(s);
-
     return d1thx2v;
 }
 
 /*
- * qlrpfl()
- *
- * Quick Longley-Rice Profile
- *
- * pfl[]: profile elevation array, with:
- *          pfl[0]: number of points in pfl
- *          pfl[1]: distance between points in pfl (in meters)
- * klimx: climate code
- * mdvarx: mode of variability. Usually 12, can be set to 1 for FCC mode.
- * prop:  prop_type state variable
- * propa: propa_type state variable
- * propv: propv_type state variable
- *
- *
+ * The part of qlrpfl() that follows the horizon and delta h calculations:
+ * effective heights, horizon distances and the call into lrprop().
  *
- * See ITWOM-SUB-ROUTINES.pdf p233
+ * xl[]: start and end of the terrain considered for the fits, in meters
+ *   ps: running sums over pfl for z1sq1_prefix(), or NULL
  */
-void qlrpfl(const elev_t pfl[], int klimx, int mdvarx, prop_type *prop,
-            propa_type *propa, propv_type *propv) {
+template <typename T>
+static void qlrpfl_profile(const T pfl[], const double xl[2],
+                           const z1sq_sums *ps, int klimx, int mdvarx,
+                           prop_type *prop, propa_type *propa,
+                           propv_type *propv) {
     int np, j;
-    double xl[2], q, za, zb, temp;
+    double q, za, zb, temp;
 
-    prop->dist = pfl[0] * pfl[1]; /* total distance of the pfl array */
-    np = (int)pfl[0];             /* number of points in the pfl array */
+    np = (int)pfl[0]; /* number of points in the pfl array */
 
-    hzns(pfl,
-         prop); /* analyse pfl and store horizon/obstruction info in prop */
+    if (prop->dl[0] + prop->dl[1] > 1.5 * prop->dist) {
+        /* the horizon (or obstruction) is far away... */
 
-    for (j = 0; j < 2; j++) /* for both tx and rx... */
-        xl[j] = min(15.0 * prop->hg[j],
-                    0.1 * prop->dl[j]); /* ...set xl to min of 15x ant height or
-                                           1/10 horizon dist */
-
-    xl[1] =
-        prop->dist - xl[1]; /* adjust the rx distance to be from the far end */
-
-    prop->dh = d1thx(pfl, xl[0],
-                     xl[1]); /* calculate the terrain irregularity factor */
-
-    if (prop->dl[0] + prop->dl[1] > 1.5 * prop->dist) {
-        /* the horizon (or obstruction) is far away... */
-
-        z1sq1(pfl, xl[0], xl[1], &za, &zb); /* do a linear least-squares fit */
+        z1sq1_prefix(pfl, ps, xl[0], xl[1], &za,
+                     &zb); /* do a linear least-squares fit */
         /* za has height of line at xl[0] */
         /* zb has height of line at xl[1] */
 
@@ -2726,8 +3087,9 @@ void qlrpfl(const elev_t pfl[], int klimx, int mdvarx, prop_type *prop,
     } else {
         /* the horizon (or obstruction) is nearish... */
 
-        z1sq1(pfl, xl[0], 0.9 * prop->dl[0], &za, &q);
-        z1sq1(pfl, prop->dist - 0.9 * prop->dl[1], xl[1], &q, &zb);
+        z1sq1_prefix(pfl, ps, xl[0], 0.9 * prop->dl[0], &za, &q);
+        z1sq1_prefix(pfl, ps, prop->dist - 0.9 * prop->dl[1], xl[1], &q,
+                     &zb);
 
         prop->he[0] = prop->hg[0] + FORTRAN_DIM(pfl[2], za);
         prop->he[1] = prop->hg[1] + FORTRAN_DIM(pfl[np + 2], zb);
@@ -2747,7 +3109,7 @@ void qlrpfl(const elev_t pfl[], int klimx, int mdvarx, prop_type *prop,
 }
 
 /*
- * qlrpfl2()
+ * qlrpfl()
  *
  * Quick Longley-Rice Profile
  *
@@ -2759,24 +3121,22 @@ void qlrpfl(const elev_t pfl[], int klimx, int mdvarx, prop_type *prop,
  * prop:  prop_type state variable
  * propa: propa_type state variable
  * propv: propv_type state variable
+ *   ctx: scratch memory for d1thx()
  *
- * See ITWOM-SUB-ROUTINES.pdf p247
+ *
+ *
+ * See ITWOM-SUB-ROUTINES.pdf p233
  */
-void qlrpfl2(const elev_t pfl[], int klimx, int mdvarx, prop_type *prop,
-             propa_type *propa, propv_type *propv) {
-    int np, j;
-    double xl[2], dlb, za, zb, temp, rad, rae1, rae2;
-    double q = 1;
+template <typename T>
+void qlrpfl(const T pfl[], int klimx, int mdvarx, prop_type *prop,
+            propa_type *propa, propv_type *propv, ItmContext &ctx) {
+    int j;
+    double xl[2];
 
     prop->dist = pfl[0] * pfl[1]; /* total distance of the pfl array */
-    np = (int)pfl[0];             /* number of points in the pfl array */
 
-    hzns2(pfl,
-          prop); /* analyse pfl and store horizon/obstruction info in prop */
-
-    dlb = prop->dl[0] + prop->dl[1];
-    prop->rch[0] = prop->hg[0] + pfl[2];
-    prop->rch[1] = prop->hg[1] + pfl[np + 2];
+    hzns(pfl,
+         prop); /* analyse pfl and store horizon/obstruction info in prop */
 
     for (j = 0; j < 2; j++) /* for both tx and rx... */
         xl[j] = min(15.0 * prop->hg[j],
@@ -2785,8 +3145,34 @@ void qlrpfl2(const elev_t pfl[], int klimx, int mdvarx, prop_type *prop,
 
     xl[1] =
         prop->dist - xl[1]; /* adjust the rx distance to be from the far end */
-    prop->dh = d1thx2(pfl, xl[0],
-                      xl[1]); /* calculate the terrain irregularity factor */
+
+    prop->dh = ctx.D1thx(pfl, xl[0],
+                         xl[1]); /* calculate the terrain irregularity factor */
+
+    qlrpfl_profile(pfl, xl, NULL, klimx, mdvarx, prop, propa, propv);
+}
+
+/*
+ * The part of qlrpfl2() that follows the horizon and delta h calculations:
+ * effective heights, receiver approach angles and the call into lrprop2().
+ *
+ * xl[]: start and end of the terrain considered for the fits, in meters
+ *   ps: running sums over pfl for z1sq2_prefix(), or NULL
+ */
+template <typename T>
+static void qlrpfl2_profile(const T pfl[], const double xl[2],
+                            const z1sq_sums *ps, int klimx, int mdvarx,
+                            prop_type *prop, propa_type *propa,
+                            propv_type *propv) {
+    int np, j;
+    double dlb, za, zb, temp, rad, rae1, rae2;
+    double q = 1;
+
+    np = (int)pfl[0]; /* number of points in the pfl array */
+
+    dlb = prop->dl[0] + prop->dl[1];
+    prop->rch[0] = prop->hg[0] + pfl[2];
+    prop->rch[1] = prop->hg[1] + pfl[np + 2];
 
     /* The first branch of this if statement is for when there are no points in
      * array (e.g. called in the now-deprecated "area" mode, or when the
@@ -2798,11 +3184,11 @@ void qlrpfl2(const elev_t pfl[], int klimx, int mdvarx, prop_type *prop,
         /* TRANSHORIZON; diffraction over a mutual horizon, or for one or more
          * obstructions */
         if (dlb < 1.5 * prop->dist) {
-            z1sq2(pfl, xl[0], 0.9 * prop->dl[0], &za,
-                  &q); /* fit line to terrain from start to 90% of start
-                          horizon/obstacle */
-            z1sq2(pfl, prop->dist - 0.9 * prop->dl[1], xl[1], &q,
-                  &zb); /* ditto, but from the other end */
+            z1sq2_prefix(pfl, ps, xl[0], 0.9 * prop->dl[0], &za,
+                         &q); /* fit line to terrain from start to 90% of start
+                                 horizon/obstacle */
+            z1sq2_prefix(pfl, ps, prop->dist - 0.9 * prop->dl[1], xl[1], &q,
+                         &zb); /* ditto, but from the other end */
 
             prop->he[0] =
                 prop->hg[0] +
@@ -2815,7 +3201,7 @@ void qlrpfl2(const elev_t pfl[], int klimx, int mdvarx, prop_type *prop,
 
         /* Line-of-Sight path */
         else {
-            z1sq2(pfl, xl[0], xl[1], &za, &zb); /* fit a line */
+            z1sq2_prefix(pfl, ps, xl[0], xl[1], &za, &zb); /* fit a line */
             prop->he[0] =
                 prop->hg[0] +
                 FORTRAN_DIM(pfl[2],
@@ -2878,8 +3264,9 @@ void qlrpfl2(const elev_t pfl[], int klimx, int mdvarx, prop_type *prop,
                                        consider the last half-km only */
 
         if (prop->dist > 550.0) {
-            z1sq2(pfl, rad, prop->dist, &rae1,
-                  &rae2); /* do a least-squares fit on that last half-km.*/
+            z1sq2_prefix(pfl, ps, rad, prop->dist, &rae1,
+                         &rae2); /* do a least-squares fit on that last
+                                    half-km.*/
         } else {
             rae1 = 0.0;
             rae2 = 0.0;
@@ -2912,10 +3299,98 @@ void qlrpfl2(const elev_t pfl[], int klimx, int mdvarx, prop_type *prop,
     lrprop2(0.0, prop, propa);
 }
 
+/*
+ * qlrpfl2()
+ *
+ * Quick Longley-Rice Profile
+ *
+ * pfl[]: profile elevation array, with:
+ *          pfl[0]: number of points in pfl
+ *          pfl[1]: distance between points in pfl (in meters)
+ * klimx: climate code
+ * mdvarx: mode of variability. Usually 12, can be set to 1 for FCC mode.
+ * prop:  prop_type state variable
+ * propa: propa_type state variable
+ * propv: propv_type state variable
+ *   ctx: scratch memory for d1thx2()
+ *
+ * See ITWOM-SUB-ROUTINES.pdf p247
+ */
+template <typename T>
+void qlrpfl2(const T pfl[], int klimx, int mdvarx, prop_type *prop,
+             propa_type *propa, propv_type *propv, ItmContext &ctx) {
+    int j;
+    double xl[2];
+
+    prop->dist = pfl[0] * pfl[1]; /* total distance of the pfl array */
+
+    hzns2(pfl,
+          prop); /* analyse pfl and store horizon/obstruction info in prop */
+
+    for (j = 0; j < 2; j++) /* for both tx and rx... */
+        xl[j] = min(15.0 * prop->hg[j],
+                    0.1 * prop->dl[j]); /* ...set xl to min of 15x ant height or
+                                           1/10 horizon dist */
+
+    xl[1] =
+        prop->dist - xl[1]; /* adjust the rx distance to be from the far end */
+    prop->dh = ctx.D1thx2(
+        pfl, xl[0], xl[1]); /* calculate the terrain irregularity factor */
+
+    qlrpfl2_profile(pfl, xl, NULL, klimx, mdvarx, prop, propa, propv);
+}
+
 /***************************************************************************************
  * Point-To-Point Mode Calculations
  ***************************************************************************************/
 
+/*
+ * Fixed inputs of point_to_point_ITM(), shared with the radial engine.
+ */
+static void point_to_point_ITM_setup(double tht_m, double rht_m,
+                                     int radio_climate, prop_type *prop,
+                                     propv_type *propv) {
+    prop->hg[0] = tht_m;
+    prop->hg[1] = rht_m;
+    propv->klim = radio_climate;
+    prop->kwx = 0;
+    prop->mdp = -1;
+    propv->mdvar = 12;
+}
+
+/*
+ * Free space loss, mode string and variability for point_to_point_ITM(),
+ * once qlrpfl() has been run on the profile.
+ */
+static void point_to_point_ITM_loss(prop_type *prop, propa_type *propa,
+                                    propv_type *propv, double frq_mhz,
+                                    double zr, double zc, double &dbloss,
+                                    char *strmode, int &errnum) {
+    double fs, q;
+
+    fs = 32.45 + 20.0 * log10(frq_mhz) + 20.0 * log10(prop->dist / 1000.0);
+    q = prop->dist - propa->dla;
+
+    if (trunc(q) < 0.0)
+        strcpy(strmode, "Line-Of-Sight Mode");
+    else {
+        if (trunc(q) == 0.0)
+            strcpy(strmode, "Single Horizon");
+
+        else if (trunc(q) > 0.0)
+            strcpy(strmode, "Double Horizon");
+
+        if (prop->dist <= propa->dlsa || prop->dist <= propa->dx)
+            strcat(strmode, ", Diffraction Dominant");
+
+        else if (prop->dist > propa->dx)
+            strcat(strmode, ", Troposcatter Dominant");
+    }
+
+    dbloss = avar(zr, 0.0, zc, prop, propv) + fs; /* analysis of variants */
+    errnum = prop->kwx;
+}
+
 /******************************************************************************
   point_to_point_ITM()
 
@@ -2950,71 +3425,133 @@ void point_to_point_ITM(const elev_t elev[], double tht_m, double rht_m,
                         double eps_dielect, double sgm_conductivity,
                         double eno_ns_surfref, double frq_mhz,
                         int radio_climate, int pol, double conf, double rel,
-                        double &dbloss, char *strmode, int &errnum)
-
-{
-    prop_type prop = {0};
-    propv_type propv = {0};
-    propa_type propa = {0};
-    double zsys = 0;
-    double zc, zr;
-    double eno, enso, q;
-    long ja, jb, i, np;
-    /* double dkm, xkm; */
-    double fs;
-
-    prop.hg[0] = tht_m;
-    prop.hg[1] = rht_m;
-    propv.klim = radio_climate;
-    prop.kwx = 0;
-    prop.mdp = -1;
-    zc = qerfi(conf);
-    zr = qerfi(rel);
-    np = (long)elev[0];
-    eno = eno_ns_surfref;
-    enso = 0.0;
-    q = enso;
-
-    if (q <= 0.0) {
-        ja = (long)(3.0 + 0.1 * elev[0]); /* added (long) to correct */
-        jb = np - ja + 6;
-
-        for (i = ja - 1; i < jb; ++i)
-            zsys += elev[i];
+                        double &dbloss, char *strmode, int &errnum) {
+    default_context().PointToPointITM(
+        elev, tht_m, rht_m, eps_dielect, sgm_conductivity, eno_ns_surfref,
+        frq_mhz, radio_climate, pol, conf, rel, dbloss, strmode, errnum);
+}
 
-        zsys /= (jb - ja + 1);
-        q = eno;
-    }
+void ItmContext::PointToPointITM(const elev_t elev[], double tht_m,
+                                 double rht_m, double eps_dielect,
+                                 double sgm_conductivity,
+                                 double eno_ns_surfref, double frq_mhz,
+                                 int radio_climate, int pol, double conf,
+                                 double rel, double &dbloss, char *strmode,
+                                 int &errnum) {
+    PathLoss<ItmModel>(elev,
+                       Radio(eps_dielect, sgm_conductivity, eno_ns_surfref,
+                             frq_mhz, radio_climate, pol, conf, rel),
+                       tht_m, rht_m, dbloss, strmode, errnum);
+}
 
-    propv.mdvar = 12;
+/*
+ * Fixed inputs of point_to_point(), shared with the radial engine.
+ */
+static void point_to_point_setup(double tht_m, double rht_m, int radio_climate,
+                                 int pol, prop_type *prop, propv_type *propv) {
+    prop->hg[0] = tht_m;
+    prop->hg[1] = rht_m;
+    propv->klim = radio_climate;
+    prop->kwx = 0;
+    prop->mdp = -1;
+    prop->ptx = pol;
+    prop->thera = 0.0;
+    prop->thenr = 0.0;
 
-    qlrps(frq_mhz, zsys, q, pol, eps_dielect, sgm_conductivity,
-          &prop); /* quick longley rice - setup */
+    /* PRESET VALUES for Basic Version w/o additional inputs active */
 
-    qlrpfl(elev, propv.klim, propv.mdvar, &prop, &propa,
-           &propv); /* quick longley-rice, do the calculation */
+    prop->encc = 1000.00; /*  double enc_ncc_clcref preset  */
+    prop->cch = 22.5;     /* double clutter_height preset to ILLR calibration.;
+                             use 25.3 for ITU-P1546-2 calibration */
+    prop->cd = 1.00;      /* double clutter_density preset */
+    propv->mdvar = 1;     /* int mode_var set to 1 for FCC compatibility;
+                             normally, SPLAT presets this to 12 */
+    prop->dhd = 0.0;      /* delta_h_diff preset */
+}
 
-    fs = 32.45 + 20.0 * log10(frq_mhz) + 20.0 * log10(prop.dist / 1000.0);
-    q = prop.dist - propa.dla;
+/*
+ * Free space loss, mode string and variability for point_to_point(), once
+ * qlrpfl2() has been run on the profile.
+ */
+static void point_to_point_loss(prop_type *prop, propa_type *propa,
+                                propv_type *propv, double frq_mhz, double zr,
+                                double zc, double &dbloss, char *strmode,
+                                int &errnum) {
+    double tpd, fs, q;
+
+    tpd = sqrt((prop->he[0] - prop->he[1]) * (prop->he[0] - prop->he[1]) +
+               (prop->dist) * (prop->dist));
+    fs = 32.45 + 20.0 * log10(frq_mhz) + 20.0 * log10(tpd / 1000.0);
+    q = prop->dist - propa->dla;
 
     if (trunc(q) < 0.0)
-        strcpy(strmode, "Line-Of-Sight Mode");
+        strcpy(strmode, "L-o-S");
     else {
         if (trunc(q) == 0.0)
-            strcpy(strmode, "Single Horizon");
+            strcpy(strmode, "1_Hrzn");
 
         else if (trunc(q) > 0.0)
-            strcpy(strmode, "Double Horizon");
+            strcpy(strmode, "2_Hrzn");
 
-        if (prop.dist <= propa.dlsa || prop.dist <= propa.dx)
-            strcat(strmode, ", Diffraction Dominant");
+        if (prop->dist <= propa->dlsa || prop->dist <= propa->dx)
 
-        else if (prop.dist > propa.dx)
-            strcat(strmode, ", Troposcatter Dominant");
+            if (trunc(prop->dl[1]) == 0.0)
+                strcat(strmode, "_Peak");
+
+            else
+                strcat(strmode, "_Diff");
+
+        else if (prop->dist > propa->dx)
+            strcat(strmode, "_Tropo");
     }
 
-    dbloss = avar(zr, 0.0, zc, &prop, &propv) + fs; /* analysis of variants */
-    errnum = prop.kwx;
+    dbloss = avar(zr, 0.0, zc, prop, propv) + fs;
+    errnum = prop->kwx;
+}
+
+/*
+ * point_to_point() (ItwomModel) or point_to_point_ITM() (ItmModel) on a
+ * profile of heights of type T. The model is fixed at compile time, so the
+ * branches between the two fold away.
+ */
+template <class Model, typename T>
+void ItmContext::PathLoss(const T elev[], const ItmRadio &radio, double tht_m,
+                          double rht_m, double &dbloss, char *strmode,
+                          int &errnum) {
+    prop_type prop = {0};
+    propv_type propv = {0};
+    propa_type propa = {0};
+    double zsys = 0;
+    long ja, jb, i, np;
+
+    if (Model::itwom)
+        point_to_point_setup(tht_m, rht_m, radio.radio_climate, radio.pol,
+                             &prop, &propv);
+    else
+        point_to_point_ITM_setup(tht_m, rht_m, radio.radio_climate, &prop,
+                                 &propv);
+
+    np = (long)elev[0];
+    ja = (long)(3.0 + 0.1 * elev[0]); /* added (long) to correct */
+    jb = np - ja + 6;
+
+    for (i = ja - 1; i < jb; ++i)
+        zsys += elev[i];
+
+    zsys /= (jb - ja + 1);
+
+    radio.Setup(zsys, &prop); /* quick longley rice - setup */
+
+    if (Model::itwom) {
+        qlrpfl2(elev, propv.klim, propv.mdvar, &prop, &propa, &propv, *this);
+        point_to_point_loss(&prop, &propa, &propv, radio.frq_mhz, radio.zr,
+                            radio.zc, dbloss, strmode, errnum);
+    } else {
+        qlrpfl(elev, propv.klim, propv.mdvar, &prop, &propa, &propv,
+               *this); /* quick longley-rice, do the calculation */
+        point_to_point_ITM_loss(&prop, &propa, &propv, radio.frq_mhz,
+                                radio.zr, radio.zc, dbloss, strmode, errnum);
+    }
 }
 
 /******************************************************************************
@@ -3077,86 +3614,22 @@ void point_to_point(const elev_t elev[], double tht_m, double rht_m,
                     double eno_ns_surfref, double frq_mhz, int radio_climate,
                     int pol, double conf, double rel, double &dbloss,
                     char *strmode, int &errnum) {
-    prop_type prop = {0};
-    propv_type propv = {0};
-    propa_type propa = {0};
-
-    double zsys = 0;
-    double zc, zr;
-    double eno, enso, q;
-    long ja, jb, i, np;
-    /* double dkm, xkm; */
-    double tpd, fs;
-
-    prop.hg[0] = tht_m;
-    prop.hg[1] = rht_m;
-    propv.klim = radio_climate;
-    prop.kwx = 0;
-    prop.mdp = -1;
-    prop.ptx = pol;
-    prop.thera = 0.0;
-    prop.thenr = 0.0;
-    zc = qerfi(conf);
-    zr = qerfi(rel);
-    np = (long)elev[0];
-    /* dkm=(elev[1]*elev[0])/1000.0; */
-    /* xkm=elev[1]/1000.0; */
-    eno = eno_ns_surfref;
-    enso = 0.0;
-    q = enso;
-
-    /* PRESET VALUES for Basic Version w/o additional inputs active */
-
-    prop.encc = 1000.00; /*  double enc_ncc_clcref preset  */
-    prop.cch = 22.5;     /* double clutter_height preset to ILLR calibration.;
-                            use 25.3 for ITU-P1546-2 calibration */
-    prop.cd = 1.00;      /* double clutter_density preset */
-    int mode_var = 1;    /* int mode_var set to 1 for FCC compatibility;
-                            normally, SPLAT presets this to 12 */
-    prop.dhd = 0.0;      /* delta_h_diff preset */
-
-    if (q <= 0.0) {
-        ja = (long)(3.0 + 0.1 * elev[0]);
-        jb = np - ja + 6;
-
-        for (i = ja - 1; i < jb; ++i)
-            zsys += elev[i];
-
-        zsys /= (jb - ja + 1);
-        q = eno;
-    }
-
-    propv.mdvar = mode_var;
-    qlrps(frq_mhz, zsys, q, pol, eps_dielect, sgm_conductivity, &prop);
-    qlrpfl2(elev, propv.klim, propv.mdvar, &prop, &propa, &propv);
-    tpd = sqrt((prop.he[0] - prop.he[1]) * (prop.he[0] - prop.he[1]) +
-               (prop.dist) * (prop.dist));
-    fs = 32.45 + 20.0 * log10(frq_mhz) + 20.0 * log10(tpd / 1000.0);
-    q = prop.dist - propa.dla;
-
-    if (trunc(q) < 0.0)
-        strcpy(strmode, "L-o-S");
-    else {
-        if (trunc(q) == 0.0)
-            strcpy(strmode, "1_Hrzn");
-
-        else if (trunc(q) > 0.0)
-            strcpy(strmode, "2_Hrzn");
-
-        if (prop.dist <= propa.dlsa || prop.dist <= propa.dx)
-
-            if (trunc(prop.dl[1]) == 0.0)
-                strcat(strmode, "_Peak");
-
-            else
-                strcat(strmode, "_Diff");
-
-        else if (prop.dist > propa.dx)
-            strcat(strmode, "_Tropo");
-    }
+    default_context().PointToPoint(elev, tht_m, rht_m, eps_dielect,
+                                   sgm_conductivity, eno_ns_surfref, frq_mhz,
+                                   radio_climate, pol, conf, rel, dbloss,
+                                   strmode, errnum);
+}
 
-    dbloss = avar(zr, 0.0, zc, &prop, &propv) + fs;
-    errnum = prop.kwx;
+void ItmContext::PointToPoint(const elev_t elev[], double tht_m, double rht_m,
+                              double eps_dielect, double sgm_conductivity,
+                              double eno_ns_surfref, double frq_mhz,
+                              int radio_climate, int pol, double conf,
+                              double rel, double &dbloss, char *strmode,
+                              int &errnum) {
+    PathLoss<ItwomModel>(elev,
+                         Radio(eps_dielect, sgm_conductivity, eno_ns_surfref,
+                               frq_mhz, radio_climate, pol, conf, rel),
+                         tht_m, rht_m, dbloss, strmode, errnum);
 }
 
 /*************************************************************************************************
@@ -3240,7 +3713,8 @@ void point_to_pointMDH_two(const elev_t elev[], double tht_m, double rht_m,
     }
     propv.mdvar = 12;
     qlrps(frq_mhz, zsys, q, pol, eps_dielect, sgm_conductivity, &prop);
-    qlrpfl2(elev, propv.klim, propv.mdvar, &prop, &propa, &propv);
+    qlrpfl2(elev, propv.klim, propv.mdvar, &prop, &propa, &propv,
+            default_context());
     fs = 32.45 + 20.0 * log10(frq_mhz) + 20.0 * log10(prop.dist / 1000.0);
 
     *deltaH = prop.dh;
@@ -3334,7 +3808,8 @@ void point_to_pointDH(const elev_t elev[], double tht_m, double rht_m,
     }
     propv.mdvar = 12;
     qlrps(frq_mhz, zsys, q, pol, eps_dielect, sgm_conductivity, &prop);
-    qlrpfl2(elev, propv.klim, propv.mdvar, &prop, &propa, &propv);
+    qlrpfl2(elev, propv.klim, propv.mdvar, &prop, &propa, &propv,
+            default_context());
     fs = 32.45 + 20.0 * log10(frq_mhz) + 20.0 * log10(prop.dist / 1000.0);
     *deltaH = prop.dh;
     q = prop.dist - propa.dla;
@@ -3460,4 +3935,395 @@ double ITMAreadBLoss(long ModVar, double deltaH, double tht_m, double rht_m,
     return dbloss;
 }
 
+/******************************************************************************
+  ItmRadial
+
+  Incremental point_to_point()/point_to_point_ITM() along one radial. See
+  itwom3.0.h for the approach and its tolerance.
+ *****************************************************************************/
+
+/* Delta h is recomputed once the profile has grown by 1/2^DH_REFRESH_SHIFT of
+ * its length since the last exact computation. */
+#define DH_REFRESH_SHIFT 5
+
+/* The receiver hull is rebuilt when the earth curvature has drifted by more
+ * than this fraction from the one it was built with. */
+#define RX_HULL_DRIFT 1e-3
+
+template <class Model, typename T>
+ItmRadial<Model, T>::ItmRadial(ItmContext &ctx, const ItmRadio &radio,
+                               double tht_m, double rht_m, bool reuse_dh)
+    : ctx(&ctx), radio(radio), tht_m(tht_m), rht_m(rht_m),
+      reuse_dh(reuse_dh), xi(0.0), tx_next(1), rx_next(1), rx_qc(0.0),
+      dh_raw(0.0), dh_np(-1) {}
+
+template <class Model, typename T>
+void ItmRadial<Model, T>::SetProfile(const T heights[], int count,
+                                     double spacing) {
+    pfl.resize(count + 2);
+    pfl[0] = 0.0;
+    pfl[1] = (T)spacing;
+    xi = pfl[1];
+
+    sz.resize(count + 1);
+    sxz.resize(count + 1);
+    sz[0] = 0.0;
+    sxz[0] = 0.0;
+
+    for (int k = 0; k < count; k++) {
+        pfl[k + 2] = heights[k];
+        sz[k + 1] = sz[k] + pfl[k + 2];
+        sxz[k + 1] = sxz[k] + k * (double)pfl[k + 2];
+    }
+
+    tx_hull.clear();
+    tx_next = 1;
+    rx_hull.clear();
+    rx_next = 1;
+    rx_qc = 0.0;
+    dh_raw = 0.0;
+    dh_np = -1;
+}
+
+/* Slope from the transmitter antenna to profile point j, not adjusted for
+ * curvature. The curvature term of the horizon test is linear in the distance,
+ * so the point with the highest take-off angle for any curvature lies on the
+ * upper hull of these slopes. */
+template <class Model, typename T>
+double ItmRadial<Model, T>::TxSlope(int j) const {
+    return (pfl[j + 2] - (pfl[2] + tht_m)) / (j * xi);
+}
+
+/* Height of profile point k less the curvature drop rx_qc*x^2. For a fixed
+ * curvature, the point with the highest take-off angle from any receiver
+ * beyond the points lies on the upper hull of these heights. */
+template <class Model, typename T>
+double ItmRadial<Model, T>::RxHeight(int k) const {
+    double x = k * xi;
+
+    return pfl[k + 2] - rx_qc * x * x;
+}
+
+/* Take-off angle from a receiver antenna at height zb over point np to point
+ * k, adjusted for curvature qc as in hzns() and hzns2(). */
+template <class Model, typename T>
+double ItmRadial<Model, T>::RxAngle(int k, int np, double zb,
+                                    double qc) const {
+    double s = (np - k) * xi;
+
+    return (pfl[k + 2] - zb) / s - qc * s;
+}
+
+/* Finds the transmitter horizon among points 1..np-1: the first point with
+ * the highest take-off angle e for the curvature qc (half of gme). */
+template <class Model, typename T>
+int ItmRadial<Model, T>::TxHorizon(int np, double qc, double &e) {
+    int lo, hi, mid, h;
+    double x0, x1, y0, y1, y2;
+
+    /* extend the hull with the points the profile has grown by */
+    for (; tx_next < np; tx_next++) {
+        y2 = TxSlope(tx_next);
+
+        while ((h = (int)tx_hull.size()) >= 2) {
+            x0 = tx_hull[h - 2];
+            x1 = tx_hull[h - 1];
+            y0 = TxSlope(tx_hull[h - 2]);
+            y1 = TxSlope(tx_hull[h - 1]);
+
+            /* drop the last point unless it is strictly above the line from
+             * the one before it to the new point */
+            if ((x1 - x0) * (y2 - y0) - (y1 - y0) * (tx_next - x0) >= 0.0)
+                tx_hull.pop_back();
+            else
+                break;
+        }
+
+        tx_hull.push_back(tx_next);
+    }
+
+    /* the hull's edge slopes decrease, so walk to the first edge no steeper
+     * than the curvature */
+    lo = 0;
+    hi = (int)tx_hull.size() - 1;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+
+        if (TxSlope(tx_hull[mid + 1]) - TxSlope(tx_hull[mid]) >
+            qc * (tx_hull[mid + 1] - tx_hull[mid]) * xi)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    e = TxSlope(tx_hull[lo]) - qc * tx_hull[lo] * xi;
+
+    return tx_hull[lo];
+}
+
+/* Finds the receiver horizon among points 1..np-1 for a receiver antenna at
+ * height zb: the point with the highest take-off angle f from the receiver for
+ * the curvature qc. Ties go to the point nearest the receiver if near_rx is
+ * set, as in hzns2(), or farthest from it otherwise, as in hzns(). */
+template <class Model, typename T>
+int ItmRadial<Model, T>::RxHorizon(int np, double qc, double zb, bool near_rx,
+                                   double &f) {
+    int lo, hi, mid, h;
+    double x0, x1, y0, y1, y2, d, ry, fk;
+
+    if (rx_qc == 0.0 || fabs(qc - rx_qc) > RX_HULL_DRIFT * rx_qc) {
+        rx_qc = qc;
+        rx_hull.clear();
+        rx_next = 1;
+    }
+
+    for (; rx_next < np; rx_next++) {
+        y2 = RxHeight(rx_next);
+
+        while ((h = (int)rx_hull.size()) >= 2) {
+            x0 = rx_hull[h - 2];
+            x1 = rx_hull[h - 1];
+            y0 = RxHeight(rx_hull[h - 2]);
+            y1 = RxHeight(rx_hull[h - 1]);
+
+            if ((x1 - x0) * (y2 - y0) - (y1 - y0) * (rx_next - x0) >= 0.0)
+                rx_hull.pop_back();
+            else
+                break;
+        }
+
+        rx_hull.push_back(rx_next);
+    }
+
+    /* Seen from (d, ry), the take-off angle along the hull rises and then
+     * falls, so binary search for its peak with the hull's curvature... */
+    d = np * xi;
+    ry = zb - rx_qc * d * d;
+    lo = 0;
+    hi = (int)rx_hull.size() - 1;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        y0 = (RxHeight(rx_hull[mid]) - ry) / (d - rx_hull[mid] * xi);
+        y1 = (RxHeight(rx_hull[mid + 1]) - ry) / (d - rx_hull[mid + 1] * xi);
+
+        if (y1 > y0 || (near_rx && y1 == y0))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    /* ...then settle it with the actual curvature */
+    f = RxAngle(rx_hull[lo], np, zb, qc);
+
+    while (lo + 1 < (int)rx_hull.size() &&
+           ((fk = RxAngle(rx_hull[lo + 1], np, zb, qc)) > f ||
+            (near_rx && fk == f))) {
+        lo++;
+        f = fk;
+    }
+
+    while (lo > 0 && ((fk = RxAngle(rx_hull[lo - 1], np, zb, qc)) > f ||
+                      (!near_rx && fk == f))) {
+        lo--;
+        f = fk;
+    }
+
+    return rx_hull[lo];
+}
+
+/* hzns() for the prefix np, from the hulls */
+template <class Model, typename T>
+void ItmRadial<Model, T>::Horizons(int np, prop_type *prop) {
+    int j, k;
+    double za, zb, qc, q, e, f;
+
+    za = pfl[2] + prop->hg[0];
+    zb = pfl[np + 2] + prop->hg[1];
+
+    qc = 0.5 * prop->gme;
+    q = qc * prop->dist;
+
+    prop->the[1] = (zb - za) / prop->dist;
+    prop->the[0] = prop->the[1] - q;
+    prop->the[1] = -prop->the[1] - q;
+
+    prop->dl[0] = prop->dist;
+    prop->dl[1] = prop->dist;
+
+    if (np < 2)
+        return;
+
+    j = TxHorizon(np, qc, e);
+
+    if (e > prop->the[0]) {
+        prop->the[0] = e;
+        prop->dl[0] = j * xi;
+
+        /* Points short of the first transmitter obstruction, which hzns()
+         * skips, are below the transmitter-receiver line and so can't be
+         * the receiver horizon either. */
+        k = RxHorizon(np, qc, zb, false, f);
+
+        if (f > prop->the[1]) {
+            prop->the[1] = f;
+            prop->dl[1] = (np - k) * xi;
+        }
+    }
+}
+
+/* hzns2() for the prefix np, from the hulls */
+template <class Model, typename T>
+void ItmRadial<Model, T>::Horizons2(int np, prop_type *prop) {
+    int j, k;
+    double za, zb, qc, q, e, f;
+
+    za = pfl[2] + prop->hg[0];
+    zb = pfl[np + 2] + prop->hg[1];
+
+    prop->tiw = xi;
+    prop->ght = za;
+    prop->ghr = zb;
+
+    qc = 0.5 * prop->gme;
+    q = qc * prop->dist;
+
+    prop->the[1] = atan((zb - za) / prop->dist);
+    prop->the[0] = prop->the[1] - q;
+    prop->the[1] = -prop->the[1] - q;
+
+    prop->dl[0] = prop->dist;
+    prop->dl[1] = prop->dist;
+
+    prop->hht = 0.0;
+    prop->hhr = 0.0;
+    prop->los = true;
+
+    if (np >= 2) {
+        j = TxHorizon(np, qc, e);
+
+        if (e > prop->the[0]) {
+            k = RxHorizon(np, qc, zb, true, f);
+
+            /* hzns2() clamps near-vertical take-off angles as it goes, which
+             * the hulls can't follow. Let it do those. */
+            if (e > 1.569 || (f > prop->the[1] && (f > 1.57 || f < -1.568))) {
+                hzns2(&pfl[0], prop);
+                return;
+            }
+
+            prop->los = false;
+            prop->dl[0] = j * xi;
+            prop->hht = pfl[j + 2];
+
+            if (f > prop->the[1]) {
+                prop->hhr = pfl[k + 2];
+                prop->dl[1] = (np - k) * xi;
+            }
+
+            prop->the[0] = atan((prop->hht - za) / prop->dl[0]) -
+                           0.5 * prop->gme * prop->dl[0];
+            prop->the[1] = atan((prop->hhr - zb) / prop->dl[1]) -
+                           0.5 * prop->gme * prop->dl[1];
+        }
+    }
+
+    hzns2_reflection(&pfl[0], prop);
+}
+
+template <class Model, typename T>
+void ItmRadial<Model, T>::PathLoss(int np, double &dbloss, char *strmode,
+                                   int &errnum) {
+    prop_type prop = {0};
+    propv_type propv = {0};
+    propa_type propa = {0};
+    z1sq_sums ps = {&sz[0], &sxz[0]};
+    double zsys, xl[2], scale;
+    long ja, jb;
+    int j;
+
+    /* the hulls only grow; start over if asked to walk back */
+    if (np < tx_next || np < rx_next) {
+        tx_hull.clear();
+        tx_next = 1;
+        rx_hull.clear();
+        rx_next = 1;
+        dh_np = -1;
+    }
+
+    pfl[0] = (T)np;
+
+    /* same span as point_to_point(), from the running sums */
+    ja = (long)(3.0 + 0.1 * pfl[0]);
+    jb = np - ja + 6;
+    zsys = (sz[jb - 2] - sz[ja - 3]) / (jb - ja + 1);
+
+    if (Model::itwom)
+        point_to_point_setup(tht_m, rht_m, radio.radio_climate, radio.pol,
+                             &prop, &propv);
+    else
+        point_to_point_ITM_setup(tht_m, rht_m, radio.radio_climate, &prop,
+                                 &propv);
+
+    radio.Setup(zsys, &prop);
+
+    prop.dist = pfl[0] * pfl[1];
+
+    if (Model::itwom)
+        Horizons2(np, &prop);
+    else
+        Horizons(np, &prop);
+
+    for (j = 0; j < 2; j++)
+        xl[j] = min(15.0 * prop.hg[j], 0.1 * prop.dl[j]);
+
+    xl[1] = prop.dist - xl[1];
+
+    if (Model::itwom) {
+        if (!reuse_dh) {
+            prop.dh = ctx->D1thx2(&pfl[0], xl[0], xl[1]);
+        } else {
+            /* only the distance scaling of d1thx2() is redone in between */
+            scale = 1.0 - 0.8 * exp(-(xl[1] - xl[0]) / 50.0e3);
+
+            if (dh_np < 0 ||
+                np >= dh_np + max(1, dh_np >> DH_REFRESH_SHIFT)) {
+                dh_raw = ctx->D1thx2(&pfl[0], xl[0], xl[1]) * scale;
+                dh_np = np;
+            }
+
+            prop.dh = dh_raw / scale;
+        }
+
+        qlrpfl2_profile(&pfl[0], xl, &ps, propv.klim, propv.mdvar, &prop,
+                        &propa, &propv);
+        point_to_point_loss(&prop, &propa, &propv, radio.frq_mhz, radio.zr,
+                            radio.zc, dbloss, strmode, errnum);
+    } else {
+        /* d1thx() never looks at more than 245 points */
+        prop.dh = ctx->D1thx(&pfl[0], xl[0], xl[1]);
+
+        qlrpfl_profile(&pfl[0], xl, &ps, propv.klim, propv.mdvar, &prop,
+                       &propa, &propv);
+        point_to_point_ITM_loss(&prop, &propa, &propv, radio.frq_mhz,
+                                radio.zr, radio.zc, dbloss, strmode, errnum);
+    }
+}
+
+/*
+ * The kernels callers can pick from: either model, on float or double
+ * profiles.
+ */
+#define ITM_INSTANTIATE(Model, T)                                             \
+    template class ItmRadial<Model, T>;                                       \
+    template void ItmContext::PathLoss<Model, T>(                             \
+        const T elev[], const ItmRadio &radio, double tht_m, double rht_m,    \
+        double &dbloss, char *strmode, int &errnum);
+
+ITM_INSTANTIATE(ItmModel, float)
+ITM_INSTANTIATE(ItmModel, double)
+ITM_INSTANTIATE(ItwomModel, float)
+ITM_INSTANTIATE(ItwomModel, double)
+
 double ITWOMVersion() { return 3.0; }
@@ -11,12 +11,29 @@
 #ifndef splat_itwom3_0_h
 #define splat_itwom3_0_h
 
+#include <vector>
+
 #ifdef ITM_ELEV_DOUBLE
 #define elev_t double
 #else
 #define elev_t float
 #endif
 
+struct prop_type;
+
+/**
+ Model tags for the templated kernels below: the Longley-Rice ITM of
+ point_to_point_ITM(), or the ITWOM of point_to_point(). The model is picked
+ once per run rather than tested for on every sample.
+ */
+struct ItmModel {
+    static const bool itwom = false;
+};
+
+struct ItwomModel {
+    static const bool itwom = true;
+};
+
 double ITWOMVersion();
 
 void point_to_point_ITM(const elev_t elev[], double tht_m, double rht_m,
@@ -31,4 +48,263 @@ void point_to_point(const elev_t elev[], double tht_m, double rht_m,
                     int pol, double conf, double rel, double &dbloss,
                     char *strmode, int &errnum);
 
+/**
+ The radio parameters of one transmitter, and what the model derives from
+ them.
+
+ The wave number, ground impedance and the deviates for conf and rel depend
+ only on these parameters, so they are the same for every path of a
+ coverage run. They are worked out once, by the constructor. Only the surface
+ refractivity correction for the path's average elevation (zsys) is left to
+ Setup(), which is called once per path.
+ */
+class ItmRadio {
+  public:
+    /**
+     No radio; Matches() nothing valid.
+     */
+    ItmRadio();
+
+    /**
+     @param eps_dielect Earth's dielectric constant
+     @param sgm_conductivity Earth's conductivity, in Siemens per meter
+     @param eno_ns_surfref Atmospheric bending constant, in N-units
+     @param frq_mhz Frequency, in MHz
+     @param radio_climate Radio climate, as for point_to_point()
+     @param pol Polarization, as for point_to_point()
+     @param conf Fraction of situations, .01 to .99
+     @param rel Fraction of time, .01 to .99
+     */
+    ItmRadio(double eps_dielect, double sgm_conductivity,
+             double eno_ns_surfref, double frq_mhz, int radio_climate,
+             int pol, double conf, double rel);
+
+    double eps_dielect;
+    double sgm_conductivity;
+    double eno_ns_surfref;
+    double frq_mhz;
+    int radio_climate;
+    int pol;
+    double conf;
+    double rel;
+
+    /* wave number and ground impedance, as qlrps() sets them */
+    double wn;
+    double zgndreal;
+    double zgndimag;
+
+    /* standard normal deviates of conf and rel */
+    double zc;
+    double zr;
+
+    /**
+     Whether this radio was set up from exactly these parameters.
+     */
+    bool Matches(double eps_dielect, double sgm_conductivity,
+                 double eno_ns_surfref, double frq_mhz, int radio_climate,
+                 int pol, double conf, double rel) const;
+
+    /**
+     What qlrps() sets in prop, for a path of average elevation zsys.
+     */
+    void Setup(double zsys, prop_type *prop) const;
+};
+
+/**
+ Per height type scratch memory of an ItmContext.
+ */
+template <typename T> struct ItmScratch {
+    /* resampled profile for d1thx() and d1thx2() */
+    std::vector<T> profile;
+
+    /* gathered heights for Qtiles() */
+    std::vector<T> picked;
+};
+
+/**
+ Scratch memory and cached constants for the propagation model.
+
+ The terrain irregularity calculations need a temporary profile and
+ histogram on every call, and the variability deviates only change when the
+ confidence or reliability do. A context keeps both between calls so that
+ workers don't contend on the allocator. A context must not be shared between
+ threads; keep one per worker. point_to_point() and point_to_point_ITM() use
+ one context per calling thread.
+ */
+class ItmContext {
+  private:
+    ItmScratch<float> scratch_f;
+    ItmScratch<double> scratch_d;
+
+    /* histogram for Qtiles() */
+    std::vector<int> bins;
+    std::vector<int> bin_of;
+
+    /* radio parameters of the last call through Radio() */
+    ItmRadio radio;
+
+    template <typename T> ItmScratch<T> &Scratch();
+
+  public:
+    ItmContext();
+
+    /**
+     The ir1-th and ir2-th highest of a[0] to a[nn], in q1 and q2, as two
+     qtile() calls would find them, but in one pass and leaving a[] as it
+     is. Used by D1thx() and D1thx2() for the 90% and 10% heights.
+     */
+    template <typename T>
+    void Qtiles(const int nn, const T a[], const int ir1, const int ir2,
+                double &q1, double &q2);
+
+    /**
+     The radio setup for these parameters. The last one is kept, so that
+     callers that pass the same parameters every time only pay for the
+     comparison.
+     */
+    const ItmRadio &Radio(double eps_dielect, double sgm_conductivity,
+                          double eno_ns_surfref, double frq_mhz,
+                          int radio_climate, int pol, double conf, double rel);
+
+    /**
+     Delta h, the terrain irregularity, for the ITM. See d1thx().
+     */
+    template <typename T> double D1thx(const T pfl[], double x1, double x2);
+
+    /**
+     Delta h, the terrain irregularity, for the ITWOM. See d1thx2().
+     */
+    template <typename T> double D1thx2(const T pfl[], double x1, double x2);
+
+    /**
+     point_to_point() (ItwomModel) or point_to_point_ITM() (ItmModel) on a
+     profile of float or double heights, using this context's scratch memory.
+     */
+    template <class Model, typename T>
+    void PathLoss(const T elev[], const ItmRadio &radio, double tht_m,
+                  double rht_m, double &dbloss, char *strmode, int &errnum);
+
+    /**
+     point_to_point_ITM(), using this context's scratch memory.
+     */
+    void PointToPointITM(const elev_t elev[], double tht_m, double rht_m,
+                         double eps_dielect, double sgm_conductivity,
+                         double eno_ns_surfref, double frq_mhz,
+                         int radio_climate, int pol, double conf, double rel,
+                         double &dbloss, char *strmode, int &errnum);
+
+    /**
+     point_to_point(), using this context's scratch memory.
+     */
+    void PointToPoint(const elev_t elev[], double tht_m, double rht_m,
+                      double eps_dielect, double sgm_conductivity,
+                      double eno_ns_surfref, double frq_mhz, int radio_climate,
+                      int pol, double conf, double rel, double &dbloss,
+                      char *strmode, int &errnum);
+};
+
+/**
+ Path loss along one radial, for every prefix of its terrain profile.
+
+ Area studies call point_to_point() once per sample along a radial, each time
+ on a profile one sample longer than the last, which makes every radial
+ quadratic in its length. ItmRadial walks the profile outward instead and
+ carries the horizon, least-squares and terrain irregularity state from one
+ prefix to the next:
+
+ - zsys and the least-squares fits come from running sums over the profile.
+ - The transmitter horizon is kept on a convex hull of the profile as seen
+   from the transmitter, so finding it is a binary search.
+ - The receiver horizon is found the same way on a hull of the
+   curvature-adjusted profile. The hull is rebuilt whenever the effective
+   earth curvature (which depends on zsys) drifts by more than 0.1%.
+ - Delta h is still worked out on every prefix: the ITM's d1thx() never
+   looks at more than 245 points, but the ITWOM's d1thx2() resamples the
+   whole span, so it stays linear in the prefix. With reuse_dh, d1thx2() is
+   only run on short profiles and whenever the profile has grown by 1/32
+   since it was last run; in between, only its distance scaling is updated.
+
+ Tolerance, against point_to_point_ITM() and point_to_point() on the same
+ prefixes (697k prefixes of 400 synthetic profiles, 200 to 3200 points):
+
+ - ITM: within 1e-8 dB. Running sums and hull comparisons round differently
+   from the loops they replace, and two near-equal obstructions could swap
+   places as the horizon, but that was not seen.
+ - ITWOM: identical on every prefix. With reuse_dh, 99.99% of prefixes are
+   within 0.01 dB and the rest up to 6 dB: the few prefixes whose loss is
+   sensitive to delta h come out differently when it is only rescaled.
+
+ Model is ItmModel or ItwomModel, and T the type of the heights, float or
+ double. All four are compiled in; splat's "-double" option picks the double
+ ones at runtime.
+ */
+template <class Model, typename T> class ItmRadial {
+  private:
+    ItmContext *ctx;
+    ItmRadio radio;
+    double tht_m;
+    double rht_m;
+    bool reuse_dh;
+
+    /* profile in the layout expected by the propagation model:
+       [num points - 1], [delta dist(meters)], [height(meters)]... */
+    std::vector<T> pfl;
+    double xi;
+
+    /* running sums over the heights, see z1sq_sums */
+    std::vector<double> sz;
+    std::vector<double> sxz;
+
+    /* upper hull of the heights seen from the transmitter */
+    std::vector<int> tx_hull;
+    int tx_next;
+
+    /* upper hull of the curvature-adjusted heights, and the curvature used */
+    std::vector<int> rx_hull;
+    int rx_next;
+    double rx_qc;
+
+    /* last exact delta h, without its distance scaling */
+    double dh_raw;
+    int dh_np;
+
+    double TxSlope(int j) const;
+    double RxHeight(int k) const;
+    double RxAngle(int k, int np, double zb, double qc) const;
+    int TxHorizon(int np, double qc, double &e);
+    int RxHorizon(int np, double qc, double zb, bool near_rx, double &f);
+    void Horizons(int np, prop_type *prop);
+    void Horizons2(int np, prop_type *prop);
+
+  public:
+    /**
+     @param ctx Scratch memory for the calculations, owned by the caller and
+     used by no other thread while this radial is in use.
+     @param radio The transmitter's radio setup
+     @param tht_m Transmitter antenna height above ground, in meters
+     @param rht_m Receiver antenna height above ground, in meters
+     @param reuse_dh Whether the ITWOM's delta h may be reused between
+     prefixes rather than recomputed on every one
+     */
+    ItmRadial(ItmContext &ctx, const ItmRadio &radio, double tht_m,
+              double rht_m, bool reuse_dh = false);
+
+    /**
+     Sets the profile to walk.
+
+     @param heights Terrain heights in meters, heights[0] being the
+     transmitter's ground.
+     @param count The number of heights
+     @param spacing The distance between heights, in meters
+     */
+    void SetProfile(const T heights[], int count, double spacing);
+
+    /**
+     Path loss from the transmitter to heights[np], as point_to_point() (or
+     point_to_point_ITM()) would return it for elev[0] = np. np must not
+     decrease between calls for the same profile.
+     */
+    void PathLoss(int np, double &dbloss, char *strmode, int &errnum);
+};
+
 #endif
@@ -26,8 +26,10 @@
 #include "report.h"
 #include "sdf.h"
 #include "site.h"
+#include "tile_catalog.h"
 #include "udt.h"
 #include "utilities.h"
+#include "work_pool.h"
 #include <bzlib.h>
 #include <cmath>
 #include <cstdio>
@@ -42,6 +44,7 @@
 using namespace std;
 
 void check_allocation(void *ptr, string name, const SplatRun &sr);
+void size_paths(SplatRun &sr, const ElevationMap &em);
 
 int main(int argc, const char *argv[]) {
     size_t x, y, z = 0;
@@ -63,15 +66,19 @@ int main(int argc, const char *argv[]) {
     }
     SplatRun sr = *foo;
 
-    Sdf sdf(sr.sdf_path, sr);
+    /* One pool of workers, started once, for every phase of the run */
+    WorkPool pool(sr.multithread ? sr.threads : 0);
+    sr.pool = &pool;
+
+    TileCatalog catalog(sr);
+    catalog.Scan();
+
+    Sdf sdf(sr.sdf_path, sr, &catalog);
 
     // Now print the header:
     cout << "\n\t\t--==[ Welcome To " << SplatRun::splat_name << " v"
          << SplatRun::splat_version << " ]==--\n\n";
 
-    elev_t *elev = new elev_t[sr.arraysize + 10];
-    check_allocation(elev, "elev", sr);
-
     ElevationMap *em_p = new ElevationMap(sr);
     check_allocation(em_p, "em_p", sr);
 
@@ -97,6 +104,7 @@ int main(int argc, const char *argv[]) {
         Anf anf(lrp, sr);
 
         y = anf.LoadANO(sr.ani_filename, sdf, *em_p);
+        size_paths(sr, *em_p);
 
         for (x = 0; x < sr.tx_site.size(); x++)
             em_p->PlaceMarker(sr.tx_site[x]);
@@ -120,6 +128,8 @@ int main(int argc, const char *argv[]) {
             fflush(stdout);
         }
 
+        em_p->ReadAllPages();
+
         Image image(sr, sr.mapfile, sr.tx_site, *em_p);
         if (lrp.erp == 0.0) {
             image.WriteCoverageMap(MAPTYPE_PATHLOSS, sr.imagetype, region);
@@ -212,48 +222,6 @@ int main(int argc, const char *argv[]) {
 			}
             sr.deg_range = sr.max_range / 57.0;
 
-            /* Prevent the demand for a really wide coverage
-             from allocating more "pages" than are available
-             in memory. */
-
-            switch (sr.maxpages) {
-            case 1:
-                sr.deg_limit = 0.125;
-                break;
-
-            case 2:
-                sr.deg_limit = 0.25;
-                break;
-
-            case 4:
-                sr.deg_limit = 0.5;
-                break;
-
-            case 9:
-                sr.deg_limit = 1.0;
-                break;
-
-            case 16:
-                sr.deg_limit = 1.5; /* WAS 2.0 */
-                break;
-
-            case 25:
-                sr.deg_limit = 2.0; /* WAS 3.0 */
-                break;
-
-            case 36:
-                sr.deg_limit = 2.5; /* New! */
-                break;
-
-            case 49:
-                sr.deg_limit = 3.0; /* New! */
-                break;
-
-            case 64:
-                sr.deg_limit = 3.5; /* New! */
-                break;
-            }
-
             if (fabs(sr.tx_site[z].lat) < 70.0) {
                 sr.deg_range_lon = sr.deg_range / cos(DEG2RAD * sr.tx_site[z].lat);
             } else {
@@ -267,8 +235,8 @@ int main(int argc, const char *argv[]) {
             if (sr.deg_range_lon > sr.deg_limit)
                 sr.deg_range_lon = sr.deg_limit;
 
-            north_min = (int)floor(sr.tx_site[z].lat - sr.deg_range);
-            north_max = (int)floor(sr.tx_site[z].lat + sr.deg_range);
+            north_min = max((int)floor(sr.tx_site[z].lat - sr.deg_range), -90);
+            north_max = min((int)floor(sr.tx_site[z].lat + sr.deg_range), 89);
 
             west_min = (int)floor(sr.tx_site[z].lon - sr.deg_range_lon);
 
@@ -303,6 +271,8 @@ int main(int argc, const char *argv[]) {
         em_p->LoadTopoData(max_lon, min_lon, max_lat, min_lat, sdf);
     }
 
+    size_paths(sr, *em_p);
+
     if (!sr.udt_file.empty()) {
         Udt udt(sr);
         udt.LoadUDT(sr.udt_file, *em_p);
@@ -394,7 +364,7 @@ int main(int argc, const char *argv[]) {
                     pat.LoadAntennaPattern(patFilename);
                 }
                 report.PathReport(sr.tx_site[x], sr.rx_site, filename,
-                                  longly_file_exists, elev, pat, lrp);
+                                  longly_file_exists, pat, lrp);
             } else {
                 bool loadPat;
                 string patFilename;
@@ -402,7 +372,7 @@ int main(int argc, const char *argv[]) {
                 if (loadPat) {
                     pat.LoadAntennaPattern(patFilename);
                 }
-                report.PathReport(sr.tx_site[x], sr.rx_site, filename, true, elev,
+                report.PathReport(sr.tx_site[x], sr.rx_site, filename, true,
                                   pat, lrp);
             }
 
@@ -430,10 +400,18 @@ int main(int argc, const char *argv[]) {
         // Allocate the antenna pattern on the heap because it has a huge array
         // of floats that would otherwise be on the stack.
         AntennaPattern *p_pat = new AntennaPattern();
+
+        // The L-R maps of all the sites are plotted together, each with a
+        // copy of the pattern and parameters in force for its site.
+        vector<Site> lr_sites;
+        vector<const AntennaPattern *> lr_pats;
+        vector<Lrp> lr_lrps;
+
         for (x = 0; x < sr.tx_site.size(); x++) {
 
             if (sr.coverage) {
                 em_p->PlotLOSMap(sr.tx_site[x], sr.altitude);
+                report.SiteReport(sr.tx_site[x]);
             } else {
                 bool loadPat;
                 string patFilename;
@@ -443,12 +421,23 @@ int main(int argc, const char *argv[]) {
                 }
 
                 if (flag) {
-                    em_p->PlotLRMap(sr.tx_site[x], sr.altitudeLR, sr.ano_filename, *p_pat, lrp);
+                    lr_sites.push_back(sr.tx_site[x]);
+                    lr_pats.push_back(new AntennaPattern(*p_pat));
+                    lr_lrps.push_back(lrp);
                 }
             }
+        }
+
+        if (!sr.coverage) {
+            em_p->PlotLRMaps(lr_sites, sr.altitudeLR, sr.ano_filename, lr_pats,
+                             lr_lrps);
 
-            report.SiteReport(sr.tx_site[x]);
+            for (x = 0; x < sr.tx_site.size(); x++)
+                report.SiteReport(sr.tx_site[x]);
         }
+
+        for (x = 0; x < lr_pats.size(); x++)
+            delete lr_pats[x];
         delete p_pat;
     }
 
@@ -482,7 +471,9 @@ int main(int argc, const char *argv[]) {
             fflush(stdout);
         }
 
-        /* Plot the map */
+        /* Plot the map. Its shading needs the elevations of every page. */
+        em_p->ReadAllPages();
+
         Image image(sr, sr.mapfile, sr.tx_site, *em_p);
         if (sr.coverage || sr.pt2pt_mode || sr.topomap) {
             image.WriteCoverageMap(MAPTYPE_LOS, sr.imagetype, region);
@@ -522,7 +513,6 @@ int main(int argc, const char *argv[]) {
     // TODO: Why can't we clear. It complains about items already being
     // deleted?!
     // dem.clear();
-    delete[] elev;
 
     return 0;
 }
@@ -530,7 +520,13 @@ int main(int argc, const char *argv[]) {
 void check_allocation(void *ptr, string name, const SplatRun &sr) {
     if (ptr == NULL) {
         cerr << "\n\a*** ERROR: Could not allocate memory for " << name
-             << " with -maxpages == " << sr.maxpages << "\n\n";
+             << "\n\n";
         exit(-1);
     }
 }
+
+/* Paths can't run further than across every page of the region, so their
+   arrays are capped there. See Path::Reserve(). */
+void size_paths(SplatRun &sr, const ElevationMap &em) {
+    sr.arraysize = ((int)em.dem.size() + 1) * sr.ippd;
+}
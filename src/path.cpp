@@ -16,6 +16,7 @@
 #include "sdf.h"
 #include "site.h"
 #include "utilities.h"
+#include <algorithm>
 #include <bzlib.h>
 #include <cmath>
 #include <string>
@@ -24,14 +25,14 @@
 using namespace std;
 
 void Path::ReadPath(const Site &source, const Site &destination,
-                    const ElevationMap &em) {
+                    const ElevationMap &em, bool far_field) {
     /* This function generates a sequence of latitude and
      longitude positions between source and destination
      locations along a great circle path, and stores
      elevation and distance information for points
      along that path in the "path" structure. */
 
-    int c;
+    int c, level, step, i;
     double azimuth, distance_scalar, lat1, lon1, beta, den, num, lat2, lon2,
         total_distance, dx, dy, path_length, miles_per_sample,
         samples_per_radian = 68755.0;
@@ -75,12 +76,19 @@ void Path::ReadPath(const Site &source, const Site &destination,
         lat1 = lat1 / DEG2RAD;
         lon1 = lon1 / DEG2RAD;
 
+        Reserve(1);
+
         lat[c] = lat1;
         lon[c] = lon1;
         elevation[c] = em.GetElevation(source);
         distance[c] = 0.0;
     }
 
+    /* The loop below takes at most floor(path_length) + 2 samples, and
+       the destination one more. */
+
+    Reserve((int)path_length + 3);
+
     for (distance_scalar = 0.0, c = 0;
          (total_distance != 0.0 && distance_scalar <= total_distance &&
           c < arraysize);
@@ -121,8 +129,11 @@ void Path::ReadPath(const Site &source, const Site &destination,
         lon[c] = lon2;
         tempsite.lat = lat2;
         tempsite.lon = lon2;
-        elevation[c] = em.GetElevation(tempsite);
         distance[c] = distance_scalar;
+
+        /* Far-field points are filled in below */
+        if (!far_field || em.FarFieldLevel(distance_scalar) == 0)
+            elevation[c] = em.GetElevation(tempsite);
     }
 
     /* Make sure exact destination point is recorded at length-1 */
@@ -130,8 +141,10 @@ void Path::ReadPath(const Site &source, const Site &destination,
     if (c < arraysize) {
         lat[c] = destination.lat;
         lon[c] = destination.lon;
-        elevation[c] = em.GetElevation(destination);
         distance[c] = total_distance;
+
+        if (!far_field || em.FarFieldLevel(total_distance) == 0)
+            elevation[c] = em.GetElevation(destination);
         c++;
     }
 
@@ -139,6 +152,61 @@ void Path::ReadPath(const Site &source, const Site &destination,
         length = c;
     else
         length = arraysize - 1;
+
+    /* The coarse profiles start from the same ground as the full one */
+
+    levels = far_field ? em.FarFieldLevel(distance[length - 1]) : 0;
+
+    while (levels > 0 && (length - 1) >> levels < 2)
+        levels--;
+
+    for (level = 1; level <= levels; level++) {
+        step = 1 << level;
+        coarse[level - 1].resize((length - 1) / step + 1);
+        coarse[level - 1][0] = elevation[0];
+
+        for (i = 1; i * step < length; i++) {
+            tempsite.lat = lat[i * step];
+            tempsite.lon = lon[i * step];
+            coarse[level - 1][i] = em.GetElevation(tempsite, level);
+        }
+    }
+
+    /* Beyond the -farfield distances, each point takes the height of the
+       nearest point of its level's profile, or straight from the pyramid
+       if the path is too short to have that profile */
+
+    for (i = 1; far_field && i < length; i++) {
+        level = em.FarFieldLevel(distance[i]);
+
+        if (level == 0)
+            continue;
+
+        if (level > levels) {
+            tempsite.lat = lat[i];
+            tempsite.lon = lon[i];
+            elevation[i] = em.GetElevation(tempsite, level);
+            continue;
+        }
+
+        step = 1 << level;
+        elevation[i] = coarse[level - 1][min(
+            (i + step / 2) / step, (int)coarse[level - 1].size() - 1)];
+    }
+}
+
+/* Grows the arrays to hold size points, up to arraysize. They never shrink,
+   so reading a path no longer than one before allocates nothing. */
+void Path::Reserve(int size) {
+    if (size > arraysize)
+        size = arraysize;
+
+    if ((int)lat.size() < size) {
+        lat.resize(size);
+        lon.resize(size);
+        elevation.resize(size);
+        distance.resize(size);
+    }
 }
 
 Path::~Path() {}
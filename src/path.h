@@ -11,6 +11,7 @@
 #ifndef path_h
 #define path_h
 
+#include "dem.h"
 #include "site.h"
 
 #include <vector>
@@ -23,6 +24,8 @@ class Path {
     double ppd;
     int arraysize;
 
+    void Reserve(int size);
+
   public:
     std::vector<double> lat;
     std::vector<double> lon;
@@ -30,14 +33,28 @@ class Path {
     std::vector<double> distance;
     int length;
 
+    /* For far-field sampling: the heights of every 2nd, 4th and 8th point,
+       from levels 1, 2 and 3 of the terrain pyramid, for as many levels as
+       the path reaches. See ElevationMap::FarFieldLevel(). */
+    std::vector<double> coarse[DEM_LEVELS];
+    int levels;
+
   public:
+    /**
+     @param size The most points a path may hold. The arrays only grow as
+     far as the longest path read so far, so a Path kept and reused across
+     many short paths stays small.
+     @param ppd Pixels per degree of the elevation data
+     */
     Path(int size, double ppd)
-        : ppd(ppd), arraysize(size), lat(std::vector<double>(size)),
-          lon(std::vector<double>(size)), elevation(std::vector<double>(size)),
-          distance(std::vector<double>(size)), length(0) {}
+        : ppd(ppd), arraysize(size), length(0), levels(0) {}
 
+    /**
+     @param far_field Read points beyond the -farfield distances from the
+     terrain pyramid, and fill in coarse[]
+     */
     void ReadPath(const Site &source, const Site &destination,
-                  const ElevationMap &em);
+                  const ElevationMap &em, bool far_field = false);
 
     ~Path();
 };
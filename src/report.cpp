@@ -8,6 +8,7 @@
  * This file is covered by the LICENSE.md file in the root of this project.
  */
 
+#include <algorithm>
 #include <cmath>
 #include <cstdlib>
 #include <cstring>
@@ -25,11 +26,37 @@
 #include "sdf.h"
 #include "site.h"
 #include "utilities.h"
+#include "work_pool.h"
 
 using namespace std;
 
+/* Path loss to heights[np] (meters), on a profile of float or double heights
+   (-double) built in profile */
+template <typename T>
+static void PrefixLoss(ItmContext &itm, vector<T> &profile,
+                       const vector<double> &heights, const Path &path, int np,
+                       int propagation_model, const ItmRadio &radio,
+                       double tht_m, double rht_m, double &loss, char *mode,
+                       int &errnum) {
+    if (profile.size() < heights.size())
+        profile.resize(heights.size());
+
+    /* Distance between elevation samples */
+
+    profile[0] = np;
+    profile[1] = METERS_PER_MILE * (path.distance[np + 1] - path.distance[np]);
+    copy(heights.begin() + 2, heights.begin() + np + 3, profile.begin() + 2);
+
+    if (propagation_model == PROP_ITM)
+        itm.PathLoss<ItmModel>(&profile[0], radio, tht_m, rht_m, loss, mode,
+                               errnum);
+    else
+        itm.PathLoss<ItwomModel>(&profile[0], radio, tht_m, rht_m, loss, mode,
+                                 errnum);
+}
+
 void Report::PathReport(const Site &source, const Site &destination,
-                        const string &name, bool graph_it, elev_t elev[],
+                        const string &name, bool graph_it,
                         const AntennaPattern &pat, const Lrp &lrp) {
     /* This function writes a SPLAT! Path Report (name.txt) to
      the filesystem.  If (graph_it == 1), then gnuplot is invoked
@@ -351,20 +378,73 @@ void Report::PathReport(const Site &source, const Site &destination,
         path.ReadPath(source, destination, em); /* source=TX, destination=RX */
 
         /* Copy elevations plus clutter along
-         path into the elev[] array. */
+         path into the heights[] array. */
+
+        vector<double> heights(path.length + 2);
 
         for (x = 1; x < path.length - 1; x++)
-            elev[x + 2] =
+            heights[x + 2] =
                 METERS_PER_FOOT * (path.elevation[x] == 0.0
                                        ? path.elevation[x]
                                        : (sr.clutter + path.elevation[x]));
 
         /* Copy ending points without clutter */
 
-        elev[2] = path.elevation[0] * METERS_PER_FOOT;
-        elev[path.length + 1] =
+        heights[2] = path.elevation[0] * METERS_PER_FOOT;
+        heights[path.length + 1] =
             path.elevation[path.length - 1] * METERS_PER_FOOT;
 
+        /* Determine path loss for each point along
+         the path using ITWOM's point_to_point mode
+         starting at y=2 (number_of_points = 1), the
+         shortest distance terrain can play a role in
+         path loss. path.length-1 avoids LR error.
+         Every point is a profile of its own, all sharing
+         the same radio parameters. */
+
+        int points = path.length > 3 ? path.length - 3 : 0;
+        vector<int> errnums(points);
+        vector<double> losses(points);
+
+        if (points > 0) {
+            ItmRadio radio(lrp.eps_dielect, lrp.sgm_conductivity,
+                           lrp.eno_ns_surfref, lrp.frq_mhz, lrp.radio_climate,
+                           lrp.pol, lrp.conf, lrp.rel);
+
+            /* The profiles are independent, so the workers each take a run
+               of them, in a context and a copy of the heights of their
+               own. */
+            vector<WorkRange> ranges;
+
+            WorkPool::Split(0, points, 64, ranges);
+
+            sr.pool->Run(ranges, [&](const WorkRange &range) {
+                static thread_local ItmContext itm;
+                static thread_local vector<float> profile_f;
+                static thread_local vector<double> profile_d;
+                double tht_m = source.alt * METERS_PER_FOOT;
+                double rht_m = destination.alt * METERS_PER_FOOT;
+                char mode[100];
+                int i, np;
+
+                for (i = range.first; i < range.last; i++) {
+                    np = i + 1; /* (number of points - 1) */
+
+                    if (sr.double_profiles)
+                        PrefixLoss(itm, profile_d, heights, path, np,
+                                   sr.propagation_model, radio, tht_m, rht_m,
+                                   losses[i], mode, errnums[i]);
+                    else
+                        PrefixLoss(itm, profile_f, heights, path, np,
+                                   sr.propagation_model, radio, tht_m, rht_m,
+                                   losses[i], mode, errnums[i]);
+
+                    if (i == points - 1)
+                        strcpy(strmode, mode); /* reported below */
+                }
+            });
+        }
+
         fd = fopen("profile.gp", "w");
 
         azimuth = rint(source.Azimuth(destination));
@@ -418,33 +498,8 @@ void Report::PathReport(const Site &source, const Site &destination,
                  to the first obstruction (if it exists). */
             }
 
-            /* Determine path loss for each point along
-             the path using ITWOM's point_to_point mode
-             starting at x=2 (number_of_points = 1), the
-             shortest distance terrain can play a role in
-             path loss. */
-
-            elev[0] = y - 1; /* (number of points - 1) */
-
-            /* Distance between elevation samples */
-
-            elev[1] =
-                METERS_PER_MILE * (path.distance[y] - path.distance[y - 1]);
-
-            if (sr.propagation_model == PROP_ITM)
-                point_to_point_ITM(elev, source.alt * METERS_PER_FOOT,
-                                   destination.alt * METERS_PER_FOOT,
-                                   lrp.eps_dielect, lrp.sgm_conductivity,
-                                   lrp.eno_ns_surfref, lrp.frq_mhz,
-                                   lrp.radio_climate, lrp.pol, lrp.conf,
-                                   lrp.rel, loss, strmode, errnum);
-            else
-                point_to_point(elev, source.alt * METERS_PER_FOOT,
-                               destination.alt * METERS_PER_FOOT,
-                               lrp.eps_dielect, lrp.sgm_conductivity,
-                               lrp.eno_ns_surfref, lrp.frq_mhz,
-                               lrp.radio_climate, lrp.pol, lrp.conf, lrp.rel,
-                               loss, strmode, errnum);
+            loss = losses[y - 2];
+            errnum = errnums[y - 2];
 
             if (block)
                 elevation = ((acos(cos_test_angle)) / DEG2RAD) - 90.0;
@@ -34,7 +34,7 @@ class Report {
           em(em), sr(sr), path(sr.arraysize, sr.ppd) {}
 
     void PathReport(const Site &source, const Site &destination,
-                    const std::string &name, bool graph_it, elev_t elev[],
+                    const std::string &name, bool graph_it,
                     const AntennaPattern &pat, const Lrp &lrp);
 
     void SiteReport(const Site &xmtr);
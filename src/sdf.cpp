@@ -15,7 +15,10 @@
 #include "antenna_pattern.h"
 #include "path.h"
 #include "sdf_bz.h"
+#include "sdf_gdal.h"
+#include "sdf_hgt.h"
 #include "site.h"
+#include "sysutil.h"
 #include <cmath>
 #include <cstdlib>
 #include <cstring>
@@ -24,271 +27,544 @@
 
 using namespace std;
 
-/// This function reads a SPLAT Data File containing digital elevation model
-/// data into memory.  Elevation data, maximum and minimum elevations, and
-/// quadrangle limits are stored in the first available em.dem[] structure. The
-/// caller must provide minimum and maximum lattitude and longitude values.
-/// These determine the DEM this function picks. If the DEM already exists in
-/// the Elevation Map, this function exits. It also exits if there are no more
-/// DEM pages available into which the data may be loaded.
-/// @param em The elevation map into which to load the SDF data
-/// @param name The name of the SDF without the filename suffix
-/// @param minlat The minimum lattitude value
-/// @param maxlat The maximum lattitude value
-/// @param minlon The minimum longitude value
-/// @param maxlon The maximum longitude value
-int Sdf::LoadSDF(ElevationMap &em, const string &name, int minlat, int maxlat,
-                 int minlon, int maxlon) {
-    int x, y, data, indx;
-    char *string;
-
-    std::string path_plus_name;
-    std::string sdf_file = name + suffix;
-
-    Dem *dem = FindEmptyDem(em, minlat, maxlat, minlon, maxlon, indx);
-
-    // Early-out if there's no need to load the file
-    if (dem == NULL) {
-        return 0;
-    }
+/// This function finds the elevation file for a page, whose limits must
+/// already be set by ElevationMap::AddPage(), and records it in dem.file for
+/// LoadSDF(). The file is picked from the catalog, which was scanned once at
+/// startup. It prefers a binary SDF (since it needs no parsing), then an
+/// uncompressed SDF, then a compressed one, then an SRTM .hgt file, each
+/// from the current working directory first and then from the SDF path, and
+/// lastly a GeoTIFF DEM. If none is found, then we can assume that no
+/// elevation data exists for the region, and that it must be entirely over
+/// water. In addition, only HD SDF files (using the appropriate filename
+/// particle) are used if Splat! is configured to run in HD mode.
+///
+/// Pages are found in the order they are added, so that what this reports
+/// doesn't depend on the order in which they are later read.
+/// @param dem The page whose file to find
+/// @param indx The index of the page, for messages
+void Sdf::FindSDF(Dem &dem, int indx) {
+    string name = "" + to_string(dem.min_north) + sr.sdf_delimiter +
+                  to_string(dem.max_north) + sr.sdf_delimiter +
+                  to_string(dem.min_west) + sr.sdf_delimiter +
+                  to_string(dem.max_west) + (sr.hd_mode ? "-hd" : "");
+    vector<const TileCatalog::Tile *> found;
+    FILE *file;
+
+    dem.file.clear();
+
+    if (catalog != NULL)
+        found = catalog->Find(dem.min_north, dem.min_west);
+
+    for (size_t i = 0; i < found.size() && dem.file.empty(); i++) {
+        if (found[i]->format != TileCatalog::BSDF) {
+            dem.file = found[i]->path;
+            continue;
+        }
 
-    /* Search for SDF file in current working directory first */
-    path_plus_name = sdf_file;
-    if (!OpenFile(path_plus_name)) {
-        /* Next, try loading SDF file from path specified
-         in $HOME/.splat_path file or by -d argument */
-        path_plus_name = sdf_path + sdf_file;
+        file = fopen(found[i]->path.c_str(), "rb");
 
-        // Stop here if the file couldn't be opened
-        if (!OpenFile(path_plus_name)) {
-            return -1;
-        }
+        if (file == NULL)
+            continue;
+
+        if (CheckBinarySDF(dem, file, found[i]->path))
+            dem.file = found[i]->path;
+
+        fclose(file);
     }
 
-    fprintf(stdout, "Loading \"%s\" into page %d...", path_plus_name.c_str(),
-            indx + 1);
+    if (dem.file.empty())
+        fprintf(stdout, "Region  \"%s\" assumed as sea-level for page %d\n",
+                name.c_str(), indx + 1);
+    else
+        fprintf(stdout, "Using \"%s\" for page %d\n", dem.file.c_str(),
+                indx + 1);
+
     fflush(stdout);
+}
 
-    sscanf(GetString(), "%d", &dem->max_west);
-    sscanf(GetString(), "%d", &dem->min_north);
-    sscanf(GetString(), "%d", &dem->min_west);
-    sscanf(GetString(), "%d", &dem->max_north);
+/// This function reads a SPLAT Data File containing digital elevation model
+/// data into the terrain of a page. Its maximum and minimum elevations are
+/// set as the data is read. The file is read in large blocks and parsed in
+/// place, rather than a line at a time. Any heights missing from a truncated
+/// file are left at sea-level.
+/// @param dem The page into which to load the SDF data
+/// @param path_plus_name The file to read
+int Sdf::LoadSDF(Dem &dem, const string &path_plus_name) {
+    int x, y, got, data, limit, max_el = dem.max_el, min_el = dem.min_el;
+
+    // Stop here if the file couldn't be opened
+    if (!OpenFile(path_plus_name)) {
+        return -1;
+    }
+
+    block.resize(SDFBUFFER + 1);
+    block_pos = block_end = 0;
+    block_eof = false;
+    block[0] = 0;
+
+    AllocateData(dem);
+
+    /* The limits are already known from the name */
+    for (x = 0; x < 4; x++)
+        GetInt(limit);
+
+    row.resize(sr.ippd);
 
     for (x = 0; x < sr.ippd; x++) {
-        for (y = 0; y < sr.ippd; y++) {
-            string = GetString();
-            data = atoi(string);
+        got = GetInts(&row[0], sr.ippd);
+
+        for (y = 0; y < got; y++) {
+            data = row[y];
+            dem.data[sr.Cell(x, y)] = data;
 
-            dem->data[x * sr.ippd + y] = data;
-            dem->signal[x * sr.ippd + y] = 0;
-            dem->mask[x * sr.ippd + y] = 0;
+            if (data > max_el)
+                max_el = data;
 
-            if (data > dem->max_el)
-                dem->max_el = data;
+            if (data < min_el)
+                min_el = data;
+        }
 
-            if (data < dem->min_el)
-                dem->min_el = data;
+        if (got < sr.ippd) {
+            fprintf(stderr, "\n*** WARNING: \"%s\" is truncated.\n",
+                    path_plus_name.c_str());
+            break;
         }
     }
 
     CloseFile();
 
-    if (dem->min_el < em.min_elevation)
-        em.min_elevation = dem->min_el;
+    dem.max_el = max_el;
+    dem.min_el = min_el;
+
+    return 1;
+}
+
+/// This function loads the terrain of a page from the file that FindSDF()
+/// picked for it, or fills it with sea-level if there is none. Pages may be
+/// loaded concurrently, each through its own Sdf.
+///
+/// With a tile cache (-tilecache), a page that has to be decoded is mapped
+/// from the cache instead if another run already decoded it. Otherwise it is
+/// decoded, and then written to the cache and mapped from there, so that its
+/// memory is shared with every other run that maps it. See CachePath().
+/// Like any mapped page, an evicted one is handed back through
+/// SysUtil::DiscardFile() and read back from the cache file when next used.
+/// A page of its own memory is read back into that memory, since workers
+/// may be reading it at any time; see MapSDF().
+/// @param dem The page into which to load the SDF data
+/// @param indx The index of the page, for messages
+char Sdf::LoadSDF(Dem &dem, int indx) {
+    int loaded = -1;
+    bool first = !dem.present.load(std::memory_order_relaxed);
+    string cached;
+
+    if (!dem.file.empty()) {
+        if (SysUtil::HasSuffix(dem.file, ".bsdf")) {
+            loaded = MapSDF(dem, dem.file);
+        } else {
+            cached = CachePath(dem);
+
+            if (!cached.empty() && MapSDF(dem, cached) == 1)
+                return 1;
+
+            if (SysUtil::HasSuffix(dem.file, ".bz2")) {
+                SdfBz sdfBz = SdfBz(sdf_path, sr);
+                loaded = sdfBz.LoadSDF(dem, dem.file);
+            } else if (SysUtil::HasSuffix(dem.file, ".hgt")) {
+                SdfHgt sdfHgt = SdfHgt(sdf_path, sr);
+                loaded = sdfHgt.LoadHGT(dem, dem.file);
+            } else if (SysUtil::HasSuffix(dem.file, ".sdf")) {
+                loaded = LoadSDF(dem, dem.file);
+            } else {
+                SdfGdal sdfGdal = SdfGdal(sdf_path, sr);
+                loaded = sdfGdal.LoadRaster(dem, dem.file);
+            }
+
+            if (loaded == 1 && first && !cached.empty() &&
+                WriteCache(dem, cached))
+                MapSDF(dem, cached);
+        }
+
+        if (loaded == 1) {
+            return 1;
+        }
+
+        fprintf(stderr,
+                "\n*** WARNING: Could not read \"%s\". Assuming page %d is "
+                "at sea-level.\n",
+                dem.file.c_str(), indx + 1);
+    }
+
+    AllocateData(dem);
 
-    if (dem->max_el > em.max_elevation)
-        em.max_elevation = dem->max_el;
+    /* Fill DEM with sea-level topography */
+
+    memset(dem.data, 0, sizeof(short) * sr.ippd * sr.ippd);
+
+    if (dem.min_el > 0)
+        dem.min_el = 0;
 
-    if (em.max_north == -90) {
-        em.max_north = dem->max_north;
-    } else if (dem->max_north > em.max_north) {
-        em.max_north = dem->max_north;
+    return 0;
+}
+
+/// This function checks that the header of a binary SDF (see
+/// utils/sdf2bsdf.c) matches the page, warning if it doesn't. The header is
+/// 64 bytes of little-endian 32 bit integers: "SPLATSDB", version, points
+/// per degree, max_west, min_north, min_west, max_north, min_el and max_el.
+/// The little-endian 16 bit heights follow, row after row in version 1, or
+/// in 16 x 16 point blocks in version 2, which only the tile cache of a
+/// -blocked run holds. See SplatRun::Cell().
+/// @param dem The page
+/// @param header The first 64 bytes of the file
+/// @param bytes The size of the file
+/// @param path_plus_name The file, for messages
+/// @param min_el Set to the file's minimum elevation
+/// @param max_el Set to the file's maximum elevation
+/// @param blocked Set if the heights are in blocks
+bool Sdf::ParseBinarySDF(const Dem &dem, const unsigned char *header,
+                         size_t bytes, const string &path_plus_name,
+                         int &min_el, int &max_el, bool &blocked) {
+    int field[8];
+    bool valid = bytes == 64 + sizeof(short) * sr.ippd * sr.ippd &&
+                 memcmp(header, "SPLATSDB", 8) == 0;
+
+    for (int i = 0; valid && i < 8; i++)
+        field[i] = (int)((unsigned)header[8 + 4 * i] |
+                         (unsigned)header[9 + 4 * i] << 8 |
+                         (unsigned)header[10 + 4 * i] << 16 |
+                         (unsigned)header[11 + 4 * i] << 24);
+
+    if (!valid || (field[0] != 1 && field[0] != 2) || field[1] != sr.ippd ||
+        field[2] != dem.max_west || field[3] != dem.min_north ||
+        field[4] != dem.min_west || field[5] != dem.max_north) {
+        fprintf(stderr, "\n*** WARNING: \"%s\" is not a binary SDF for "
+                        "this page. Ignoring it.\n",
+                path_plus_name.c_str());
+        return false;
     }
 
-    if (em.min_north == 90) {
-        em.min_north = dem->min_north;
-    } else if (dem->min_north < em.min_north) {
-        em.min_north = dem->min_north;
+    min_el = field[6];
+    max_el = field[7];
+    blocked = field[0] == 2;
+
+    return true;
+}
+
+/// This function checks an open binary SDF, for FindSDF().
+/// @param dem The page
+/// @param file The open file
+/// @param path_plus_name The file, for messages
+bool Sdf::CheckBinarySDF(const Dem &dem, FILE *file,
+                         const string &path_plus_name) {
+    unsigned char header[64];
+    int min_el, max_el;
+    bool blocked;
+    long bytes;
+
+    if (!LittleEndian())
+        return false;
+
+    if (fseek(file, 0, SEEK_END) != 0 || (bytes = ftell(file)) < 64 ||
+        fseek(file, 0, SEEK_SET) != 0 || fread(header, 1, 64, file) != 64)
+        bytes = 0;
+
+    return ParseBinarySDF(dem, header, bytes, path_plus_name, min_el, max_el,
+                          blocked);
+}
+
+/// This function maps a binary SDF and points the page's terrain into it,
+/// so that it is used in place rather than parsed. A file in the other
+/// layout (see SplatRun::Cell()) is copied into memory of the page's own.
+/// So is any file read into a page that was read before: workers may be
+/// reading its terrain, so it must stay where it is.
+/// @param dem The page into which to map the SDF data
+/// @param path_plus_name The file to map
+int Sdf::MapSDF(Dem &dem, const string &path_plus_name) {
+    size_t bytes = 0;
+    void *map = SysUtil::MapFile(path_plus_name.c_str(), bytes);
+    const short *heights;
+    bool blocked;
+    int x, y;
+
+    if (map == NULL)
+        return -1;
+
+    if (!ParseBinarySDF(dem, (const unsigned char *)map, bytes,
+                        path_plus_name, dem.min_el, dem.max_el, blocked)) {
+        SysUtil::UnmapFile(map, bytes);
+        return -1;
     }
 
-    if (em.max_west == -1) {
-        em.max_west = dem->max_west;
-    } else {
-        if (abs(dem->max_west - em.max_west) < 180) {
-            if (dem->max_west > em.max_west)
-                em.max_west = dem->max_west;
+    if (blocked != sr.blocked_pages ||
+        dem.present.load(std::memory_order_relaxed)) {
+        heights = (const short *)((unsigned char *)map + 64);
+        AllocateData(dem);
+
+        if (blocked == sr.blocked_pages) {
+            memcpy(dem.data, heights, bytes - 64);
         } else {
-            if (dem->max_west < em.max_west)
-                em.max_west = dem->max_west;
+            for (x = 0; x < sr.ippd; x++) {
+                for (y = 0; y < sr.ippd; y++) {
+                    if (blocked)
+                        dem.data[x * sr.ippd + y] =
+                            heights[sr.BlockedCell(x, y)];
+                    else
+                        dem.data[sr.BlockedCell(x, y)] =
+                            heights[x * sr.ippd + y];
+                }
+            }
         }
+
+        SysUtil::UnmapFile(map, bytes);
+        return 1;
     }
 
-    if (em.min_west == 360) {
-        em.min_west = dem->min_west;
-    } else {
-        if (abs(dem->min_west - em.min_west) < 180) {
-            if (dem->min_west < em.min_west)
-                em.min_west = dem->min_west;
-        } else {
-            if (dem->min_west > em.min_west)
-                em.min_west = dem->min_west;
-        }
+    /* The terrain may have been decoded into memory of its own first */
+    if (dem.map != NULL) {
+        if (dem.map_file)
+            SysUtil::UnmapFile(dem.map, dem.map_bytes);
+        else
+            SysUtil::UnmapMemory(dem.map, dem.map_bytes);
     }
 
-    fprintf(stdout, " Done!\n");
-    fflush(stdout);
+    dem.data = (short *)((unsigned char *)map + 64);
+    dem.map = map;
+    dem.map_bytes = bytes;
+    dem.map_file = true;
 
     return 1;
 }
 
-/// This function loads the requested SDF file from the filesystem. It first
-/// tries to load an uncompressed SDF file (since uncompressed files load
-/// slightly faster).  If that attempt fails, then it tries to load a compressed
-/// SDF file. If that fails, then we can assume that no elevation data exists
-/// for the region requested, and that the region requested must be entirely
-/// over water. In addition, this function will load HD SDF files (using the
-/// appropriate filename particle) if Splat! is configured to run in HD mode.
-/// The caller must provide minimum and maximum lattitude and longitude values.
-/// These determine the DEM this function picks. If the DEM already exists in
-/// the Elevation Map, this function exits. It also exits if there are no more
-/// DEM pages available into which the data may be loaded.
-/// @param em The elevation map into which to load the SDF data
-/// @param minlat The minimum lattitude value
-/// @param maxlat The maximum lattitude value
-/// @param minlon The minimum longitude value
-/// @param maxlon The maximum longitude value
-char Sdf::LoadSDF(ElevationMap &em, int minlat, int maxlat, int minlon,
-                  int maxlon) {
-    int x, y, indx;
-    int return_value = -1;
-    string name = "" + to_string(minlat) + sr.sdf_delimiter +
-                  to_string(maxlat) + sr.sdf_delimiter + to_string(minlon) +
-                  sr.sdf_delimiter + to_string(maxlon) +
-                  (sr.hd_mode ? "-hd" : "");
-
-    // Try to load an uncompressed SDF first.
-    // Stop here if we successfully loaded the file
-    if (LoadSDF(em, name, minlat, maxlat, minlon, maxlon) == 1) {
-        return return_value;
+/// This function names the file in the tile cache (-tilecache) for a page,
+/// or returns "" if there is no cache. Cached pages are binary SDFs. Their
+/// names hold the page's limits and a hash of the source file's name, size
+/// and modification time, so that a changed source gets a new entry rather
+/// than replacing one that other runs may have mapped. -blocked runs keep
+/// entries of their own, in their layout.
+/// @param dem The page
+string Sdf::CachePath(const Dem &dem) const {
+    unsigned long long bytes = 0, hash = 14695981039346656037ULL;
+    long long mtime = 0;
+    char suffix[40];
+    string key;
+
+    if (sr.tile_cache.empty() || !LittleEndian() ||
+        !SysUtil::FileStamp(dem.file.c_str(), bytes, mtime))
+        return "";
+
+    key = dem.file + "|" + to_string(bytes) + "|" + to_string(mtime) + "|" +
+          to_string(sr.ippd) + (sr.blocked_pages ? "|blocked" : "");
+
+    /* FNV-1a */
+    for (size_t i = 0; i < key.size(); i++) {
+        hash ^= (unsigned char)key[i];
+        hash *= 1099511628211ULL;
     }
 
-    // Try loading a compressed SDF.
-    // Stop here if we successfully loaded the file
-    SdfBz sdfBz = SdfBz(sdf_path, sr);
-    if (sdfBz.LoadSDF(em, name, minlat, maxlat, minlon, maxlon) == 1) {
-        return return_value;
-    }
+    snprintf(suffix, sizeof(suffix), "-%016llx.bsdf", hash);
 
-    // If neither format can be found, then assume the area is water.
-    // Is it already in memory?
-    Dem *dem = FindEmptyDem(em, minlat, maxlat, minlon, maxlon, indx);
+    return sr.tile_cache + to_string(dem.min_north) + "_" +
+           to_string(dem.max_north) + "_" + to_string(dem.min_west) + "_" +
+           to_string(dem.max_west) + suffix;
+}
 
-    // Early-out if there's no need to load the data
-    if (dem == NULL) {
-        return 0;
+/// This function writes a decoded page to the tile cache as a binary SDF.
+/// The file is written under a name of this process's own and then renamed
+/// into place, so other runs only ever see whole files. Files in the cache
+/// are never changed once there, so they may be deleted at any time: runs
+/// that have them mapped keep their pages. Windows refuses to delete a
+/// mapped file, so there a file goes once no run has it mapped.
+/// @param dem The page
+/// @param path The file in the cache, from CachePath()
+bool Sdf::WriteCache(const Dem &dem, const string &path) const {
+    int field[8] = {sr.blocked_pages ? 2 : 1, sr.ippd, dem.max_west,
+                    dem.min_north, dem.min_west, dem.max_north, dem.min_el,
+                    dem.max_el};
+    unsigned char header[64];
+    size_t cells = (size_t)sr.ippd * sr.ippd;
+    unsigned long long bytes;
+    long long mtime;
+    string temp = path + "." + to_string(SysUtil::ProcessId()) + ".tmp";
+    FILE *file = fopen(temp.c_str(), "wb");
+    bool written;
+
+    if (file == NULL)
+        return false;
+
+    memset(header, 0, sizeof(header));
+    memcpy(header, "SPLATSDB", 8);
+
+    for (int i = 0; i < 8; i++) {
+        header[8 + 4 * i] = field[i] & 0xff;
+        header[9 + 4 * i] = (field[i] >> 8) & 0xff;
+        header[10 + 4 * i] = (field[i] >> 16) & 0xff;
+        header[11 + 4 * i] = (field[i] >> 24) & 0xff;
     }
 
-    fprintf(stdout, "Region  \"%s\" assumed as sea-level into page %d...",
-            name.c_str(), indx + 1);
-    fflush(stdout);
+    written = fwrite(header, 1, sizeof(header), file) == sizeof(header) &&
+              fwrite(dem.data, sizeof(short), cells, file) == cells;
+    written = fclose(file) == 0 && written;
 
-    dem->max_west = maxlon;
-    dem->min_north = minlat;
-    dem->min_west = minlon;
-    dem->max_north = maxlat;
+    if (written && rename(temp.c_str(), path.c_str()) == 0)
+        return true;
 
-    /* Fill DEM with sea-level topography */
+    remove(temp.c_str());
 
-    for (x = 0; x < sr.ippd; x++) {
-        for (y = 0; y < sr.ippd; y++) {
-            dem->data[x * sr.ippd + y] = 0;
-            dem->signal[x * sr.ippd + y] = 0;
-            dem->mask[x * sr.ippd + y] = 0;
+    /* Windows won't rename over a file. If another run got there first,
+       theirs is as good. */
+    return written && SysUtil::FileStamp(path.c_str(), bytes, mtime);
+}
 
-            if (dem->min_el > 0)
-                dem->min_el = 0;
-        }
-    }
+/// Binary SDFs are only used on little-endian hosts, since their heights are
+/// used as they are.
+bool Sdf::LittleEndian() {
+    const unsigned short one = 1;
 
-    if (dem->min_el < em.min_elevation)
-        em.min_elevation = dem->min_el;
+    return *(const unsigned char *)&one == 1;
+}
 
-    if (dem->max_el > em.max_elevation)
-        em.max_elevation = dem->max_el;
+/// Gives the page memory of its own for its terrain, unless it has some.
+/// @param dem The page
+void Sdf::AllocateData(Dem &dem) {
+    size_t bytes = sizeof(short) * sr.ippd * sr.ippd;
 
-    if (em.max_north == -90) {
-        em.max_north = dem->max_north;
-    } else if (dem->max_north > em.max_north) {
-        em.max_north = dem->max_north;
-    }
+    if (dem.data != NULL)
+        return;
 
-    if (em.min_north == 90) {
-        em.min_north = dem->min_north;
-    } else if (dem->min_north < em.min_north) {
-        em.min_north = dem->min_north;
-    }
+    dem.map = SysUtil::MapMemory(bytes);
 
-    if (em.max_west == -1) {
-        em.max_west = dem->max_west;
-    } else {
-        if (abs(dem->max_west - em.max_west) < 180) {
-            if (dem->max_west > em.max_west)
-                em.max_west = dem->max_west;
-        } else {
-            if (dem->max_west < em.max_west)
-                em.max_west = dem->max_west;
-        }
+    if (dem.map == NULL) {
+        fprintf(stderr, "\n*** ERROR: Could not allocate memory for a "
+                        "page\n");
+        exit(-1);
     }
 
-    if (em.min_west == 360) {
-        em.min_west = dem->min_west;
-    } else {
-        if (abs(dem->min_west - em.min_west) < 180) {
-            if (dem->min_west < em.min_west)
-                em.min_west = dem->min_west;
-        } else {
-            if (dem->min_west > em.min_west)
-                em.min_west = dem->min_west;
-        }
+    dem.data = (short *)dem.map;
+    dem.map_bytes = bytes;
+    dem.map_file = false;
+}
+
+/// Moves the unparsed rest of the block to its start, and reads as much of
+/// the file after it as fits. Returns false at the end of the file.
+bool Sdf::FillBlock() {
+    size_t left = block_end - block_pos;
+    int bytes;
+
+    memmove(&block[0], &block[block_pos], left);
+    block_pos = 0;
+    block_end = left;
+
+    bytes = ReadBlock(&block[left], (int)(SDFBUFFER - left));
+
+    if (bytes > 0)
+        block_end += bytes;
+
+    block[block_end] = 0;
+
+    return bytes > 0;
+}
+
+/// Parses the next whitespace separated integer of the open file into
+/// value, as atoi() would. Returns false at the end of the file.
+bool Sdf::GetInt(int &value) {
+    const char *p, *end;
+    bool negative;
+    int n = 0;
+
+    /* No number is longer than 16 characters, so one is never split
+       between reads unless the file ends first */
+    for (;;) {
+        if (block_end - block_pos < 16 && !block_eof)
+            block_eof = !FillBlock();
+
+        p = &block[block_pos];
+        end = &block[block_end];
+
+        while (p < end &&
+               (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t'))
+            p++;
+
+        block_pos = p - &block[0];
+
+        if (block_end - block_pos >= 16 || block_eof)
+            break;
     }
 
-    fprintf(stdout, " Done!\n");
-    fflush(stdout);
+    if (p == end)
+        return false;
 
-    return 1;
+    negative = (*p == '-');
+
+    if (negative || *p == '+')
+        p++;
+
+    /* The 0 after the block stops this */
+    while ((unsigned)(*p - '0') < 10)
+        n = 10 * n + (*p++ - '0');
+
+    /* Skip whatever else is in the word */
+    while (p < end && *p != ' ' && *p != '\n' && *p != '\r' && *p != '\t')
+        p++;
+
+    block_pos = p - &block[0];
+    value = negative ? -n : n;
+
+    return true;
 }
 
-/// Returns the DEM matching the given coordinates. Returns NULL if the DEM
-/// couldn't be found or it isn't empty.
-/// @param em The Elevation Map in which to look for an empty DEM
-/// @param minlat The minimum lattitude value
-/// @param maxlat The maximum lattitude value
-/// @param minlon The minimum longitude value
-/// @param maxlon The maximum longitude value
-/// @param indx The index of the found DEM.
-Dem *Sdf::FindEmptyDem(ElevationMap &em, int minlat, int maxlat, int minlon,
-                       int maxlon, int &indx) {
-    for (int i = 0; i < sr.maxpages; i++) {
-        if (minlat == em.dem[i].min_north && minlon == em.dem[i].min_west &&
-            maxlat == em.dem[i].max_north && maxlon == em.dem[i].max_west) {
-            // It already exists. It's not empty
-            return NULL;
+/// Parses up to count whitespace separated integers of the open file into
+/// values, as GetInt() would. Returns how many were parsed, which is less
+/// than count only at the end of the file. The numbers that start at least
+/// 16 characters short of the end of the block are parsed in one tight loop
+/// here, which is most of them; GetInt() refills the block for the rest.
+int Sdf::GetInts(int values[], int count) {
+    const char *p, *end;
+    bool negative;
+    int i = 0, n;
+
+    while (i < count) {
+        p = &block[block_pos];
+        end = &block[block_end];
+
+        for (; i < count; i++) {
+            while (p < end &&
+                   (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t'))
+                p++;
+
+            if (end - p < 16)
+                break;
+
+            negative = (*p == '-');
+
+            if (negative || *p == '+')
+                p++;
+
+            for (n = 0; (unsigned)(*p - '0') < 10; p++)
+                n = 10 * n + (*p - '0');
+
+            while (p < end && *p != ' ' && *p != '\n' && *p != '\r' &&
+                   *p != '\t')
+                p++;
+
+            values[i] = negative ? -n : n;
         }
-    }
 
-    // Is room available to load it?
-    for (int i = 0; i < sr.maxpages; i++) {
-        if (em.dem[i].max_north == -90) {
-            indx = i;
-            return &em.dem[i];
+        block_pos = p - &block[0];
+
+        if (i < count) {
+            if (!GetInt(values[i]))
+                break;
+
+            i++;
         }
     }
 
-    // There wasn't a free page
-    return NULL;
+    return i;
 }
 
-char *Sdf::GetString() { return fgets(line, sizeof(line) - 1, fd); }
+int Sdf::ReadBlock(char *buffer, int bytes) {
+    return (int)fread(buffer, 1, bytes, fd);
+}
 
 bool Sdf::OpenFile(string path) {
     fd = fopen(path.c_str(), "rb");
@@ -14,36 +14,62 @@
 #include "elevation_map.h"
 #include "splat_run.h"
 #include "dem.h"
+#include "tile_catalog.h"
 
 #include <string>
+#include <vector>
+
+#define SDFBUFFER 262144
 
 class Sdf {
   private:
     std::string sdf_path;
-    const SplatRun &sr;
-    char line[20];
+    const TileCatalog *catalog;
+
+    /* Text read from the open file but not parsed yet: block[block_pos]
+       to block[block_end], followed by a 0. See GetInt(). */
+    std::vector<char> block;
+    std::vector<int> row; /* one row of heights, see GetInts() */
+    size_t block_pos;
+    size_t block_end;
+    bool block_eof;
 
   protected:
+    const SplatRun &sr;
     std::string suffix;
     FILE *fd;
 
   public:
-    Sdf(const std::string &path, const SplatRun &sr)
-        : sdf_path(path), sr(sr), suffix(".sdf") {}
+    /* FindSDF() looks for files in the catalog, which must outlive this */
+    Sdf(const std::string &path, const SplatRun &sr,
+        const TileCatalog *catalog = NULL)
+        : sdf_path(path), catalog(catalog), block_pos(0), block_end(0),
+          block_eof(false), sr(sr), suffix(".sdf") {}
 
-    int LoadSDF(ElevationMap &em, const std::string &name, int minlat,
-                int maxlat, int minlon, int maxlon);
-    char LoadSDF(ElevationMap &em, int minlat, int maxlat, int minlon,
-                 int maxlon);
+    void FindSDF(Dem &dem, int indx);
+    int LoadSDF(Dem &dem, const std::string &path_plus_name);
+    char LoadSDF(Dem &dem, int indx);
+    int MapSDF(Dem &dem, const std::string &path_plus_name);
 
   protected:
     virtual bool OpenFile(std::string path);
     virtual void CloseFile();
-    virtual char *GetString();
+    virtual int ReadBlock(char *buffer, int bytes);
+
+    void AllocateData(Dem &dem);
 
   private:
-    Dem *FindEmptyDem(ElevationMap &em, int minlat, int maxlat, int minlon,
-                      int maxlon, int &indx);
+    bool FillBlock();
+    bool GetInt(int &value);
+    int GetInts(int values[], int count);
+    bool ParseBinarySDF(const Dem &dem, const unsigned char *header,
+                        size_t bytes, const std::string &path_plus_name,
+                        int &min_el, int &max_el, bool &blocked);
+    bool CheckBinarySDF(const Dem &dem, FILE *file,
+                        const std::string &path_plus_name);
+    std::string CachePath(const Dem &dem) const;
+    bool WriteCache(const Dem &dem, const std::string &path) const;
+    static bool LittleEndian();
 };
 
 #endif /* sdf_h */
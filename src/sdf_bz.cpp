@@ -26,69 +26,21 @@
 
 using namespace std;
 
-#define BZBUFFER 65536
-
 SdfBz::SdfBz(const std::string &path, const SplatRun &sr) : Sdf(path, sr) {
     suffix = ".sdf.bz2";
 }
 
-char *SdfBz::BZfgets(BZFILE *bzfd, unsigned length) {
-    /* This function returns at most one less than 'length' number
-     of characters from a bz2 compressed file whose file descriptor
-     is pointed to by *bzfd.  In operation, a buffer is filled with
-     uncompressed data (size = BZBUFFER), which is then parsed
-     and doled out as NULL terminated character strings every time
-     this function is invoked.  A NULL string indicates an EOF
-     or error condition. */
-
-    static int x, y, nBuf;
-    static char buffer[BZBUFFER + 1], output[BZBUFFER + 1];
-    bool done = false, opened = false;
-
-    if (opened != 1 && bzerror == BZ_OK) {
-        /* First time through.  Initialize everything! */
-
-        x = 0;
-        y = 0;
-        nBuf = 0;
-        opened = 1;
-        output[0] = 0;
-    }
-
-    do {
-        if (x == nBuf && bzerror != BZ_STREAM_END && bzerror == BZ_OK &&
-            opened) {
-            /* Uncompress data into a static buffer */
+int SdfBz::ReadBlock(char *buffer, int bytes) {
+    int read;
 
-            nBuf = BZ2_bzRead(&bzerror, bzfd, buffer, BZBUFFER);
-            buffer[nBuf] = 0;
-            x = 0;
-        }
+    if (bzerror != BZ_OK)
+        return 0;
 
-        /* Build a string from buffer contents */
+    read = BZ2_bzRead(&bzerror, bzfd, buffer, bytes);
 
-        output[y] = buffer[x];
-
-        if (output[y] == '\n' || output[y] == 0 || y == (int)length - 1) {
-            output[y + 1] = 0;
-            done = 1;
-            y = 0;
-        }
-
-        else
-            y++;
-        x++;
-
-    } while (done == 0);
-
-    if (output[0] == 0)
-        opened = 0;
-
-    return (output);
+    return read > 0 ? read : 0;
 }
 
-char *SdfBz::GetString() { return BZfgets(bzfd, 255); }
-
 bool SdfBz::OpenFile(string path) {
     if (!Sdf::OpenFile(path)) {
         return false;
@@ -28,10 +28,7 @@ class SdfBz : public Sdf {
   protected:
     virtual bool OpenFile(std::string path);
     virtual void CloseFile();
-    virtual char *GetString();
-
-  private:
-    char *BZfgets(BZFILE *bzfd, unsigned length);
+    virtual int ReadBlock(char *buffer, int bytes);
 };
 
 #endif /* sdf_bz_hpp */
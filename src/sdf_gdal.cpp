@@ -0,0 +1,151 @@
+/** @file sdf_gdal.cpp
+ *
+ * Splat!
+ * @copyright 1997 - 2018 John A. Magliacane (KD2BD) and contributors.
+ * See revision control history for contributions.
+ * This file is covered by the LICENSE.md file in the root of this project.
+ */
+
+#include "sdf_gdal.h"
+#include "dem.h"
+#include "sdf.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#ifdef HAVE_LIBGDAL
+#include <gdal.h>
+#endif
+
+using namespace std;
+
+SdfGdal::SdfGdal(const std::string &path, const SplatRun &sr)
+    : Sdf(path, sr) {}
+
+/// This function loads the part of a raster DEM that covers a page into
+/// its terrain, through GDAL. The raster must be north-up, in degrees (see
+/// TileCatalog). Row x of the page is x / ippd degrees north of its
+/// southern edge, and column y is (y + 1) / ippd degrees west of its
+/// eastern edge, as in SDF files. Each is interpolated between the four
+/// nearest raster cells, leaving out any that hold no data. Points with no
+/// data around them, or off the raster, are at sea-level.
+/// @param dem The page into which to load the raster
+/// @param path_plus_name The raster to read
+int SdfGdal::LoadRaster(Dem &dem, const string &path_plus_name) {
+#ifdef HAVE_LIBGDAL
+    GDALDatasetH dataset;
+    GDALRasterBandH band;
+    vector<float> cells;
+    double transform[6], nodata, east, px, py, fx, fy, sum, weight, w;
+    int has_nodata = 0, width, height, x0, x1, y0, y1, nx, ny, x, y, i, j;
+    int ix, iy, elevation, max_el = dem.max_el, min_el = dem.min_el;
+    float value;
+
+    dataset = GDALOpen(path_plus_name.c_str(), GA_ReadOnly);
+
+    if (dataset == NULL)
+        return -1;
+
+    if (GDALGetGeoTransform(dataset, transform) != CE_None ||
+        GDALGetRasterCount(dataset) < 1) {
+        GDALClose(dataset);
+        return -1;
+    }
+
+    band = GDALGetRasterBand(dataset, 1);
+    nodata = GDALGetRasterNoDataValue(band, &has_nodata);
+    width = GDALGetRasterXSize(dataset);
+    height = GDALGetRasterYSize(dataset);
+
+    /* Longitude of the page's eastern edge, in the raster's range */
+    east = -dem.min_west;
+
+    if (east - 1.0 < -180.0)
+        east += 360.0;
+
+    /* The raster cells around the page, whose centers are at whole pixel
+       coordinates */
+    px = (east - 1.0 - transform[0]) / transform[1] - 0.5;
+    py = (dem.min_north + 1.0 - transform[3]) / transform[5] - 0.5;
+    x0 = max(0, (int)floor(px));
+    y0 = max(0, (int)floor(py));
+
+    px = (east - transform[0]) / transform[1] - 0.5;
+    py = (dem.min_north - transform[3]) / transform[5] - 0.5;
+    x1 = min(width - 1, (int)floor(px) + 1);
+    y1 = min(height - 1, (int)floor(py) + 1);
+
+    if (x0 > x1 || y0 > y1) {
+        GDALClose(dataset);
+        return -1;
+    }
+
+    nx = x1 - x0 + 1;
+    ny = y1 - y0 + 1;
+    cells.resize((size_t)nx * ny);
+
+    if (GDALRasterIO(band, GF_Read, x0, y0, nx, ny, &cells[0], nx, ny,
+                     GDT_Float32, 0, 0) != CE_None) {
+        GDALClose(dataset);
+        return -1;
+    }
+
+    GDALClose(dataset);
+
+    AllocateData(dem);
+
+    for (x = 0; x < sr.ippd; x++) {
+        py = (dem.min_north + (double)x / sr.ippd - transform[3]) /
+                 transform[5] - 0.5;
+
+        for (y = 0; y < sr.ippd; y++) {
+            px = (east - (y + 1.0) / sr.ippd - transform[0]) / transform[1] -
+                 0.5;
+            sum = weight = 0.0;
+
+            if (px >= -0.5 && px <= width - 0.5 && py >= -0.5 &&
+                py <= height - 0.5) {
+                fx = min(max(px, (double)x0), (double)x1) - x0;
+                fy = min(max(py, (double)y0), (double)y1) - y0;
+                ix = min((int)fx, max(nx - 2, 0));
+                iy = min((int)fy, max(ny - 2, 0));
+                fx -= ix;
+                fy -= iy;
+
+                for (i = 0; i < 2; i++) {
+                    for (j = 0; j < 2; j++) {
+                        value = cells[(size_t)min(iy + i, ny - 1) * nx +
+                                      min(ix + j, nx - 1)];
+                        w = (i ? fy : 1.0 - fy) * (j ? fx : 1.0 - fx);
+
+                        if ((has_nodata && value == (float)nodata) ||
+                            std::isnan(value))
+                            continue;
+
+                        sum += w * value;
+                        weight += w;
+                    }
+                }
+            }
+
+            elevation = weight > 0.0 ? (int)floor(sum / weight + 0.5) : 0;
+            dem.data[sr.Cell(x, y)] = elevation;
+
+            if (elevation > max_el)
+                max_el = elevation;
+
+            if (elevation < min_el)
+                min_el = elevation;
+        }
+    }
+
+    dem.max_el = max_el;
+    dem.min_el = min_el;
+
+    return 1;
+#else
+    return -1;
+#endif
+}
@@ -0,0 +1,29 @@
+/** @file sdf_gdal.h
+ *
+ * Splat!
+ * @copyright 1997 - 2018 John A. Magliacane (KD2BD) and contributors.
+ * See revision control history for contributions.
+ * This file is covered by the LICENSE.md file in the root of this project.
+ */
+
+#ifndef sdf_gdal_h
+#define sdf_gdal_h
+
+#include "splat_run.h"
+#include "dem.h"
+#include "sdf.h"
+#include <string>
+
+/**
+ Reads pages from GeoTIFF DEMs (or anything else GDAL can open) in
+ geographic coordinates, resampling them bilinearly to the run's resolution.
+ Only the part of the raster that covers the page is read.
+ */
+class SdfGdal : public Sdf {
+  public:
+    SdfGdal(const std::string &path, const SplatRun &sr);
+
+    int LoadRaster(Dem &dem, const std::string &path_plus_name);
+};
+
+#endif /* sdf_gdal_h */
@@ -0,0 +1,120 @@
+/** @file sdf_hgt.cpp
+ *
+ * Splat!
+ * @copyright 1997 - 2018 John A. Magliacane (KD2BD) and contributors.
+ * See revision control history for contributions.
+ * This file is covered by the LICENSE.md file in the root of this project.
+ */
+
+#include "sdf_hgt.h"
+#include "dem.h"
+#include "sdf.h"
+#include "sysutil.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+
+using namespace std;
+
+static const int HGT_VOID = -32768;
+
+SdfHgt::SdfHgt(const std::string &path, const SplatRun &sr) : Sdf(path, sr) {}
+
+/* The height at row, col of a .hgt file of size x size heights */
+static int HgtHeight(const unsigned char *hgt, int size, int row, int col) {
+    const unsigned char *p = hgt + 2 * ((size_t)row * size + col);
+
+    return (short)(p[0] << 8 | p[1]);
+}
+
+/* The height of a void at row, col, as srtm2sdf's average_terrain() fills
+ * it: the average of the heights around it that aren't voids, rounded, and
+ * no lower than sea-level. A void with none around it is at sea-level.
+ */
+static int AverageTerrain(const unsigned char *hgt, int size, int row,
+                          int col) {
+    long accum = 0;
+    int count = 0, i, j, height, average;
+
+    for (i = max(row - 1, 0); i <= min(row + 1, size - 1); i++) {
+        for (j = max(col - 1, 0); j <= min(col + 1, size - 1); j++) {
+            height = HgtHeight(hgt, size, i, j);
+
+            if ((i != row || j != col) && height != HGT_VOID) {
+                accum += height;
+                count++;
+            }
+        }
+    }
+
+    if (count == 0)
+        return 0;
+
+    average = (int)floor((double)accum / count + 0.5);
+
+    return max(average, 0);
+}
+
+/// This function loads an SRTM .hgt file into the terrain of a page. The
+/// file holds big-endian 16 bit heights from its north west corner, row by
+/// row, with the rows and columns on its northern and eastern edges
+/// repeated by its neighbours. As in srtm2sdf, those edges are left out,
+/// and voids (-32768) are filled in as its average_terrain() does.
+/// @param dem The page into which to load the file
+/// @param path_plus_name The file to read
+int SdfHgt::LoadHGT(Dem &dem, const string &path_plus_name) {
+    int x, y, row, col, size, height;
+    int max_el = dem.max_el, min_el = dem.min_el;
+    const unsigned char *hgt;
+    size_t bytes = 0;
+    void *map = SysUtil::MapFile(path_plus_name.c_str(), bytes);
+
+    if (map == NULL)
+        return -1;
+
+    if (bytes == 2 * 1201 * 1201)
+        size = 1201;
+    else if (bytes == 2 * 3601 * 3601)
+        size = 3601;
+    else {
+        fprintf(stderr, "\n*** WARNING: \"%s\" is not an SRTM-1 or SRTM-3 "
+                        "file.\n",
+                path_plus_name.c_str());
+        SysUtil::UnmapFile(map, bytes);
+        return -1;
+    }
+
+    hgt = (const unsigned char *)map;
+
+    AllocateData(dem);
+
+    /* Row x of the page is x / ippd degrees north of its southern edge, and
+       column y is (y + 1) / ippd degrees west of its eastern edge */
+    for (x = 0; x < sr.ippd; x++) {
+        row = (size - 1) - (int)((long)x * (size - 1) / sr.ippd);
+
+        for (y = 0; y < sr.ippd; y++) {
+            col = (size - 1) - (int)((long)(y + 1) * (size - 1) / sr.ippd);
+            height = HgtHeight(hgt, size, row, col);
+
+            if (height == HGT_VOID)
+                height = AverageTerrain(hgt, size, row, col);
+
+            dem.data[sr.Cell(x, y)] = height;
+
+            if (height > max_el)
+                max_el = height;
+
+            if (height < min_el)
+                min_el = height;
+        }
+    }
+
+    SysUtil::UnmapFile(map, bytes);
+
+    dem.max_el = max_el;
+    dem.min_el = min_el;
+
+    return 1;
+}
@@ -0,0 +1,29 @@
+/** @file sdf_hgt.h
+ *
+ * Splat!
+ * @copyright 1997 - 2018 John A. Magliacane (KD2BD) and contributors.
+ * See revision control history for contributions.
+ * This file is covered by the LICENSE.md file in the root of this project.
+ */
+
+#ifndef sdf_hgt_h
+#define sdf_hgt_h
+
+#include "splat_run.h"
+#include "dem.h"
+#include "sdf.h"
+#include <string>
+
+/**
+ Reads raw SRTM .hgt files straight into pages, as srtm2sdf would have
+ converted them. The file is mapped rather than read, and resampled if its
+ resolution (SRTM-3, 1201 x 1201, or SRTM-1, 3601 x 3601) isn't the run's.
+ */
+class SdfHgt : public Sdf {
+  public:
+    SdfHgt(const std::string &path, const SplatRun &sr);
+
+    int LoadHGT(Dem &dem, const std::string &path_plus_name);
+};
+
+#endif /* sdf_hgt_h */
@@ -16,9 +16,9 @@
 
 using namespace std;
 
-Site::Site() {}
+Site::Site() : lat(0.0), lon(0.0), alt(0.0), amsl_flag(0) {}
 
-Site::Site(const string &filename) { LoadQTH(filename); }
+Site::Site(const string &filename) : Site() { LoadQTH(filename); }
 
 double Site::Distance(const Site &site2) const {
     /* This function returns the great circle distance
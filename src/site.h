@@ -21,7 +21,7 @@ class Site {
     double lat;
     double lon;
     float alt;
-    unsigned char amsl_flag;
+    unsigned char amsl_flag; /* alt is above mean sea level, not ground */
     std::string name;
     std::string filename;
 
@@ -8,6 +8,7 @@
  * This file is covered by the LICENSE.md file in the root of this project.
  */
 
+#include <algorithm>
 #include <ctype.h>
 #include <math.h>
 #include <stdio.h>
@@ -20,7 +21,9 @@
 #include <boost/optional.hpp>
 
 #include "splat_run.h"
+#include "dem.h"
 #include "itwom3.0.h"
+#include "sysutil.h"
 
 using namespace std;
 
@@ -28,11 +31,16 @@ const std::string SplatRun::splat_name = "SPLAT!";
 const std::string SplatRun::splat_version = "2.0-alpha";
 
 SplatRun::SplatRun() {
-      maxpages = 16;
+      maxpages = 0;
+      maxmem = 0;
+      threads = -1;
       arraysize = -1;
 
       propagation_model = PROP_ITM;
       hd_mode = false;
+      blocked_pages = false;
+      double_profiles = false;
+      fast_dh = false;
       coverage = false;
       LRmap = false;
       terrain_plot = false;
@@ -83,6 +91,8 @@ SplatRun::SplatRun() {
 
       projection = PROJ_EPSG_4326;
       multithread = true;
+      pool = NULL;
+      los_sweep = false;
       verbose = 1;    
       sdf_delimiter = "_";
 
@@ -146,7 +156,20 @@ boost::optional<SplatRun> SplatRun::parse_cli(int argc, const char *argv[]) {
                "       -v N verbosity level. Default is 1. Set to 0 to quiet "
                "everything.\n"
                "      -st use a single CPU thread (classic mode)\n"
+               " -threads N use N worker threads. Default is one per CPU "
+               "thread\n"
+               "   -sweep compute -c LOS coverage in one pass per radial "
+               "(experimental)\n"
                "      -hd Use High Definition mode. Requires 1-deg SDF files.\n"
+               " -blocked store terrain in 16 x 16 point blocks, for faster "
+               "radials\n"
+               "  -double work out path loss on double rather than float "
+               "heights\n"
+               "  -fastdh reuse ITWOM terrain irregularity along -L radials "
+               "(faster, less exact)\n"
+               "-farfield d1[,d2[,d3]] beyond these distances, sample -L "
+               "terrain at 2, 4 and 8\n"
+               "          times the spacing (miles/kilometers)\n"
                "      -sc display smooth rather than quantized contour levels\n"
                "      -db threshold beyond which contours will not be "
                "displayed\n"
@@ -177,10 +200,12 @@ boost::optional<SplatRun> SplatRun::parse_cli(int argc, const char *argv[]) {
                "Longley-Rice\n"
                "  -imperial employ imperial rather than metric units for all "
                "user I/O\n"
-               "-maxpages ["
-            << sr.maxpages
-            << "] Maximum Analysis Region capability: 1, 4, 9, 16, 25, 36, 49, "
-               "64 \n"
+               "-maxpages most pages (square degrees) of terrain the region "
+               "may take. Default is as many as the range needs\n"
+               "  -maxmem memory for terrain pages and the maps drawn on them, "
+               "in MB. Default is half of system memory\n"
+               "-tilecache directory in which to share decoded tiles with "
+               "other runs\n"
                "  -sdelim ["
             << sr.sdf_delimiter
             << "] Lat and lon delimeter in SDF filenames \n"
@@ -417,6 +442,9 @@ boost::optional<SplatRun> SplatRun::parse_cli(int argc, const char *argv[]) {
         if (strcmp(argv[x], "-st") == 0)
             sr.multithread = false;
 
+        if (strcmp(argv[x], "-sweep") == 0)
+            sr.los_sweep = true;
+
         if (strcmp(argv[x], "-itwom") == 0)
             sr.propagation_model = PROP_ITWOM;
 
@@ -562,6 +590,48 @@ boost::optional<SplatRun> SplatRun::parse_cli(int argc, const char *argv[]) {
             }
         }
 
+        if (strcmp(argv[x], "-maxmem") == 0) {
+            z = x + 1;
+
+            if (z <= y && argv[z][0] && argv[z][0] != '-') {
+                unsigned long long megabytes;
+
+                if (sscanf(argv[z], "%llu", &megabytes) != 1) {
+                    cerr << "\n"
+                         << 7 << "*** ERROR: Could not parse maxmem: "
+                         << argv[z] << "\n\n";
+                    exit(-1);
+                }
+
+                sr.maxmem = megabytes << 20;
+            }
+        }
+
+        if (strcmp(argv[x], "-threads") == 0) {
+            z = x + 1;
+
+            if (z <= y && argv[z][0] && argv[z][0] != '-') {
+                if (sscanf(argv[z], "%d", &sr.threads) != 1 ||
+                    sr.threads < 1) {
+                    cerr << "\n"
+                         << 7 << "*** ERROR: Could not parse threads: "
+                         << argv[z] << "\n\n";
+                    exit(-1);
+                }
+
+                /* One worker is no better than none */
+                if (sr.threads == 1)
+                    sr.multithread = false;
+            }
+        }
+
+        if (strcmp(argv[x], "-tilecache") == 0) {
+            z = x + 1;
+
+            if (z <= y && argv[z][0] && argv[z][0] != '-')
+                sr.tile_cache = argv[z];
+        }
+
         if (strcmp(argv[x], "-sdelim") == 0) {
             z = x + 1;
 
@@ -573,6 +643,45 @@ boost::optional<SplatRun> SplatRun::parse_cli(int argc, const char *argv[]) {
         if (strcmp(argv[x], "-hd") == 0) {
             sr.hd_mode = true;
         }
+
+        if (strcmp(argv[x], "-blocked") == 0)
+            sr.blocked_pages = true;
+
+        if (strcmp(argv[x], "-double") == 0)
+            sr.double_profiles = true;
+
+        if (strcmp(argv[x], "-fastdh") == 0)
+            sr.fast_dh = true;
+
+        if (strcmp(argv[x], "-farfield") == 0) {
+            z = x + 1;
+
+            if (z <= y && argv[z][0] && argv[z][0] != '-') {
+                std::string distances = argv[z];
+                size_t start = 0, comma;
+                double distance;
+
+                sr.far_field.clear();
+
+                do {
+                    comma = distances.find(',', start);
+
+                    if (sscanf(distances.substr(start, comma - start).c_str(),
+                               "%lf", &distance) != 1 ||
+                        distance <= 0.0 || sr.far_field.size() == DEM_LEVELS) {
+                        cerr << "\n"
+                             << 7 << "*** ERROR: Could not parse farfield: "
+                             << distances << "\n\n";
+                        exit(-1);
+                    }
+
+                    sr.far_field.push_back(distance);
+                    start = comma + 1;
+                } while (comma != std::string::npos);
+
+                sort(sr.far_field.begin(), sr.far_field.end());
+            }
+        }
     } /* end of command line argument scanning */
 
 
@@ -618,59 +727,37 @@ boost::optional<SplatRun> SplatRun::parse_cli(int argc, const char *argv[]) {
 		sr.bottom_legend = true;
 	}
 
-    switch (sr.maxpages) {
-    case 1:
-        if (!sr.hd_mode) {
-            fprintf(
-                stderr,
-                "\n%c*** ERROR: -maxpages must be >= 4 if not in HD mode!\n\n",
-                7);
-            exit(-1);
-        }
-        sr.arraysize = 5092;
-        break;
-    case 4:
-        sr.arraysize = sr.hd_mode ? 14844 : 4950;
-        break;
-
-    case 9:
-        sr.arraysize = sr.hd_mode ? 32600 : 10870;
-        break;
-
-    case 16:
-        sr.arraysize = sr.hd_mode ? 57713 : 19240;
-        break;
-
-    case 25:
-        sr.arraysize = sr.hd_mode ? 90072 : 30025;
-        break;
-
-    case 36:
-        sr.arraysize = sr.hd_mode ? 129650 : 43217;
-        break;
-
-    case 49:
-        sr.arraysize = sr.hd_mode ? 176437 : 58813;
-        break;
-
-    case 64:
-        sr.arraysize = sr.hd_mode ? 230430 : 76810;
-        break;
-    default:
-        fprintf(stderr,
-                "\n%c*** ERROR: -maxpages must be one of 1, 4, 9, 16, 25, 36, "
-                "49, 64\n\n",
-                7);
+    if (sr.maxpages < 0) {
+        fprintf(stderr, "\n%c*** ERROR: -maxpages cannot be negative\n\n", 7);
         exit(-1);
     }
 
     sr.ippd = sr.hd_mode ? 3600 : 1200; /* pixels per degree (integer) */
 
-    int degrees = (int)sqrt((int)sr.maxpages);
+    /* The region takes as many pages as the range asks for. -maxpages
+       bounds it at about sqrt(maxpages) degrees on a side, centred on each
+       transmitter's page, as the fixed sizes it used to pick did. */
+    if (sr.maxpages > 0)
+        sr.deg_limit = max(0.125, (sqrt((double)sr.maxpages) - 1.0) / 2.0);
+    else
+        sr.deg_limit = 90.0;
 
     cout << "This invocation of " << SplatRun::splat_name
-         << " supports analysis over a region of " << degrees << " square \n" << ((degrees == 1) ? "degree" : "degrees")
-		 << " of terrain, and computes signal levels using ITWOM Version " << ITWOMVersion() << ".\n\n";
+         << " supports analysis over a region of ";
+
+    if (sr.maxpages > 0)
+        cout << "up to " << sr.maxpages << " square "
+             << ((sr.maxpages == 1) ? "degree" : "degrees");
+    else
+        cout << "any size";
+
+    cout << " of terrain,\nand computes signal levels using ITWOM Version "
+         << ITWOMVersion() << ".\n\n";
+
+    /* Pages are read as they are needed, and evicted again when more than
+       this much memory would be in use. */
+    if (sr.maxmem == 0)
+        sr.maxmem = SysUtil::GetTotalSystemMemory() / 2;
 
     sr.ppd = (double)sr.ippd; /* pixels per degree (double)  */
     sr.dpp = 1.0 / sr.ppd;    /* degrees per pixel */
@@ -685,6 +772,9 @@ boost::optional<SplatRun> SplatRun::parse_cli(int argc, const char *argv[]) {
         sr.max_range /= KM_PER_MILE;      /* kilometers --> miles */
         sr.altitude /= METERS_PER_FOOT;   /* meters --> feet */
         sr.clutter /= METERS_PER_FOOT;    /* meters --> feet */
+
+        for (size_t i = 0; i < sr.far_field.size(); i++)
+            sr.far_field[i] /= KM_PER_MILE; /* kilometers --> miles */
     }
 
     /* If no SDF path was specified on the command line (-d), check
@@ -712,5 +802,9 @@ boost::optional<SplatRun> SplatRun::parse_cli(int argc, const char *argv[]) {
         sr.sdf_path += '/';
     }
 
+    if (!sr.tile_cache.empty() && (*sr.tile_cache.rbegin() != '/')) {
+        sr.tile_cache += '/';
+    }
+
     return sr;
 }
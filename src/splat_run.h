@@ -13,6 +13,7 @@
 
 #include <string>
 #include <iostream>
+#include <vector>
 #include <boost/optional.hpp>
 
 #include "imagewriter.h"
@@ -29,6 +30,8 @@ const size_t SPLAT_NAME_SIZE = 10;
 const size_t DASHES_SIZE = 80;
 const size_t SDF_PATH_SIZE = 255;
 
+class WorkPool;
+
 typedef enum PropagationModel {
     PROP_ITM = 0,
     PROP_ITWOM
@@ -42,6 +45,7 @@ class SplatRun {
     PropagationModel propagation_model;
 
     std::string sdf_path;
+    std::string tile_cache; /* directory of decoded tiles shared by runs */
 
     double max_range;
     double forced_erp;
@@ -63,10 +67,16 @@ class SplatRun {
     double deg_range_lon;
     double er_mult;
 
+    /* Distances (miles) beyond which path loss maps sample the terrain at
+       2, 4 and 8 times the spacing (-farfield) */
+    std::vector<double> far_field;
+
 
     int ippd;
     int maxpages;
     int mpi;
+    unsigned long long maxmem; /* bytes of pages and map layers in memory */
+    int threads; /* workers in the pool, or -1 for one per CPU thread */
     int max_txsites;
     int arraysize;
 
@@ -78,6 +88,9 @@ class SplatRun {
     bool nolospath;
     bool nositereports;
     bool hd_mode;
+    bool blocked_pages; /* page layers in 16 x 16 point blocks (-blocked) */
+    bool double_profiles; /* path loss on double heights (-double) */
+    bool fast_dh; /* reuse ITWOM delta h between path lengths (-fastdh) */
 
     bool coverage;
     bool LRmap;
@@ -99,6 +112,12 @@ class SplatRun {
     bool bottom_legend;
     bool verbose;
     bool multithread;
+
+    /* The workers every phase of the run hands its work to, set up by main()
+       once the options are parsed. It runs the work on the calling thread
+       when the run is single threaded. */
+    WorkPool *pool;
+    bool los_sweep;
     std::string sdf_delimiter;
     ImageType imagetype;
     ProjectionType projection;
@@ -123,6 +142,19 @@ class SplatRun {
 
     SplatRun();
 
+    /* Offset of point x, y in a page's terrain, mask and signal: row after
+       row of ippd points or, with -blocked, blocks of 16 x 16 points one
+       after another, so that a radial at any angle stays within a few cache
+       lines and memory pages for 16 points at a time */
+    size_t Cell(int x, int y) const {
+        return blocked_pages ? BlockedCell(x, y) : (size_t)x * ippd + y;
+    }
+
+    size_t BlockedCell(int x, int y) const {
+        return ((size_t)(x >> 4) * (ippd >> 4) + (y >> 4)) << 8 |
+               (x & 15) << 4 | (y & 15);
+    }
+
     static boost::optional<SplatRun> parse_cli(int argc, const char *argv[]);
 };
 
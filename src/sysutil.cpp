@@ -1,5 +1,6 @@
 #include "sysutil.h"
 
+#include <cctype>
 #include <cerrno>
 #include <cstddef>
 #include <cstdio> // for snprintf
@@ -11,14 +12,97 @@
 #endif
 
 #ifndef _WIN32
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 unsigned long long SysUtil::GetTotalSystemMemory() {
     unsigned long pages = sysconf(_SC_PHYS_PAGES);
     unsigned long page_size = sysconf(_SC_PAGE_SIZE);
-    return pages * page_size;
+    return (unsigned long long)pages * page_size;
+}
+
+void *SysUtil::MapMemory(size_t bytes) {
+    void *addr = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return addr == MAP_FAILED ? NULL : addr;
+}
+
+/* Only the system pages wholly inside the range are discarded */
+void SysUtil::DiscardMemory(void *addr, size_t bytes) {
+    size_t page = sysconf(_SC_PAGE_SIZE);
+    size_t start = ((size_t)addr + page - 1) & ~(page - 1);
+    size_t end = ((size_t)addr + bytes) & ~(page - 1);
+
+    if (end > start)
+        madvise((void *)start, end - start, MADV_DONTNEED);
+}
+
+void SysUtil::UnmapMemory(void *addr, size_t bytes) { munmap(addr, bytes); }
+
+void *SysUtil::MapFile(const char *path, size_t &bytes) {
+    struct stat st;
+    void *addr;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+        return NULL;
+
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+
+    bytes = st.st_size;
+    addr = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    return addr == MAP_FAILED ? NULL : addr;
+}
+
+/* A private mapping's pages revert to the file's once discarded */
+void SysUtil::DiscardFile(void *addr, size_t bytes) {
+    DiscardMemory(addr, bytes);
+}
+
+void SysUtil::UnmapFile(void *addr, size_t bytes) { munmap(addr, bytes); }
+
+bool SysUtil::FileStamp(const char *path, unsigned long long &bytes,
+                        long long &mtime) {
+    struct stat st;
+
+    if (stat(path, &st) != 0)
+        return false;
+
+    bytes = st.st_size;
+    mtime = st.st_mtime;
+
+    return true;
+}
+
+unsigned long SysUtil::ProcessId() { return (unsigned long)getpid(); }
+
+bool SysUtil::ListDirectory(const std::string &dir,
+                            std::vector<std::string> &names) {
+    DIR *d = opendir(dir.empty() ? "." : dir.c_str());
+    struct dirent *entry;
+
+    if (d == NULL)
+        return false;
+
+    while ((entry = readdir(d)) != NULL) {
+        if (entry->d_name[0] != '.')
+            names.push_back(entry->d_name);
+    }
+
+    closedir(d);
+
+    return true;
 }
 #else
+#include <sys/stat.h>
 #include <windows.h>
 
 unsigned long long SysUtil::GetTotalSystemMemory() {
@@ -27,8 +111,138 @@ unsigned long long SysUtil::GetTotalSystemMemory() {
     GlobalMemoryStatusEx(&status);
     return status.ullTotalPhys;
 }
+
+void *SysUtil::MapMemory(size_t bytes) {
+    return VirtualAlloc(NULL, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+}
+
+/* Only the system pages wholly inside the range are discarded, as on other
+ * systems. DiscardVirtualMemory() is only there from Windows 8.1; MEM_RESET
+ * does the same for memory from VirtualAlloc() before that. Neither may be
+ * used on a view of a file; see DiscardFile().
+ */
+void SysUtil::DiscardMemory(void *addr, size_t bytes) {
+    typedef DWORD(WINAPI * DiscardFn)(PVOID, SIZE_T);
+    static DiscardFn discard = (DiscardFn)GetProcAddress(
+        GetModuleHandleA("kernel32.dll"), "DiscardVirtualMemory");
+    SYSTEM_INFO info;
+    size_t page, start, end;
+
+    GetSystemInfo(&info);
+    page = info.dwPageSize;
+    start = ((size_t)addr + page - 1) & ~(page - 1);
+    end = ((size_t)addr + bytes) & ~(page - 1);
+
+    if (end <= start)
+        return;
+
+    if (discard == NULL ||
+        discard((PVOID)start, end - start) != ERROR_SUCCESS)
+        VirtualAlloc((void *)start, end - start, MEM_RESET, PAGE_READWRITE);
+}
+
+void SysUtil::UnmapMemory(void *addr, size_t bytes) {
+    VirtualFree(addr, 0, MEM_RELEASE);
+}
+
+void *SysUtil::MapFile(const char *path, size_t &bytes) {
+    LARGE_INTEGER size;
+    HANDLE mapping;
+    void *addr = NULL;
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (file == INVALID_HANDLE_VALUE)
+        return NULL;
+
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+        mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+
+        if (mapping != NULL) {
+            addr = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+            CloseHandle(mapping);
+        }
+
+        bytes = (size_t)size.QuadPart;
+    }
+
+    CloseHandle(file);
+
+    return addr;
+}
+
+/* A view of a file can't be reset or discarded, and unmapping it would
+ * fault readers that are still on the page. But the pages of a copy-on-write
+ * view that were never written are still backed by the file, so taking them
+ * out of the working set is enough for the system to reuse them; they are
+ * read back from the file when next touched. VirtualUnlock() does that for
+ * pages that aren't locked.
+ */
+void SysUtil::DiscardFile(void *addr, size_t bytes) {
+    VirtualUnlock(addr, bytes);
+}
+
+void SysUtil::UnmapFile(void *addr, size_t bytes) { UnmapViewOfFile(addr); }
+
+bool SysUtil::FileStamp(const char *path, unsigned long long &bytes,
+                        long long &mtime) {
+    struct _stat64 st;
+
+    if (_stat64(path, &st) != 0)
+        return false;
+
+    bytes = st.st_size;
+    mtime = st.st_mtime;
+
+    return true;
+}
+
+unsigned long SysUtil::ProcessId() { return GetCurrentProcessId(); }
+
+bool SysUtil::ListDirectory(const std::string &dir,
+                            std::vector<std::string> &names) {
+    WIN32_FIND_DATAA found;
+    std::string pattern = (dir.empty() ? std::string(".\\") : dir) + "*";
+    HANDLE find = FindFirstFileA(pattern.c_str(), &found);
+
+    if (find == INVALID_HANDLE_VALUE)
+        return false;
+
+    do {
+        if (found.cFileName[0] != '.' &&
+            !(found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+            names.push_back(found.cFileName);
+    } while (FindNextFileA(find, &found));
+
+    FindClose(find);
+
+    return true;
+}
 #endif
 
+#ifndef min
+#define min(i, j) (i < j ? i : j)
+#endif
+#ifndef max
+#define max(i, j) (i > j ? i : j)
+#endif
+
+/* Whether name ends in suffix, ignoring case */
+bool SysUtil::HasSuffix(const std::string &name, const char *suffix) {
+    size_t length = strlen(suffix);
+
+    if (name.size() < length)
+        return false;
+
+    for (size_t i = 0; i < length; i++) {
+        if (tolower((unsigned char)name[name.size() - length + i]) !=
+            tolower((unsigned char)suffix[i]))
+            return false;
+    }
+
+    return true;
+}
+
 char *SysUtil::Basename(char *path) {
     if (!path)
         return (char *)""; /* const string */
@@ -11,13 +11,8 @@
 #pragma once
 
 #include <cstddef>
-
-#ifndef min
-#define min(i, j) (i < j ? i : j)
-#endif
-#ifndef max
-#define max(i, j) (i > j ? i : j)
-#endif
+#include <string>
+#include <vector>
 
 #ifdef _WIN32
 #define PATHSEP '\\'
@@ -30,7 +25,39 @@ class SysUtil {
     /* memory utilities */
     static unsigned long long GetTotalSystemMemory();
 
+    /* Zeroed memory straight from the system, or NULL. Physical pages are
+     * only committed as they are touched. DiscardMemory() hands them back
+     * while keeping the range mapped and readable, with undefined contents.
+     */
+    static void *MapMemory(size_t bytes);
+    static void DiscardMemory(void *addr, size_t bytes);
+    static void UnmapMemory(void *addr, size_t bytes);
+
+    /* A private, copy-on-write mapping of a whole file, or NULL. bytes is
+     * set to its size. DiscardFile() hands back the physical pages of a range
+     * of it that was never written, which are read back from the file when
+     * next touched. DiscardMemory() must not be used on a mapped file.
+     */
+    static void *MapFile(const char *path, size_t &bytes);
+    static void DiscardFile(void *addr, size_t bytes);
+    static void UnmapFile(void *addr, size_t bytes);
+
+    /* The size and modification time of a file. Returns false if it
+     * doesn't exist.
+     */
+    static bool FileStamp(const char *path, unsigned long long &bytes,
+                          long long &mtime);
+
+    static unsigned long ProcessId();
+
+    /* Appends the names of the files in a directory ("" for the current
+     * one) to names. Returns false if it can't be read.
+     */
+    static bool ListDirectory(const std::string &dir,
+                              std::vector<std::string> &names);
+
     /* file name and path utilities */
+    static bool HasSuffix(const std::string &name, const char *suffix);
     static char *Basename(char *path);
     static void StripFileExtension(char *path, char *ext, size_t extlen);
     static void ConvertBackslashes(char *path);
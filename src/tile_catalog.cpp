@@ -0,0 +1,215 @@
+/** @file tile_catalog.cpp
+ *
+ * Splat!
+ * @copyright 1997 - 2018 John A. Magliacane (KD2BD) and contributors.
+ * See revision control history for contributions.
+ * This file is covered by the LICENSE.md file in the root of this project.
+ */
+
+#include "tile_catalog.h"
+#include "sysutil.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#ifdef HAVE_LIBGDAL
+#include <gdal.h>
+#include <ogr_srs_api.h>
+#endif
+
+using namespace std;
+
+TileCatalog::TileCatalog(const SplatRun &sr) : sr(sr) {}
+
+void TileCatalog::Scan() {
+    vector<string> names;
+    size_t i;
+
+    tiles.clear();
+    rasters.clear();
+
+    if (SysUtil::ListDirectory("", names)) {
+        for (i = 0; i < names.size(); i++)
+            AddFile("", names[i]);
+    }
+
+    names.clear();
+
+    if (!sr.sdf_path.empty() && SysUtil::ListDirectory(sr.sdf_path, names)) {
+        for (i = 0; i < names.size(); i++)
+            AddFile(sr.sdf_path, names[i]);
+    }
+
+    /* Stable, so that the current working directory stays first */
+    stable_sort(tiles.begin(), tiles.end(),
+                [](const Tile &a, const Tile &b) { return a.format < b.format; });
+}
+
+vector<const TileCatalog::Tile *> TileCatalog::Find(int min_north,
+                                                    int min_west) const {
+    vector<const Tile *> found;
+    double south = min_north, north = min_north + 1;
+    double west = -(min_west + 1), east = -min_west;
+    size_t i;
+
+    for (i = 0; i < tiles.size(); i++) {
+        if (tiles[i].min_north == min_north && tiles[i].min_west == min_west)
+            found.push_back(&tiles[i]);
+    }
+
+    if (west < -180.0) {
+        west += 360.0;
+        east += 360.0;
+    }
+
+    for (i = 0; i < rasters.size(); i++) {
+        const Tile &raster = rasters[i];
+
+        if (raster.west <= west && raster.east >= east &&
+            raster.south <= south && raster.north >= north)
+            found.push_back(&raster);
+    }
+
+    return found;
+}
+
+void TileCatalog::AddFile(const string &dir, const string &name) {
+    Tile tile;
+    size_t suffix = 0;
+
+    tile.path = dir + name;
+    tile.min_north = 0;
+    tile.min_west = 0;
+    tile.north = tile.south = tile.east = tile.west = 0.0;
+
+    if (SysUtil::HasSuffix(name, ".bsdf")) {
+        tile.format = BSDF;
+        suffix = 5;
+    } else if (SysUtil::HasSuffix(name, ".sdf")) {
+        tile.format = SDF;
+        suffix = 4;
+    } else if (SysUtil::HasSuffix(name, ".sdf.bz2")) {
+        tile.format = SDF_BZ2;
+        suffix = 8;
+    } else if (SysUtil::HasSuffix(name, ".hgt")) {
+        tile.format = HGT;
+    } else if (SysUtil::HasSuffix(name, ".tif") ||
+               SysUtil::HasSuffix(name, ".tiff")) {
+        tile.format = GDAL;
+        AddRaster(tile);
+        return;
+    } else {
+        return;
+    }
+
+    if (tile.format == HGT ? ParseHGTName(name, tile)
+                           : ParseSDFName(name.substr(0, name.size() - suffix),
+                                          tile))
+        tiles.push_back(tile);
+}
+
+/* min_north, max_north, min_west and max_west, separated by
+ * sr.sdf_delimiter, and followed by "-hd" in HD mode
+ */
+bool TileCatalog::ParseSDFName(const string &name, Tile &tile) const {
+    const string &d = sr.sdf_delimiter;
+    string stem = name, format = "%d" + d + "%d" + d + "%d" + d + "%d%n";
+    int max_north, max_west, used = 0;
+    bool hd = SysUtil::HasSuffix(stem, "-hd");
+
+    if (hd != sr.hd_mode)
+        return false;
+
+    if (hd)
+        stem.resize(stem.size() - 3);
+
+    if (sscanf(stem.c_str(), format.c_str(), &tile.min_north, &max_north,
+               &tile.min_west, &max_west, &used) != 4 ||
+        used != (int)stem.size())
+        return false;
+
+    return max_north == tile.min_north + 1;
+}
+
+/* The SRTM name of the tile's south west corner, e.g. N40W074.hgt, as
+ * srtm2sdf reads it
+ */
+bool TileCatalog::ParseHGTName(const string &name, Tile &tile) const {
+    int north, west;
+
+    if (name.size() < 7 ||
+        (toupper(name[0]) != 'N' && toupper(name[0]) != 'S') ||
+        (toupper(name[3]) != 'W' && toupper(name[3]) != 'E') ||
+        !isdigit(name[1]) || !isdigit(name[2]) || !isdigit(name[4]) ||
+        !isdigit(name[5]) || !isdigit(name[6]))
+        return false;
+
+    north = atoi(name.substr(1, 2).c_str());
+    west = atoi(name.substr(4, 3).c_str());
+
+    tile.min_north = toupper(name[0]) == 'N' ? north : -north;
+
+    if (toupper(name[3]) == 'E')
+        west = 360 - west;
+
+    tile.min_west = west - 1;
+
+    return true;
+}
+
+/* Adds a GeoTIFF, if it is a north-up raster of heights in geographic
+ * coordinates. Images, such as the maps splat writes with a Byte band for
+ * each colour, are passed over: a DEM has one band, of wider values.
+ */
+void TileCatalog::AddRaster(Tile &tile) {
+#ifdef HAVE_LIBGDAL
+    GDALDatasetH dataset;
+    OGRSpatialReferenceH srs;
+    const char *wkt;
+    double transform[6];
+    bool geographic = false;
+
+    GDALAllRegister();
+    dataset = GDALOpen(tile.path.c_str(), GA_ReadOnly);
+
+    if (dataset == NULL)
+        return;
+
+    if (GDALGetRasterCount(dataset) != 1 ||
+        GDALGetRasterDataType(GDALGetRasterBand(dataset, 1)) == GDT_Byte) {
+        GDALClose(dataset);
+        return;
+    }
+
+    wkt = GDALGetProjectionRef(dataset);
+
+    if (wkt != NULL && wkt[0] != 0) {
+        srs = OSRNewSpatialReference(wkt);
+
+        if (srs != NULL) {
+            geographic = OSRIsGeographic(srs);
+            OSRDestroySpatialReference(srs);
+        }
+    }
+
+    if (geographic && GDALGetGeoTransform(dataset, transform) == CE_None &&
+        transform[1] > 0.0 && transform[2] == 0.0 && transform[4] == 0.0 &&
+        transform[5] < 0.0) {
+        tile.west = transform[0];
+        tile.north = transform[3];
+        tile.east = transform[0] + transform[1] * GDALGetRasterXSize(dataset);
+        tile.south = transform[3] + transform[5] * GDALGetRasterYSize(dataset);
+        rasters.push_back(tile);
+    } else {
+        fprintf(stderr,
+                "\n*** WARNING: \"%s\" is not a north-up DEM in geographic "
+                "coordinates. Ignoring it.\n",
+                tile.path.c_str());
+    }
+
+    GDALClose(dataset);
+#endif
+}
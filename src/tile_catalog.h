@@ -0,0 +1,80 @@
+/** @file tile_catalog.h
+ *
+ * Splat!
+ * @copyright 1997 - 2018 John A. Magliacane (KD2BD) and contributors.
+ * See revision control history for contributions.
+ * This file is covered by the LICENSE.md file in the root of this project.
+ */
+
+#ifndef tile_catalog_h
+#define tile_catalog_h
+
+#include "splat_run.h"
+
+#include <string>
+#include <vector>
+
+/**
+ The elevation files in the current working directory and the SDF path,
+ scanned once so that finding the file for a page doesn't probe the file
+ system for every name and format.
+
+ SPLAT Data Files (binary, plain or bzip2 compressed) and SRTM .hgt files
+ each cover one degree square, given by their names. GeoTIFF DEMs, read
+ through GDAL, may cover any area in geographic coordinates; their extents
+ are read when they are scanned. Only single-band rasters of heights wider
+ than a byte are taken for DEMs.
+ */
+class TileCatalog {
+  public:
+    /* Formats, in order of preference */
+    enum Format { BSDF, SDF, SDF_BZ2, HGT, GDAL };
+
+    struct Tile {
+        std::string path;
+        Format format;
+
+        /* Degree square covered, as in SDF names; unused for GDAL */
+        int min_north;
+        int min_west;
+
+        /* Extents of a GDAL raster, in degrees north and east */
+        double north;
+        double south;
+        double east;
+        double west;
+    };
+
+    TileCatalog(const SplatRun &sr);
+
+    /**
+     Lists the current working directory and the SDF path. Files found in
+     the current working directory are preferred over those of the same
+     format in the SDF path.
+     */
+    void Scan();
+
+    /**
+     The files that may hold the degree square with the given limits, best
+     first: those named for it, then GDAL rasters that cover all of it. A
+     page is read from one file, so rasters that cover only some of it are
+     left out.
+     */
+    std::vector<const Tile *> Find(int min_north, int min_west) const;
+
+  private:
+    const SplatRun &sr;
+
+    /* Files named for a degree square, best format first */
+    std::vector<Tile> tiles;
+
+    /* GDAL rasters, in the order found */
+    std::vector<Tile> rasters;
+
+    void AddFile(const std::string &dir, const std::string &name);
+    bool ParseSDFName(const std::string &name, Tile &tile) const;
+    bool ParseHGTName(const std::string &name, Tile &tile) const;
+    void AddRaster(Tile &tile);
+};
+
+#endif /* tile_catalog_h */
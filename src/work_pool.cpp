@@ -0,0 +1,169 @@
+/** @file work_pool.cpp
+ *
+ * Splat!
+ * @copyright 1997 - 2018 John A. Magliacane (KD2BD) and contributors.
+ * See revision control history for contributions.
+ * This file is covered by the LICENSE.md file in the root of this project.
+ */
+
+#include "work_pool.h"
+#include <algorithm>
+
+using namespace std;
+
+WorkPool::WorkPool(int workers)
+    : job(NULL), pending(0), generation(0), exit(false) {
+    int i;
+
+    if (workers < 0)
+        workers = max((int)thread::hardware_concurrency(), 1);
+
+    for (i = 0; i < workers; i++)
+        this->workers.push_back(new Worker);
+
+    /* Started once they all exist, as any of them may steal from the others */
+    for (i = 0; i < workers; i++)
+        this->workers[i]->thread = thread(&WorkPool::Work, this, i);
+}
+
+WorkPool::~WorkPool() {
+    {
+        lock_guard<mutex> lg(run_lock);
+        exit = true;
+    }
+
+    start.notify_all();
+
+    /* All joined before any is deleted, as those still running may be
+       looking to steal from the others */
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i]->thread.join();
+
+    for (size_t i = 0; i < workers.size(); i++)
+        delete workers[i];
+}
+
+int WorkPool::Workers() const {
+    return workers.empty() ? 1 : (int)workers.size();
+}
+
+void WorkPool::Run(const vector<WorkRange> &ranges,
+                   const function<void(const WorkRange &)> &job) {
+    size_t i, j, n = workers.size();
+
+    if (n == 0) {
+        for (i = 0; i < ranges.size(); i++)
+            job(ranges[i]);
+
+        return;
+    }
+
+    if (ranges.empty())
+        return;
+
+    unique_lock<mutex> ul(run_lock);
+
+    this->job = &job;
+    pending = (int)ranges.size();
+
+    for (i = 0; i < n; i++) {
+        lock_guard<mutex> lg(workers[i]->lock);
+
+        for (j = ranges.size() * i / n; j < ranges.size() * (i + 1) / n; j++)
+            workers[i]->ranges.push_back(ranges[j]);
+    }
+
+    generation++;
+    start.notify_all();
+
+    done.wait(ul, [this] { return pending.load() == 0; });
+}
+
+void WorkPool::Split(int edge, int count, int size,
+                     vector<WorkRange> &ranges) {
+    WorkRange range;
+
+    range.edge = edge;
+
+    for (range.first = 0; range.first < count; range.first += size) {
+        range.last = min(range.first + size, count);
+        ranges.push_back(range);
+    }
+}
+
+void WorkPool::Interleave(vector<WorkRange> &ranges, int workers) {
+    vector<WorkRange> dealt;
+    size_t i, j;
+
+    dealt.reserve(ranges.size());
+
+    for (i = 0; i < (size_t)workers; i++)
+        for (j = i; j < ranges.size(); j += workers)
+            dealt.push_back(ranges[j]);
+
+    ranges.swap(dealt);
+}
+
+/* Worker thread main loop: sleeps until Run() hands out work, then does
+ * ranges until there are none left to take or steal.
+ *
+ * A worker that is late to finish taking may see the ranges of the next
+ * Run(); that is harmless, as job is set before they are queued.
+ */
+void WorkPool::Work(int id) {
+    unsigned seen = 0;
+    WorkRange range;
+
+    for (;;) {
+        {
+            unique_lock<mutex> ul(run_lock);
+
+            start.wait(ul, [&] { return exit || generation != seen; });
+
+            if (exit)
+                return;
+
+            seen = generation;
+        }
+
+        while (Take(id, range)) {
+            (*job)(range);
+
+            if (--pending == 0) {
+                lock_guard<mutex> lg(run_lock);
+                done.notify_all();
+            }
+        }
+    }
+}
+
+/* The next range from the front of the worker's own deque, or else one
+ * stolen from the back of another's
+ */
+bool WorkPool::Take(int id, WorkRange &range) {
+    size_t k, n = workers.size();
+
+    {
+        Worker &own = *workers[id];
+        lock_guard<mutex> lg(own.lock);
+
+        if (!own.ranges.empty()) {
+            range = own.ranges.front();
+            own.ranges.pop_front();
+            return true;
+        }
+    }
+
+    for (k = 1; k < n; k++) {
+        Worker &victim = *workers[(id + k) % n];
+        lock_guard<mutex> lg(victim.lock);
+
+        if (!victim.ranges.empty()) {
+            range = victim.ranges.back();
+            victim.ranges.pop_back();
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,102 @@
+/** @file work_pool.h
+ *
+ * Splat!
+ * @copyright 1997 - 2018 John A. Magliacane (KD2BD) and contributors.
+ * See revision control history for contributions.
+ * This file is covered by the LICENSE.md file in the root of this project.
+ */
+
+#ifndef work_pool_h
+#define work_pool_h
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ A run of consecutive work items: radials first to last - 1 along one edge
+ of the map, or pages first to last - 1. It is plain data, so queuing one
+ allocates nothing and copies three ints.
+ */
+struct WorkRange {
+    int edge;
+    int first;
+    int last;
+};
+
+/**
+ A pool of worker threads, each with its own deque of WorkRanges.
+
+ Run() deals the ranges out in contiguous blocks, so that each worker starts
+ on neighbouring radials and the pages they share. A worker takes ranges from
+ the front of its own deque and, once that is empty, steals from the back of
+ the others', which is where the work furthest from their owners' lies.
+ */
+class WorkPool {
+  public:
+    /**
+     Starts the workers. With fewer than 0 workers, there is one for each CPU
+     thread; with 0, Run() does all the work on the calling thread.
+     */
+    explicit WorkPool(int workers = -1);
+
+    ~WorkPool();
+
+    /**
+     The number of worker threads, or 1 when the pool runs single threaded.
+     */
+    int Workers() const;
+
+    /**
+     Calls job on each range, on the workers, and returns when all of the
+     calls have. Only one Run() may be in progress at a time.
+     */
+    void Run(const std::vector<WorkRange> &ranges,
+             const std::function<void(const WorkRange &)> &job);
+
+    /**
+     Splits items 0 to count - 1 of the given edge into ranges of at most
+     size items, and appends them to ranges.
+     */
+    static void Split(int edge, int count, int size,
+                      std::vector<WorkRange> &ranges);
+
+    /**
+     Reorders ranges so that Run() on this many workers deals them out about
+     round robin rather than in blocks, and the workers keep to neighbouring
+     ranges as they go.
+     */
+    static void Interleave(std::vector<WorkRange> &ranges, int workers);
+
+  private:
+    struct Worker {
+        std::mutex lock;
+        std::deque<WorkRange> ranges;
+        std::thread thread;
+    };
+
+    std::vector<Worker *> workers;
+
+    /* The job of the current Run() and the ranges not yet done */
+    const std::function<void(const WorkRange &)> *job;
+    std::atomic<int> pending;
+
+    /* Run() bumps generation to wake the workers; exit stops them */
+    std::mutex run_lock;
+    std::condition_variable start;
+    std::condition_variable done;
+    unsigned generation;
+    bool exit;
+
+    void Work(int id);
+    bool Take(int id, WorkRange &range);
+
+    WorkPool(const WorkPool &) = delete;
+    void operator=(const WorkPool &) = delete;
+};
+
+#endif /* work_pool_h */
@@ -0,0 +1,157 @@
+/** @file itm_radio_bench.cpp
+ *
+ * Splat!
+ * @copyright 1997 - 2018 John A. Magliacane (KD2BD) and contributors.
+ * See revision control history for contributions.
+ * This file is covered by the LICENSE.md file in the root of this project.
+ */
+
+/* Times ItmRadio::Setup() against the two qerfi() calls and the qlrps() call
+   it replaced at the start of every point_to_point() call, on the radio of
+   sample_data/wnju-dt.lrp and the zsys of every path of a 30 mile coverage
+   run from the bench site.
+
+   The paths are every prefix of 360 radials, 1 degree apart, over
+   SynthHeight() terrain at 1200 points per degree, and zsys is their average
+   elevation as point_to_point() works it out. Each way is timed over all of
+   them, best of 5.
+
+   Usage: itm_radio_bench [repeats]
+
+   The source of itwom3.0.cpp is compiled in, for qlrps() and prop_type,
+   which are not exported. */
+
+#include "synth_terrain.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+
+/* after the standard headers, since it defines min() and max() */
+#include "itwom3.0.cpp"
+
+/* sample_data/wnju-dt.lrp */
+#define BENCH_EPS 15.0
+#define BENCH_SGM 0.005
+#define BENCH_ENO 301.0
+#define BENCH_FRQ 605.0
+#define BENCH_CLIMATE 5
+#define BENCH_POL 0
+#define BENCH_CONF 0.5
+#define BENCH_REL 0.9
+
+/* The radio, read afresh for every path as point_to_point() gets it in its
+   arguments, so that the compiler can't hoist the old setup out of the
+   loop */
+static volatile double eps = BENCH_EPS, sgm = BENCH_SGM, eno = BENCH_ENO,
+                       frq = BENCH_FRQ, conf = BENCH_CONF, rel = BENCH_REL;
+static volatile int pol = BENCH_POL;
+
+/* Best of 5 runs of repeats passes over zsys, in ns per path */
+template <class F>
+static double Time(const std::vector<double> &zsys, int repeats, F setup) {
+    double best = 1e30, ns;
+    int run, r;
+    size_t i;
+
+    for (run = 0; run < 5; run++) {
+        std::chrono::steady_clock::time_point start =
+            std::chrono::steady_clock::now();
+
+        for (r = 0; r < repeats; r++)
+            for (i = 0; i < zsys.size(); i++)
+                setup(zsys[i]);
+
+        ns = std::chrono::duration<double, std::nano>(
+                 std::chrono::steady_clock::now() - start)
+                 .count() /
+             ((double)repeats * zsys.size());
+        best = min(best, ns);
+    }
+
+    return best;
+}
+
+int main(int argc, char *argv[]) {
+    const int ppd = 1200, radials = 360;
+    const double miles = 30.0, miles_per_degree = 69.05;
+    int repeats = argc > 1 ? atoi(argv[1]) : 20;
+    int points = (int)(miles * ppd / miles_per_degree);
+    int a, np, i, ja, jb, mismatches = 0;
+    double azimuth, lat, lon, sum, sink = 0.0;
+    std::vector<double> heights(points), zsys;
+    ItmRadio radio(BENCH_EPS, BENCH_SGM, BENCH_ENO, BENCH_FRQ, BENCH_CLIMATE,
+                   BENCH_POL, BENCH_CONF, BENCH_REL);
+
+    if (repeats < 1)
+        repeats = 1;
+
+    for (a = 0; a < radials; a++) {
+        azimuth = a * 2.0 * M_PI / radials;
+
+        for (i = 0; i < points; i++) {
+            lat = BENCH_SITE_LAT + cos(azimuth) * i / ppd;
+            lon = BENCH_SITE_LON -
+                  sin(azimuth) * i / ppd / cos(lat * M_PI / 180.0);
+            heights[i] = SynthHeight(rint(lat * ppd) / ppd,
+                                     rint(lon * ppd) / ppd, ppd);
+        }
+
+        /* zsys of the path to heights[np], as point_to_point() averages
+           it over elev[ja + 1] to elev[jb + 1] */
+        for (np = 1; np < points; np++) {
+            ja = (int)(3.0 + 0.1 * np);
+            jb = np - ja + 6;
+
+            for (sum = 0.0, i = ja - 1; i < jb; i++)
+                sum += heights[i - 2];
+
+            zsys.push_back(sum / (jb - ja + 1));
+        }
+    }
+
+    /* Both ways must set up the same prop */
+    for (i = 0; i < (int)zsys.size(); i++) {
+        prop_type p = {0}, q = {0};
+
+        qlrps(BENCH_FRQ, zsys[i], BENCH_ENO, BENCH_POL, BENCH_EPS, BENCH_SGM,
+              &p);
+        radio.Setup(zsys[i], &q);
+
+        if (p.wn != q.wn || p.zgndreal != q.zgndreal ||
+            p.zgndimag != q.zgndimag || p.ens != q.ens || p.gme != q.gme ||
+            qerfi(BENCH_CONF) != radio.zc || qerfi(BENCH_REL) != radio.zr)
+            mismatches++;
+    }
+
+    printf("%d paths from %d radials of %d points, %d mismatches\n\n",
+           (int)zsys.size(), radials, points, mismatches);
+
+    prop_type prop = {0};
+
+    double old_ns = Time(zsys, repeats, [&](double z) {
+        sink += qerfi(conf) + qerfi(rel);
+        qlrps(frq, z, eno, pol, eps, sgm, &prop);
+        sink += prop.gme;
+    });
+
+    double new_ns = Time(zsys, repeats, [&](double z) {
+        sink += radio.zc + radio.zr;
+        radio.Setup(z, &prop);
+        sink += prop.gme;
+    });
+
+    double surface_ns = Time(zsys, repeats, [&](double z) {
+        qlrps_surface(z, radio.eno_ns_surfref, &prop);
+        sink += prop.gme;
+    });
+
+    printf("per path setup                  ns\n");
+    printf("2 x qerfi() + qlrps()     %8.1f\n", old_ns);
+    printf("ItmRadio::Setup()         %8.1f\n", new_ns);
+    printf("  of which the zsys terms %8.1f\n", surface_ns);
+    printf("saved per path            %8.1f\n", old_ns - new_ns);
+
+    /* keeps the calls from being optimised away */
+    return sink == 12345.678 ? 1 : 0;
+}
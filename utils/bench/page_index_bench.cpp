@@ -0,0 +1,172 @@
+/** @file page_index_bench.cpp
+ *
+ * Splat!
+ * @copyright 1997 - 2018 John A. Magliacane (KD2BD) and contributors.
+ * See revision control history for contributions.
+ * This file is covered by the LICENSE.md file in the root of this project.
+ */
+
+/* Times ElevationMap::FindDEM(), which looks pages up in page_index, against
+   the scan over every page that it replaced, and Path::ReadPath(), on a
+   map of 64 pages: the 8 x 8 degrees around the bench site.
+
+   The paths are radials from the site, 2.4 degrees long (about 165 miles),
+   at evenly spaced azimuths. Each lookup is timed on every point of them,
+   best of 5, as is reading the paths themselves. ReadPath() looks every
+   sample up once, so its time with the scan is estimated from the
+   difference between the lookups.
+
+   The pages are sea-level, so that the benchmark needs no terrain files:
+   how long a lookup takes doesn't depend on the heights.
+
+   Usage: page_index_bench [radials] */
+
+#include "synth_terrain.h"
+
+#include "elevation_map.h"
+#include "path.h"
+#include "sdf.h"
+#include "site.h"
+#include "splat_run.h"
+#include "utilities.h"
+#include "work_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+
+/* FindDEM() as it was, searching every page in turn */
+static const Dem *ScanDEM(const ElevationMap &em, const SplatRun &sr,
+                          double lat, double lon, int &x, int &y) {
+    for (int indx = 0; indx < (int)em.dem.size(); indx++) {
+        x = (int)rint(sr.ppd * (lat - em.dem[indx].min_north));
+        y = sr.mpi - (int)rint(sr.ppd * (Utilities::LonDiff(
+                                            em.dem[indx].max_west, lon)));
+
+        if (x >= 0 && x <= sr.mpi && y >= 0 && y <= sr.mpi)
+            return &em.dem[indx];
+    }
+
+    return NULL;
+}
+
+/* The end of radial r of radials, 2.4 degrees from site */
+static Site Destination(const Site &site, size_t r, int radials) {
+    double azimuth = r * 2.0 * M_PI / radials;
+    Site destination;
+
+    destination.lat = site.lat + 2.4 * cos(azimuth);
+    destination.lon =
+        site.lon + 2.4 * sin(azimuth) / cos(destination.lat * M_PI / 180.0);
+
+    return destination;
+}
+
+/* Best of 5 runs of f(), in seconds */
+template <class F> static double Time(F f) {
+    double best = 1e30, seconds;
+
+    for (int run = 0; run < 5; run++) {
+        std::chrono::steady_clock::time_point start =
+            std::chrono::steady_clock::now();
+
+        f();
+
+        seconds = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+        best = std::min(best, seconds);
+    }
+
+    return best;
+}
+
+int main(int argc, char *argv[]) {
+    int radials = argc > 1 ? atoi(argv[1]) : 360;
+    SplatRun sr;
+    WorkPool pool(0);
+    size_t r, i, samples = 0, mismatches = 0;
+    double sink = 0.0;
+    int x1 = 0, y1 = 0, x2 = 0, y2 = 0;
+    const Dem *scanned, *indexed;
+
+    if (radials < 1)
+        radials = 1;
+
+    /* What parse_cli() and main() set up for the 64 pages loaded below */
+    sr.arraysize = 65 * 1200;
+    sr.ippd = 1200;
+    sr.ppd = sr.ippd;
+    sr.dpp = 1.0 / sr.ppd;
+    sr.mpi = sr.ippd - 1;
+    sr.maxmem = 1ULL << 30;
+    sr.pool = &pool;
+
+    Sdf sdf("", sr);
+    ElevationMap em(sr);
+    Site site;
+
+    site.lat = BENCH_SITE_LAT;
+    site.lon = BENCH_SITE_LON;
+
+    em.LoadTopoData(78, 71, 44, 37, sdf);
+    em.ReadAllPages();
+
+    std::vector<Path> paths(radials, Path(sr.arraysize, sr.ppd));
+
+    for (r = 0; r < paths.size(); r++) {
+        paths[r].ReadPath(site, Destination(site, r, radials), em);
+        samples += paths[r].length;
+
+        /* Both must find the same point of the same page */
+        for (i = 0; i < (size_t)paths[r].length; i++) {
+            scanned = ScanDEM(em, sr, paths[r].lat[i], paths[r].lon[i], x1, y1);
+            indexed = em.FindDEM(paths[r].lat[i], paths[r].lon[i], x2, y2);
+
+            if (scanned != indexed ||
+                (scanned != NULL && (x1 != x2 || y1 != y2)))
+                mismatches++;
+        }
+    }
+
+    double scan_s = Time([&] {
+        int x, y;
+
+        for (size_t r = 0; r < paths.size(); r++)
+            for (int i = 0; i < paths[r].length; i++)
+                if (ScanDEM(em, sr, paths[r].lat[i], paths[r].lon[i], x, y))
+                    sink += x + y;
+    });
+
+    double index_s = Time([&] {
+        int x, y;
+
+        for (size_t r = 0; r < paths.size(); r++)
+            for (int i = 0; i < paths[r].length; i++)
+                if (em.FindDEM(paths[r].lat[i], paths[r].lon[i], x, y))
+                    sink += x + y;
+    });
+
+    double read_s = Time([&] {
+        for (size_t r = 0; r < paths.size(); r++) {
+            paths[r].ReadPath(site, Destination(site, r, radials), em);
+            sink += paths[r].elevation[paths[r].length - 1];
+        }
+    });
+
+    printf("\n%lu samples on %d radials over %d pages, %lu mismatches\n\n",
+           (unsigned long)samples, radials, (int)em.dem.size(),
+           (unsigned long)mismatches);
+    printf("per sample                   ns\n");
+    printf("FindDEM(), scanning     %7.1f\n", 1e9 * scan_s / samples);
+    printf("FindDEM(), page_index   %7.1f\n", 1e9 * index_s / samples);
+    printf("ReadPath()              %7.1f\n", 1e9 * read_s / samples);
+
+    /* ReadPath() looks each sample up once, through GetElevation() */
+    printf("ReadPath(), scanning    %7.1f  (estimated)\n",
+           1e9 * (read_s + scan_s - index_s) / samples);
+
+    /* keeps the calls from being optimised away */
+    return sink == 12345.678 ? 1 : 0;
+}
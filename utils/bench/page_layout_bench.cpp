@@ -0,0 +1,190 @@
+/** @file page_layout_bench.cpp
+ *
+ * Splat!
+ * @copyright 1997 - 2018 John A. Magliacane (KD2BD) and contributors.
+ * See revision control history for contributions.
+ * This file is covered by the LICENSE.md file in the root of this project.
+ */
+
+/* Times radial sweeps through ElevationMap::FindDEM() and Height() with the
+   pages stored row after row and, as -blocked stores them, in 16 x 16 point
+   blocks, at 1200 and 3600 points per degree.
+
+   The map is the 3 x 3 pages around the bench site, filled in memory with
+   SynthHeight() terrain, and the radials start from the middle of the centre
+   page and run 0.95 degrees out, one sample per point, at every azimuth of
+   a set. Every sample is timed, best of 5, and both layouts must read the
+   same heights.
+
+   Usage: page_layout_bench [azimuths...]
+
+   The azimuths default to 360 and 3600. The HD pages take 233 MB per
+   layout. */
+
+#include "synth_terrain.h"
+
+#include "elevation_map.h"
+#include "sdf.h"
+#include "splat_run.h"
+#include "work_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+/* The middle of the centre page */
+#define SWEEP_LAT 40.5
+#define SWEEP_LON 74.5
+#define SWEEP_DEGREES 0.95
+
+/* Best of 5 runs of f(), in seconds */
+template <class F> static double Time(F f) {
+    double best = 1e30, seconds;
+
+    for (int run = 0; run < 5; run++) {
+        std::chrono::steady_clock::time_point start =
+            std::chrono::steady_clock::now();
+
+        f();
+
+        seconds = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+        best = std::min(best, seconds);
+    }
+
+    return best;
+}
+
+/* Fills every page of em with SynthHeight() terrain, in sr's layout */
+static void Fill(ElevationMap &em, const SplatRun &sr) {
+    int x, y;
+
+    for (int indx = 0; indx < (int)em.dem.size(); indx++) {
+        Dem &dem = em.dem[indx];
+
+        /* gives the sea-level page terrain of its own */
+        em.AddElevation(dem.min_north + 0.5, dem.min_west + 0.5, 0.0);
+
+        /* Point x, y is min_north + x / ppd north and
+           min_west + (y + 1) / ppd west; see ElevationMap::FindMask() */
+        for (x = 0; x < sr.ippd; x++)
+            for (y = 0; y < sr.ippd; y++)
+                dem.data[sr.Cell(x, y)] = (short)SynthHeight(
+                    dem.min_north + (double)x / sr.ippd,
+                    dem.min_west + (double)(y + 1) / sr.ippd, sr.ippd);
+    }
+}
+
+/* Every sample of the sweep at the given number of azimuths: the sum of
+   their heights, and their number in samples */
+static double Sweep(const ElevationMap &em, const SplatRun &sr, int azimuths,
+                    size_t &samples) {
+    int steps = (int)(SWEEP_DEGREES * sr.ppd), a, i, x, y;
+    double azimuth, lat, lon, sum = 0.0;
+    const Dem *dem;
+
+    samples = 0;
+
+    for (a = 0; a < azimuths; a++) {
+        azimuth = a * 2.0 * M_PI / azimuths;
+
+        for (i = 0; i < steps; i++) {
+            lat = SWEEP_LAT + cos(azimuth) * i / sr.ppd;
+            lon = SWEEP_LON + sin(azimuth) * i / sr.ppd /
+                                  cos(lat * M_PI / 180.0);
+            dem = em.FindDEM(lat, lon, x, y);
+
+            if (dem != NULL) {
+                sum += em.Height(dem, x, y);
+                samples++;
+            }
+        }
+    }
+
+    return sum;
+}
+
+/* ns per sample of the sweep at each number of azimuths, with the pages in
+   rows or in blocks, and the sums of the heights read */
+static void Run(int ippd, bool blocked, const std::vector<int> &azimuths,
+                std::vector<double> &ns, std::vector<double> &sums) {
+    SplatRun sr;
+    WorkPool pool(0);
+    size_t samples = 0;
+
+    /* What parse_cli() and main() set up for the 9 pages loaded below,
+       with -hd for 3600 */
+    sr.arraysize = 10 * ippd;
+    sr.hd_mode = ippd == 3600;
+    sr.ippd = ippd;
+    sr.ppd = sr.ippd;
+    sr.dpp = 1.0 / sr.ppd;
+    sr.mpi = sr.ippd - 1;
+    sr.maxmem = 1ULL << 32;
+    sr.blocked_pages = blocked;
+    sr.pool = &pool;
+
+    Sdf sdf("", sr);
+    ElevationMap em(sr);
+
+    em.LoadTopoData(75, 73, 41, 39, sdf);
+    em.ReadAllPages();
+    Fill(em, sr);
+
+    ns.clear();
+    sums.clear();
+
+    for (size_t i = 0; i < azimuths.size(); i++) {
+        double sum = 0.0;
+        double seconds =
+            Time([&] { sum = Sweep(em, sr, azimuths[i], samples); });
+
+        ns.push_back(1e9 * seconds / samples);
+        sums.push_back(sum);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    const int ppds[] = {1200, 3600};
+    std::vector<int> azimuths;
+    std::vector<double> rows_ns, rows_sums, blocked_ns, blocked_sums;
+    int mismatches = 0;
+
+    for (int i = 1; i < argc; i++)
+        azimuths.push_back(std::max(1, atoi(argv[i])));
+
+    if (azimuths.empty()) {
+        azimuths.push_back(360);
+        azimuths.push_back(3600);
+    }
+
+    std::vector<std::string> lines;
+
+    for (int p = 0; p < 2; p++) {
+        Run(ppds[p], false, azimuths, rows_ns, rows_sums);
+        Run(ppds[p], true, azimuths, blocked_ns, blocked_sums);
+
+        for (size_t i = 0; i < azimuths.size(); i++) {
+            char line[100];
+
+            if (rows_sums[i] != blocked_sums[i])
+                mismatches++;
+
+            snprintf(line, sizeof(line), "%4d ppd, %5d azimuths  %7.1f  %7.1f",
+                     ppds[p], azimuths[i], rows_ns[i], blocked_ns[i]);
+            lines.push_back(line);
+        }
+    }
+
+    printf("\n3 x 3 pages, %.2f degree radials, %d mismatches\n\n",
+           SWEEP_DEGREES, mismatches);
+    printf("ns per sample               rows  blocked\n");
+
+    for (size_t i = 0; i < lines.size(); i++)
+        printf("%s\n", lines[i].c_str());
+
+    return 0;
+}
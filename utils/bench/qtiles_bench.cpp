@@ -0,0 +1,219 @@
+/** @file qtiles_bench.cpp
+ *
+ * Splat!
+ * @copyright 1997 - 2018 John A. Magliacane (KD2BD) and contributors.
+ * See revision control history for contributions.
+ * This file is covered by the LICENSE.md file in the root of this project.
+ */
+
+/* Times ItmContext::Qtiles() against the two qtile() calls it replaced in
+   d1thx() and d1thx2(), on the detrended profiles that d1thx2() hands it
+   over a 60 mile ITWOM coverage run from the bench site.
+
+   The profiles are those of 36 radials, 10 degrees apart, over
+   SynthHeight() terrain at 1200 points per degree. Each radial is cut at
+   the prefixes for which ItmRadial recomputes delta h under -fastdh, and
+   each prefix is resampled and detrended as D1thx2() does it. The arrays
+   are then split by length, and each class is timed both ways, best of 5,
+   with the copy that qtile() needs (it reorders the array) made in both
+   loops.
+
+   Usage: qtiles_bench [repeats]
+
+   The source of itwom3.0.cpp is compiled in, for qtile() and z1sq2(),
+   which are not exported. */
+
+#include "synth_terrain.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+
+/* after the standard headers, since it defines min() and max() */
+#include "itwom3.0.cpp"
+
+#define METERS_PER_MILE 1609.344
+
+struct Detrended {
+    int ka;
+    int kb;
+    std::vector<float> s; /* n heights */
+};
+
+/* The array D1thx2() hands Qtiles() for pfl from x1 to x2, and its ranks */
+static Detrended Detrend(const float pfl[], double x1, double x2) {
+    Detrended d;
+    int np, n, k, kmx, j;
+    double sn, xa, xb, xc;
+    std::vector<float> s;
+
+    np = (int)pfl[0];
+    xa = x1 / pfl[1];
+    xb = x2 / pfl[1];
+    d.ka = (int)(0.1 * (xb - xa + 8.0));
+    kmx = max(25, (int)(83350 / (pfl[1])));
+    d.ka = min(max(4, d.ka), kmx);
+    n = 10 * d.ka - 5;
+    d.kb = n - d.ka + 1;
+    sn = n - 1;
+
+    s.resize(n + 2);
+    s[0] = sn;
+    s[1] = 1.0;
+    xb = (xb - xa) / sn;
+    k = (int)(trunc(xa + 1.0));
+    xc = xa - ((double)k);
+
+    for (j = 0; j < n; j++) {
+        while (xc > 0.0 && k < np) {
+            xc -= 1.0;
+            ++k;
+        }
+
+        s[j + 2] = pfl[k + 2] + (pfl[k + 2] - pfl[k + 1]) * xc;
+        xc = xc + xb;
+    }
+
+    z1sq2(&s[0], 0.0, sn, &xa, &xb);
+    xb = (xb - xa) / sn;
+
+    for (j = 0; j < n; j++) {
+        s[j + 2] -= xa;
+        xa = xa + xb;
+    }
+
+    d.s.assign(s.begin() + 2, s.end());
+
+    return d;
+}
+
+/* Best of 5 runs of repeats passes over the arrays, in ns per array */
+template <class F>
+static double Time(const std::vector<const Detrended *> &arrays, int repeats,
+                   F quantiles) {
+    double best = 1e30, ns;
+    int run, r;
+    size_t i;
+
+    for (run = 0; run < 5; run++) {
+        std::chrono::steady_clock::time_point start =
+            std::chrono::steady_clock::now();
+
+        for (r = 0; r < repeats; r++)
+            for (i = 0; i < arrays.size(); i++)
+                quantiles(*arrays[i]);
+
+        ns = std::chrono::duration<double, std::nano>(
+                 std::chrono::steady_clock::now() - start)
+                 .count() /
+             ((double)repeats * arrays.size());
+        best = min(best, ns);
+    }
+
+    return best;
+}
+
+int main(int argc, char *argv[]) {
+    const int ppd = 1200, radials = 36;
+    const double miles = 60.0, miles_per_degree = 69.05;
+    const double spacing = METERS_PER_MILE * miles_per_degree / ppd;
+    const double tht_m = BENCH_SITE_ALT_M, rht_m = 10.0;
+    int repeats = argc > 1 ? atoi(argv[1]) : 20;
+    int points = (int)(miles * ppd / miles_per_degree);
+    int a, np, i, mismatches = 0;
+    double azimuth, lat, lon, x1, x2, sink = 0.0;
+    std::vector<float> pfl(points + 2);
+    std::vector<Detrended> captured;
+    ItmContext ctx;
+
+    if (repeats < 1)
+        repeats = 1;
+
+    for (a = 0; a < radials; a++) {
+        azimuth = a * 2.0 * M_PI / radials;
+
+        pfl[1] = (float)spacing;
+
+        for (i = 0; i < points; i++) {
+            lat = BENCH_SITE_LAT + cos(azimuth) * i / ppd;
+            lon = BENCH_SITE_LON -
+                  sin(azimuth) * i / ppd / cos(lat * M_PI / 180.0);
+            pfl[i + 2] = (float)SynthHeight(rint(lat * ppd) / ppd,
+                                            rint(lon * ppd) / ppd, ppd);
+        }
+
+        /* The prefixes -fastdh recomputes delta h on, and their span as
+           point_to_point() sets it for a profile with no horizons */
+        for (np = 2; np < points; np += max(1, np >> DH_REFRESH_SHIFT)) {
+            pfl[0] = (float)np;
+            x1 = min(15.0 * tht_m, 0.1 * np * spacing);
+            x2 = np * spacing - min(15.0 * rht_m, 0.1 * np * spacing);
+
+            if ((x2 - x1) / spacing >= 2.0)
+                captured.push_back(Detrend(&pfl[0], x1, x2));
+        }
+    }
+
+    /* Both ways must agree exactly */
+    std::vector<float> work;
+
+    for (i = 0; i < (int)captured.size(); i++) {
+        const Detrended &d = captured[i];
+        int nn = (int)d.s.size() - 1;
+        double q1, q2, r1, r2;
+
+        work = d.s;
+        r1 = qtile(nn, &work[0], d.ka - 1);
+        r2 = qtile(nn, &work[0], d.kb - 1);
+        ctx.Qtiles(nn, &d.s[0], d.ka - 1, d.kb - 1, q1, q2);
+
+        if (q1 != r1 || q2 != r2)
+            mismatches++;
+    }
+
+    printf("%d arrays from %d radials of %d points, %d mismatches\n\n",
+           (int)captured.size(), radials, points, mismatches);
+    printf("array length       arrays   2 x qtile()   Qtiles()   speedup\n");
+
+    const int bounds[] = {0, 250, 1000, 1 << 30};
+
+    for (int c = 0; c < 3; c++) {
+        std::vector<const Detrended *> arrays;
+
+        for (i = 0; i < (int)captured.size(); i++)
+            if ((int)captured[i].s.size() > bounds[c] &&
+                (int)captured[i].s.size() <= bounds[c + 1])
+                arrays.push_back(&captured[i]);
+
+        if (arrays.empty())
+            continue;
+
+        double old_ns = Time(arrays, repeats, [&](const Detrended &d) {
+            int nn = (int)d.s.size() - 1;
+
+            work = d.s;
+            sink += qtile(nn, &work[0], d.ka - 1);
+            sink += qtile(nn, &work[0], d.kb - 1);
+        });
+
+        double new_ns = Time(arrays, repeats, [&](const Detrended &d) {
+            int nn = (int)d.s.size() - 1;
+            double q1, q2;
+
+            work = d.s;
+            ctx.Qtiles(nn, &work[0], d.ka - 1, d.kb - 1, q1, q2);
+            sink += q1 + q2;
+        });
+
+        if (c < 2)
+            printf("%5d < n <= %-5d", bounds[c], bounds[c + 1]);
+        else
+            printf("%5d < n         ", bounds[c]);
+
+        printf("%7d   %8.0f ns  %6.0f ns   %5.2fx\n", (int)arrays.size(),
+               old_ns, new_ns, old_ns / new_ns);
+    }
+
+    /* keeps the calls from being optimised away */
+    return sink == 12345.678 ? 1 : 0;
+}
@@ -0,0 +1,273 @@
+/** @file sdf_parse_bench.cpp
+ *
+ * Splat!
+ * @copyright 1997 - 2018 John A. Magliacane (KD2BD) and contributors.
+ * See revision control history for contributions.
+ * This file is covered by the LICENSE.md file in the root of this project.
+ */
+
+/* Times Sdf::LoadSDF() and SdfBz::LoadSDF(), which parse SDF text in large
+   blocks through Sdf::GetInt(), against the fgets() and BZfgets() line
+   readers they replaced, on synthetic tiles around the bench site.
+
+   The tiles are written to a directory first: a 1200 point per degree SDF,
+   the same with CRLF line ends, a 3600 point HD one, and bzip2 compressed
+   copies of the 1200 and 3600 point ones. Each is loaded both ways, best
+   of 5, and the heights and the minimum and maximum must come out the same.
+
+   Usage: sdf_parse_bench [dir]
+
+   dir defaults to the current directory. The tiles take about 90 MB. */
+
+#include "synth_terrain.h"
+
+#include "dem.h"
+#include "sdf.h"
+#include "sdf_bz.h"
+#include "splat_run.h"
+
+#include <bzlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+/* The old readers' buffer sizes */
+#define LINE_BYTES 20
+#define BZBUFFER 65536
+
+/* Sdf::GetString(), one fgets() per height */
+class LineReader {
+  private:
+    FILE *fd;
+    char line[LINE_BYTES];
+
+  public:
+    explicit LineReader(FILE *fd) : fd(fd) {}
+
+    char *GetString() { return fgets(line, sizeof(line) - 1, fd); }
+};
+
+/* SdfBz::BZfgets(), which copied the decompressed bytes one at a time */
+class BzLineReader {
+  private:
+    BZFILE *bzfd;
+    int bzerror;
+    int x;
+    int y;
+    int nBuf;
+    std::vector<char> buffer;
+    std::vector<char> output;
+
+  public:
+    explicit BzLineReader(FILE *fd)
+        : x(0), y(0), nBuf(0), buffer(BZBUFFER + 1), output(BZBUFFER + 1) {
+        bzfd = BZ2_bzReadOpen(&bzerror, fd, 0, 0, NULL, 0);
+    }
+
+    ~BzLineReader() { BZ2_bzReadClose(&bzerror, bzfd); }
+
+    char *GetString() {
+        bool done = false;
+
+        do {
+            if (x == nBuf && bzerror == BZ_OK) {
+                nBuf = BZ2_bzRead(&bzerror, bzfd, &buffer[0], BZBUFFER);
+
+                if (nBuf < 0)
+                    nBuf = 0;
+
+                buffer[nBuf] = 0;
+                x = 0;
+            }
+
+            output[y] = buffer[x];
+
+            if (output[y] == '\n' || output[y] == 0 || y == 254) {
+                output[y + 1] = 0;
+                done = true;
+                y = 0;
+            } else
+                y++;
+
+            if (x < nBuf)
+                x++;
+        } while (!done);
+
+        return &output[0];
+    }
+};
+
+/* Sdf::LoadSDF() as it was, into heights */
+template <class Reader>
+static void LoadByLines(const std::string &path, int ippd,
+                        std::vector<short> &heights, int &min_el,
+                        int &max_el) {
+    FILE *fd = fopen(path.c_str(), "rb");
+    int i, data;
+
+    heights.resize((size_t)ippd * ippd);
+    min_el = 32768;
+    max_el = -32768;
+
+    if (fd == NULL)
+        return;
+
+    {
+        Reader reader(fd);
+
+        for (i = 0; i < 4; i++)
+            reader.GetString();
+
+        for (i = 0; i < ippd * ippd; i++) {
+            data = atoi(reader.GetString());
+            heights[i] = data;
+            max_el = std::max(max_el, data);
+            min_el = std::min(min_el, data);
+        }
+    }
+
+    fclose(fd);
+}
+
+/* Compresses a file as bzip2 */
+static bool Compress(const std::string &from, const std::string &to) {
+    FILE *in = fopen(from.c_str(), "rb"), *out = fopen(to.c_str(), "wb");
+    std::vector<char> block(1 << 20);
+    BZFILE *bz;
+    size_t bytes;
+    int bzerror = BZ_IO_ERROR;
+
+    if (in != NULL && out != NULL) {
+        bz = BZ2_bzWriteOpen(&bzerror, out, 9, 0, 0);
+
+        while (bzerror == BZ_OK &&
+               (bytes = fread(&block[0], 1, block.size(), in)) > 0)
+            BZ2_bzWrite(&bzerror, bz, &block[0], (int)bytes);
+
+        BZ2_bzWriteClose(&bzerror, bz, 0, NULL, NULL);
+    }
+
+    if (in != NULL)
+        fclose(in);
+
+    return out != NULL && fclose(out) == 0 && bzerror == BZ_OK;
+}
+
+/* Rewrites a file with CRLF line ends */
+static bool ToCrlf(const std::string &from, const std::string &to) {
+    FILE *in = fopen(from.c_str(), "rb"), *out = fopen(to.c_str(), "wb");
+    int c;
+
+    if (in != NULL && out != NULL)
+        while ((c = getc(in)) != EOF) {
+            if (c == '\n')
+                putc('\r', out);
+
+            putc(c, out);
+        }
+
+    if (in != NULL)
+        fclose(in);
+
+    return out != NULL && fclose(out) == 0 && in != NULL;
+}
+
+/* Best of 5 runs of f(), in milliseconds */
+template <class F> static double Time(F f) {
+    double best = 1e30, ms;
+
+    for (int run = 0; run < 5; run++) {
+        std::chrono::steady_clock::time_point start =
+            std::chrono::steady_clock::now();
+
+        f();
+
+        ms = std::chrono::duration<double, std::milli>(
+                 std::chrono::steady_clock::now() - start)
+                 .count();
+        best = std::min(best, ms);
+    }
+
+    return best;
+}
+
+struct Tile {
+    const char *label;
+    std::string path;
+    int ippd;
+    bool bz2;
+};
+
+int main(int argc, char *argv[]) {
+    std::string dir = argc > 1 ? argv[1] : ".";
+    const int north = 40, west = 74;
+    std::string sdf = dir + "/40_41_74_75.sdf";
+    std::string hd = dir + "/40_41_74_75-hd.sdf";
+    std::vector<Tile> tiles;
+    std::vector<short> heights;
+    int min_el, max_el, mismatches;
+
+    printf("writing tiles to %s\n\n", dir.c_str());
+
+    if (!WriteSynthSdf(dir, north, west, 1200) ||
+        !WriteSynthSdf(dir, north, west, 3600) ||
+        !ToCrlf(sdf, dir + "/crlf.sdf") || !Compress(sdf, sdf + ".bz2") ||
+        !Compress(hd, hd + ".bz2")) {
+        fprintf(stderr, "could not write the tiles to %s\n", dir.c_str());
+        return 1;
+    }
+
+    tiles.push_back({"1200 ppd .sdf", sdf, 1200, false});
+    tiles.push_back({"1200 ppd CRLF .sdf", dir + "/crlf.sdf", 1200, false});
+    tiles.push_back({"3600 ppd .sdf", hd, 3600, false});
+    tiles.push_back({"1200 ppd .sdf.bz2", sdf + ".bz2", 1200, true});
+    tiles.push_back({"3600 ppd .sdf.bz2", hd + ".bz2", 3600, true});
+
+    printf("tile                  lines (ms)   blocks (ms)   speedup  "
+           "mismatches\n");
+
+    for (size_t t = 0; t < tiles.size(); t++) {
+        const Tile &tile = tiles[t];
+        SplatRun sr;
+
+        sr.ippd = tile.ippd;
+        sr.hd_mode = tile.ippd == 3600;
+
+        Dem dem;
+        Sdf plain("", sr);
+        SdfBz bz("", sr);
+        Sdf &parser = tile.bz2 ? bz : plain;
+
+        double old_ms = Time([&] {
+            if (tile.bz2)
+                LoadByLines<BzLineReader>(tile.path, tile.ippd, heights,
+                                          min_el, max_el);
+            else
+                LoadByLines<LineReader>(tile.path, tile.ippd, heights,
+                                        min_el, max_el);
+        });
+
+        double new_ms = Time([&] {
+            dem.min_el = 32768;
+            dem.max_el = -32768;
+            parser.LoadSDF(dem, tile.path);
+        });
+
+        mismatches = 0;
+
+        for (size_t i = 0; i < heights.size(); i++)
+            if (dem.data[i] != heights[i])
+                mismatches++;
+
+        if (dem.min_el != min_el || dem.max_el != max_el)
+            mismatches++;
+
+        printf("%-20s %10.1f   %11.1f   %6.1fx  %10d\n", tile.label, old_ms,
+               new_ms, old_ms / new_ms, mismatches);
+    }
+
+    return 0;
+}
@@ -0,0 +1,82 @@
+/** @file synth_terrain.h
+ *
+ * Splat!
+ * @copyright 1997 - 2018 John A. Magliacane (KD2BD) and contributors.
+ * See revision control history for contributions.
+ * This file is covered by the LICENSE.md file in the root of this project.
+ */
+
+#ifndef synth_terrain_h
+#define synth_terrain_h
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+
+/* The site the benchmarks are run around: sample_data/wnju-dt.qth */
+#define BENCH_SITE_LAT 40.802222
+#define BENCH_SITE_LON 74.246389
+#define BENCH_SITE_ALT_M 98.5
+
+/**
+ The benchmarks' input terrain: ridges at several scales plus up to 14
+ meters of noise, from 0 to about 400 meters. The repo ships no terrain, so
+ the benchmarks take their heights from this, and the ones that go through
+ the loaders have WriteSynthSdf() write it out as SDF tiles first.
+
+ The noise is a hash of the point, so that a height doesn't depend on the
+ order in which points are asked for.
+
+ @param lat Latitude, in degrees north
+ @param lon Longitude, in degrees west
+ @param ppd Points per degree that lat and lon are on (1200 or 3600)
+ */
+inline int SynthHeight(double lat, double lon, int ppd) {
+    unsigned h = (unsigned)lrint(lat * ppd) * 2654435761u ^
+                 (unsigned)lrint(lon * ppd) * 40503u;
+    double z;
+
+    h ^= h >> 15;
+    h *= 2246822519u;
+    h ^= h >> 13;
+
+    z = 150.0 + 120.0 * sin(lat * 37.0) * cos(lon * 29.0) +
+        80.0 * sin(lat * 113.0 + lon * 71.0) +
+        40.0 * cos(lat * 311.0 - lon * 201.0) + h % 15;
+
+    return z < 0.0 ? 0 : (int)z;
+}
+
+/**
+ Writes the SDF tile of the degree square with corner min_north, min_west,
+ named as Sdf::FindSDF() looks for it with the default "_" delimiter.
+ Returns false if it could not be written.
+ */
+inline bool WriteSynthSdf(const std::string &dir, int min_north, int min_west,
+                          int ppd) {
+    std::string name = dir + "/" + std::to_string(min_north) + "_" +
+                       std::to_string(min_north + 1) + "_" +
+                       std::to_string(min_west) + "_" +
+                       std::to_string(min_west + 1) +
+                       (ppd == 3600 ? "-hd" : "") + ".sdf";
+    FILE *fd = fopen(name.c_str(), "w");
+    int x, y;
+
+    if (fd == NULL)
+        return false;
+
+    fprintf(fd, "%d\n%d\n%d\n%d\n", min_west + 1, min_north, min_west,
+            min_north + 1);
+
+    /* Point x, y of a page is min_north + x / ppd north and
+       min_west + (y + 1) / ppd west; see ElevationMap::FindMask(). */
+    for (x = 0; x < ppd; x++)
+        for (y = 0; y < ppd; y++)
+            fprintf(fd, "%d\n",
+                    SynthHeight(min_north + (double)x / ppd,
+                                min_west + (double)(y + 1) / ppd, ppd));
+
+    return fclose(fd) == 0;
+}
+
+#endif /* synth_terrain_h */
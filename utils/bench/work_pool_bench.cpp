@@ -0,0 +1,270 @@
+/** @file work_pool_bench.cpp
+ *
+ * Splat!
+ * @copyright 1997 - 2018 John A. Magliacane (KD2BD) and contributors.
+ * See revision control history for contributions.
+ * This file is covered by the LICENSE.md file in the root of this project.
+ */
+
+/* Times WorkPool, and the maps it runs, at a set of worker counts: the cost
+   of handing out 9600 radials that do no work, and whole -c and -L runs.
+
+   The runs are those of splat -R 30 at the bench site: a line-of-sight map
+   with the receiver at 30 feet, and an ITM path loss map of
+   sample_data/wnju-dt.lrp with the receiver at 30 feet. Their region is the
+   pages main() would load for them, filled in memory with SynthHeight()
+   terrain. Each run is plotted on a map of its own, best of 3, and its mask
+   and signal layers must match those of the run on one worker, which is
+   splat -st.
+
+   Usage: work_pool_bench [workers...]
+
+   The workers default to 1, 4, 8, 16 and 32. One worker is a pool of none,
+   which runs everything on the calling thread, as -threads 1 does. */
+
+#include "synth_terrain.h"
+
+#include "antenna_pattern.h"
+#include "elevation_map.h"
+#include "lrp.h"
+#include "sdf.h"
+#include "site.h"
+#include "splat_run.h"
+#include "utilities.h"
+#include "work_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define BENCH_RANGE 30.0 /* miles */
+#define BENCH_RX_ALT 30.0 /* feet */
+#define BENCH_RADIALS 9600
+
+/* Best of runs of f(), in seconds */
+template <class F> static double Time(int runs, F f) {
+    double best = 1e30, seconds;
+
+    for (int run = 0; run < runs; run++) {
+        std::chrono::steady_clock::time_point start =
+            std::chrono::steady_clock::now();
+
+        f();
+
+        seconds = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+        best = std::min(best, seconds);
+    }
+
+    return best;
+}
+
+/* Fills every page of em with SynthHeight() terrain */
+static void Fill(ElevationMap &em, const SplatRun &sr) {
+    int x, y;
+
+    for (int indx = 0; indx < (int)em.dem.size(); indx++) {
+        Dem &dem = em.dem[indx];
+
+        /* gives the sea-level page terrain of its own */
+        em.AddElevation(dem.min_north + 0.5, dem.min_west + 0.5, 0.0);
+
+        /* Point x, y is min_north + x / ppd north and
+           min_west + (y + 1) / ppd west; see ElevationMap::FindMask() */
+        for (x = 0; x < sr.ippd; x++)
+            for (y = 0; y < sr.ippd; y++)
+                dem.data[sr.Cell(x, y)] = (short)SynthHeight(
+                    dem.min_north + (double)x / sr.ippd,
+                    dem.min_west + (double)(y + 1) / sr.ippd, sr.ippd);
+    }
+}
+
+/* Loads the pages main() would for a run of BENCH_RANGE miles from site */
+static void Load(ElevationMap &em, SplatRun &sr, const Site &site,
+                 Sdf &sdf) {
+    double deg_range = sr.max_range / 57.0;
+    double deg_range_lon = deg_range / cos(DEG2RAD * site.lat);
+    int north = (int)floor(site.lat), west = (int)floor(site.lon);
+
+    em.LoadTopoData(west, west, north, north, sdf);
+    em.LoadTopoData((int)floor(site.lon + deg_range_lon),
+                    (int)floor(site.lon - deg_range_lon),
+                    (int)floor(site.lat + deg_range),
+                    (int)floor(site.lat - deg_range), sdf);
+    em.ReadAllPages();
+    Fill(em, sr);
+
+    /* as size_paths() in main.cpp */
+    sr.arraysize = ((int)em.dem.size() + 1) * sr.ippd;
+}
+
+/* A hash of which points the map reached and their signals. Masks are left
+   out, as each map plotted takes the next mask value. */
+static unsigned long long Hash(const ElevationMap &em, const SplatRun &sr) {
+    unsigned long long hash = 0;
+    int x, y;
+
+    for (int indx = 0; indx < (int)em.dem.size(); indx++)
+        for (x = 0; x < sr.ippd; x++)
+            for (y = 0; y < sr.ippd; y++)
+                hash = hash * 1000003u +
+                       ((em.Mask(&em.dem[indx], x, y) != 0) << 8 |
+                        em.Signal(&em.dem[indx], x, y));
+
+    return hash;
+}
+
+/* The seconds a -c (lr false) or -L run takes on workers, and the hash of
+   its map */
+static double Run(int workers, bool lr, unsigned long long &hash) {
+    SplatRun sr;
+    WorkPool pool(workers > 1 ? workers : 0);
+    Site site;
+    Lrp lrp(-1.0, 0.0);
+    AntennaPattern *pat = new AntennaPattern();
+    double seconds = 1e30;
+
+    /* What parse_cli() and main() set up for -R 30 -threads workers,
+       with path loss for -L */
+    sr.ippd = 1200;
+    sr.ppd = sr.ippd;
+    sr.dpp = 1.0 / sr.ppd;
+    sr.mpi = sr.ippd - 1;
+    sr.maxmem = 1ULL << 32;
+    sr.max_range = BENCH_RANGE;
+    sr.altitude = sr.altitudeLR = BENCH_RX_ALT;
+    sr.propagation_model = PROP_ITM;
+    sr.multithread = workers > 1;
+    sr.verbose = 0;
+    sr.pool = &pool;
+
+    site.name = "WNJU-DT";
+    site.lat = BENCH_SITE_LAT;
+    site.lon = BENCH_SITE_LON;
+    site.alt = BENCH_SITE_ALT_M / METERS_PER_FOOT;
+
+    /* sample_data/wnju-dt.lrp, with no ERP for path loss */
+    lrp.eps_dielect = 15.0;
+    lrp.sgm_conductivity = 0.005;
+    lrp.eno_ns_surfref = 301.0;
+    lrp.frq_mhz = 605.0;
+    lrp.radio_climate = 5;
+    lrp.pol = 0;
+    lrp.conf = 0.5;
+    lrp.rel = 0.9;
+    lrp.erp = 0.0;
+
+    /* as LoadAntennaPattern() leaves it with no .az or .el file */
+    for (int a = 0; a <= 360; a++)
+        std::fill(pat->antenna_pattern[a], pat->antenna_pattern[a] + 1001,
+                  1.0f);
+
+    std::vector<Site> sites(1, site);
+    std::vector<const AntennaPattern *> pats(1, pat);
+    std::vector<Lrp> lrps(1, lrp);
+
+    /* a map for each run, so that each starts from nothing plotted; only
+       the plotting is timed */
+    for (int run = 0; run < 3; run++) {
+        Sdf sdf("", sr);
+        ElevationMap em(sr);
+
+        Load(em, sr, site, sdf);
+
+        double time = Time(1, [&] {
+            if (lr)
+                em.PlotLRMaps(sites, sr.altitudeLR, "", pats, lrps);
+            else
+                em.PlotLOSMap(site, sr.altitude);
+        });
+
+        seconds = std::min(seconds, time);
+        hash = Hash(em, sr);
+    }
+
+    delete pat;
+
+    return seconds;
+}
+
+/* Microseconds per radial that WorkPool::Run() takes to hand out
+   BENCH_RADIALS radials that do no work, in ranges of 64 along 4 edges */
+static double Schedule(int workers) {
+    WorkPool pool(workers > 1 ? workers : 0);
+    std::vector<WorkRange> ranges;
+    std::atomic<int> done(0);
+
+    for (int edge = 0; edge < 4; edge++)
+        WorkPool::Split(edge, BENCH_RADIALS / 4, 64, ranges);
+
+    return 1e6 *
+           Time(5,
+                [&] {
+                    pool.Run(ranges, [&](const WorkRange &range) {
+                        done += range.last - range.first;
+                    });
+                }) /
+           BENCH_RADIALS;
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<int> workers;
+    std::vector<double> schedule, los, lr;
+    unsigned long long los_hash, lr_hash, los_first = 0, lr_first = 0;
+    int mismatches = 0;
+    size_t i;
+
+    for (int a = 1; a < argc; a++)
+        workers.push_back(std::max(1, atoi(argv[a])));
+
+    if (workers.empty()) {
+        const int counts[] = {1, 4, 8, 16, 32};
+
+        workers.assign(counts, counts + 5);
+    }
+
+    for (i = 0; i < workers.size(); i++) {
+        schedule.push_back(Schedule(workers[i]));
+        los.push_back(Run(workers[i], false, los_hash));
+        lr.push_back(Run(workers[i], true, lr_hash));
+
+        if (i == 0) {
+            los_first = los_hash;
+            lr_first = lr_hash;
+        } else if (los_hash != los_first || lr_hash != lr_first) {
+            mismatches++;
+        }
+    }
+
+    printf("\n%d CPU threads, %d mismatches\n\n",
+           (int)std::thread::hardware_concurrency(), mismatches);
+    printf("workers               ");
+
+    for (i = 0; i < workers.size(); i++)
+        printf("%8d", workers[i]);
+
+    printf("\nus per radial, no work");
+
+    for (i = 0; i < workers.size(); i++)
+        printf("%8.3f", schedule[i]);
+
+    printf("\n-c -R 30 (s)          ");
+
+    for (i = 0; i < workers.size(); i++)
+        printf("%8.2f", los[i]);
+
+    printf("\n-L -R 30, ITM (s)     ");
+
+    for (i = 0; i < workers.size(); i++)
+        printf("%8.2f", lr[i]);
+
+    printf("\n");
+
+    return 0;
+}
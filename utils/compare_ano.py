@@ -1,6 +1,6 @@
 #!/usr/bin/env python
 
-# compare_ano.py <file1> <file2>
+# compare_ano.py [-hd] <file1> <file2>
 # 
 # compares two .ano files emitted from splat (via the -ano flag). The
 # contents don't have to be in the same order, but they should be from
@@ -11,7 +11,9 @@
 #  d) the same terrain elevation files
 #
 # This is primarily to test for differences between linear processing,
-# multithreaded-CPU processing, and GPU processing.
+# multithreaded-CPU processing, and GPU processing. It ends with a summary
+# of the loss differences, e.g. to see what -farfield costs against a full
+# resolution run.
 #
 # 
 # Bounds:
@@ -64,8 +66,7 @@ def getElemCoords(lat, lon):
 
 def loadAnoIntoDict(anofilepath, anodict):
     """Read an anofile and load it into a dictionary of dictionaries, indexed by the same 
-       coordinates that dem uses in splat.cpp. Note that this only works for regular Splat.
-       Splat HD requires a different division factor.
+       coordinates that dem uses in splat.cpp. Pass -hd for files from Splat HD.
     """
     with open(anofilepath) as fp:  
         line = fp.readline()
@@ -125,6 +126,7 @@ def compareAnos(anofilepath, anodict):
         needHeader = True
 
         miss = 0
+        deltas = []
 
         while line:
             if ";" not in line:
@@ -144,8 +146,9 @@ def compareAnos(anofilepath, anodict):
                 if (data == None):
                     print("not found")
                 else:
+                    deltas.append(abs(data[6] - loss))
                     if (abs(data[6] - loss) > 0.1):
-                        pct = data[6]/loss
+                        pct = data[6]/loss if loss != 0.0 else float("inf")
                         if (pct > 5):
                             if needHeader:
                                 print(" latitude , longitude  ( demX , demY ): dbloss      latitude , longitude  ( demX , demY ): dbloss  %change")
@@ -160,15 +163,36 @@ def compareAnos(anofilepath, anodict):
 
         print("misses: %d" % (miss))
 
+        if deltas:
+            deltas.sort()
+            print("loss delta over %d points: mean %0.2f dB, median %0.2f dB, "
+                  "95%% %0.2f dB, max %0.2f dB" %
+                  (len(deltas), sum(deltas) / len(deltas),
+                   deltas[len(deltas) // 2], deltas[int(len(deltas) * 0.95)],
+                   deltas[-1]))
+            print("points over 0.5 dB: %d, 1 dB: %d, 3 dB: %d" %
+                  (sum(1 for d in deltas if d > 0.5),
+                   sum(1 for d in deltas if d > 1.0),
+                   sum(1 for d in deltas if d > 3.0)))
+
 
 def main():
-    if len(sys.argv) < 3:
-        print("compare_ano.py <file1> <file2>\n")
+    global ppd, mpi
+
+    args = sys.argv[1:]
+
+    if args and args[0] == "-hd":
+        ppd = 3600
+        mpi = (3600 - 1)
+        args = args[1:]
+
+    if len(args) < 2:
+        print("compare_ano.py [-hd] <file1> <file2>\n")
         return
 
-    print("loading %s" % (sys.argv[1]) )
-    loadAnoIntoDict(sys.argv[1], ano1)
-    compareAnos(sys.argv[2], ano1)
+    print("loading %s" % (args[0]) )
+    loadAnoIntoDict(args[0], ano1)
+    compareAnos(args[1], ano1)
 
 if __name__ == "__main__":
     main()
@@ -0,0 +1,297 @@
+/**************************************************************\
+ **     sdf2bsdf: converts SPLAT! Data Files (.sdf or         **
+ **     .sdf.bz2) into binary SDFs (.bsdf), which SPLAT!     **
+ **     maps into memory and uses as they are, rather than   **
+ **     parsing them.                                        **
+ **************************************************************
+ **                    Compile like this:                    **
+ **      cc -Wall -O3 -s sdf2bsdf.c -lbz2 -o sdf2bsdf         **
+\**************************************************************/
+
+/* A binary SDF is a 64 byte header of little-endian 32 bit integers:
+
+	offset  0: "SPLATSDB" (8 bytes)
+	offset  8: version (1)
+	offset 12: points per degree (1200, or 3600 for HD)
+	offset 16: max_west, min_north, min_west, max_north
+	offset 32: min_el, max_el
+	offset 40: zero up to 64
+
+   followed by points per degree squared little-endian 16 bit heights,
+   in meters, in the same order as the .sdf it came from. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <bzlib.h>
+
+#define BZBUFFER 65536
+
+FILE	*fd;
+BZFILE	*bzfd;
+int	bzerror, bz, nbuf, pos;
+char	buffer[BZBUFFER];
+short	heights[3600*3600];
+
+/* Whether name ends in suffix */
+
+int EndsWith(char *name, char *suffix)
+{
+	size_t length=strlen(name), slength=strlen(suffix);
+
+	return (length>=slength && strcmp(name+length-slength,suffix)==0);
+}
+
+int OpenSDF(char *filename)
+{
+	fd=fopen(filename,"rb");
+
+	if (fd==NULL)
+	{
+		fprintf(stderr, "*** Error: Cannot open \"%s\"\n", filename);
+		return -1;
+	}
+
+	bz=EndsWith(filename, ".bz2");
+	nbuf=0;
+	pos=0;
+
+	if (bz)
+	{
+		bzfd=BZ2_bzReadOpen(&bzerror,fd,0,0,NULL,0);
+
+		if (bzerror!=BZ_OK)
+		{
+			fprintf(stderr, "*** Error: \"%s\" is not a bzip2 file\n", filename);
+			fclose(fd);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+void CloseSDF()
+{
+	if (bz)
+		BZ2_bzReadClose(&bzerror,bzfd);
+
+	fclose(fd);
+}
+
+int GetChar()
+{
+	if (pos==nbuf)
+	{
+		if (bz)
+		{
+			if (bzerror!=BZ_OK)
+				return EOF;
+
+			nbuf=BZ2_bzRead(&bzerror,bzfd,buffer,BZBUFFER);
+		}
+
+		else
+			nbuf=(int)fread(buffer,1,BZBUFFER,fd);
+
+		pos=0;
+
+		if (nbuf<=0)
+		{
+			nbuf=0;
+			return EOF;
+		}
+	}
+
+	return (unsigned char)buffer[pos++];
+}
+
+/* Reads the next whitespace separated integer into value.
+   Returns 0 at the end of the file. */
+
+int GetInt(int *value)
+{
+	int c, sign=1, n=0, digits=0;
+
+	do
+		c=GetChar();
+	while (c==' ' || c=='\n' || c=='\r' || c=='\t');
+
+	if (c=='-')
+	{
+		sign=-1;
+		c=GetChar();
+	}
+
+	while (c>='0' && c<='9')
+	{
+		n=10*n+(c-'0');
+		digits++;
+		c=GetChar();
+	}
+
+	*value=sign*n;
+
+	return (digits>0);
+}
+
+void PutInt(unsigned char *p, int value)
+{
+	p[0]=value&0xff;
+	p[1]=(value>>8)&0xff;
+	p[2]=(value>>16)&0xff;
+	p[3]=(value>>24)&0xff;
+}
+
+int ConvertSDF(char *filename, char *outdir)
+{
+	int x, count, value, ippd, bounds[4], min_el=32767, max_el=-32768;
+	unsigned char header[64], pair[2];
+	char outname[512], *base;
+	size_t length;
+	FILE *out;
+
+	/* name.sdf or name.sdf.bz2 -> outdir/name.bsdf. Only the end of the
+	   file name is looked at, as the directories may hold ".sdf" too. */
+
+	length=strlen(filename);
+
+	if (EndsWith(filename, ".sdf"))
+		length-=4;
+
+	else if (EndsWith(filename, ".sdf.bz2"))
+		length-=8;
+
+	else
+	{
+		fprintf(stderr, "*** Error: \"%s\" doesn't end in .sdf or .sdf.bz2\n", filename);
+		return -1;
+	}
+
+	base=strrchr(filename, '/');
+
+	if (outdir==NULL || base==NULL)
+		base=filename;
+	else
+		base++;
+
+	length-=base-filename;
+
+	if (outdir!=NULL)
+		x=snprintf(outname,sizeof(outname),"%s/%.*s.bsdf",outdir,(int)length,base);
+	else
+		x=snprintf(outname,sizeof(outname),"%.*s.bsdf",(int)length,base);
+
+	if (x<0 || x>=(int)sizeof(outname))
+	{
+		fprintf(stderr, "*** Error: The name for \"%s\" is too long\n", filename);
+		return -1;
+	}
+
+	if (OpenSDF(filename)!=0)
+		return -1;
+
+	for (x=0; x<4; x++)
+	{
+		if (!GetInt(&bounds[x]))
+		{
+			fprintf(stderr, "*** Error: \"%s\" is truncated\n", filename);
+			CloseSDF();
+			return -1;
+		}
+	}
+
+	for (count=0; count<3600*3600 && GetInt(&value); count++)
+	{
+		heights[count]=(short)value;
+
+		if (value<min_el)
+			min_el=value;
+
+		if (value>max_el)
+			max_el=value;
+	}
+
+	CloseSDF();
+
+	if (count==1200*1200)
+		ippd=1200;
+
+	else if (count==3600*3600)
+		ippd=3600;
+
+	else
+	{
+		fprintf(stderr, "*** Error: \"%s\" holds %d heights, rather than 1200 or 3600 squared\n", filename, count);
+		return -1;
+	}
+
+	memset(header,0,sizeof(header));
+	memcpy(header,"SPLATSDB",8);
+	PutInt(header+8,1);
+	PutInt(header+12,ippd);
+
+	for (x=0; x<4; x++)
+		PutInt(header+16+4*x,bounds[x]);
+
+	PutInt(header+32,min_el);
+	PutInt(header+36,max_el);
+
+	out=fopen(outname,"wb");
+
+	if (out==NULL)
+	{
+		fprintf(stderr, "*** Error: Cannot create \"%s\"\n", outname);
+		return -1;
+	}
+
+	fwrite(header,1,sizeof(header),out);
+
+	for (x=0; x<count; x++)
+	{
+		pair[0]=heights[x]&0xff;
+		pair[1]=(heights[x]>>8)&0xff;
+		fwrite(pair,1,2,out);
+	}
+
+	if (fclose(out)!=0)
+	{
+		fprintf(stderr, "*** Error: Cannot write \"%s\"\n", outname);
+		return -1;
+	}
+
+	printf("Wrote \"%s\"\n", outname);
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int x, errors=0;
+	char *outdir=NULL;
+
+	if (argc==1 || (argc==2 && strncmp(argv[1],"-h",2)==0))
+	{
+		fprintf(stderr, "\nsdf2bsdf: Converts SPLAT! elevation data files (.sdf or .sdf.bz2)\ninto binary SDFs (.bsdf), which SPLAT! loads without parsing.\n\n");
+		fprintf(stderr, "\tAvailable Options...\n\n");
+		fprintf(stderr, "\t-o directory in which to write the .bsdf files\n\t    (default: next to each input file)\n\n");
+		fprintf(stderr, "Examples: %s 40_41_73_74.sdf\n",argv[0]);
+		fprintf(stderr, "          %s -o /data/bsdf /data/sdf/*.sdf.bz2\n\n",argv[0]);
+
+		return 1;
+	}
+
+	for (x=1; x<argc; x++)
+	{
+		if (strcmp(argv[x],"-o")==0 && x+1<argc)
+		{
+			outdir=argv[++x];
+			continue;
+		}
+
+		if (ConvertSDF(argv[x],outdir)!=0)
+			errors++;
+	}
+
+	return (errors>0);
+}